@@ -0,0 +1,503 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * A configuration is a file of "dev <name> set ..." and "phy <name> set ..."
+ * lines, as they would be given to -batch. Phys and interfaces are dumped
+ * once, each line is applied to a copy of its object and only sent if the
+ * copy differs afterwards. Settings apply can't compare are always sent.
+ */
+#define APPLY_PIPELINE_DEPTH	32
+
+struct apply_state {
+	const char *name;
+	struct iwpan_phy *phys;
+	int n_phys;
+	struct iwpan_iface *ifaces;
+	int n_ifaces;
+	int changed, unchanged, failed;
+};
+
+struct apply_setting {
+	const char *name;
+	bool phy;
+	int argc;
+	/* update obj from the arguments, false if they don't parse */
+	bool (*parse)(char **argv, int argc, void *obj);
+};
+
+static bool parse_u(const char *arg, int base, unsigned long max,
+		    unsigned long *val)
+{
+	char *end;
+
+	*val = strtoul(arg, &end, base);
+	return *arg && *end == '\0' && *val <= max;
+}
+
+static bool parse_dbm(const char *arg, int32_t *mbm)
+{
+	char *end;
+	float dbm;
+
+	dbm = strtof(arg, &end);
+	if (!*arg || *end != '\0')
+		return false;
+
+	*mbm = DBM_TO_MBM(dbm);
+	return true;
+}
+
+static bool apply_pan_id(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long val;
+
+	if (!parse_u(argv[0], 0, UINT16_MAX, &val))
+		return false;
+	iface->pan_id = val;
+	iface->valid |= IWPAN_IFACE_PAN_ID;
+	return true;
+}
+
+static bool apply_short_addr(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long val;
+
+	if (!parse_u(argv[0], 0, UINT16_MAX, &val))
+		return false;
+	iface->short_addr = val;
+	iface->valid |= IWPAN_IFACE_SHORT_ADDR;
+	return true;
+}
+
+static bool apply_max_frame_retries(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	char *end;
+	long val;
+
+	val = strtol(argv[0], &end, 0);
+	if (*end != '\0' || val < INT8_MIN || val > INT8_MAX)
+		return false;
+	iface->max_frame_retries = val;
+	iface->valid |= IWPAN_IFACE_MAX_FRAME_RETRIES;
+	return true;
+}
+
+static bool apply_backoff_exponents(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long min_be, max_be;
+
+	if (!parse_u(argv[0], 10, UINT8_MAX, &min_be) ||
+	    !parse_u(argv[1], 10, UINT8_MAX, &max_be))
+		return false;
+	iface->min_be = min_be;
+	iface->max_be = max_be;
+	iface->valid |= IWPAN_IFACE_MIN_BE | IWPAN_IFACE_MAX_BE;
+	return true;
+}
+
+static bool apply_max_csma_backoffs(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long val;
+
+	if (!parse_u(argv[0], 10, UINT8_MAX, &val))
+		return false;
+	iface->max_csma_backoffs = val;
+	iface->valid |= IWPAN_IFACE_MAX_CSMA_BACKOFFS;
+	return true;
+}
+
+static bool apply_lbt(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long val;
+
+	if (!parse_u(argv[0], 0, UINT8_MAX, &val))
+		return false;
+	iface->lbt = val;
+	iface->valid |= IWPAN_IFACE_LBT;
+	return true;
+}
+
+static bool apply_ackreq_default(char **argv, int argc, void *obj)
+{
+	struct iwpan_iface *iface = obj;
+	unsigned long val;
+
+	if (!parse_u(argv[0], 0, UINT8_MAX, &val))
+		return false;
+	iface->ackreq_default = val;
+	iface->valid |= IWPAN_IFACE_ACKREQ_DEFAULT;
+	return true;
+}
+
+static bool apply_channel(char **argv, int argc, void *obj)
+{
+	struct iwpan_phy *phy = obj;
+	unsigned long page, channel;
+
+	if (!parse_u(argv[0], 10, UINT8_MAX, &page) ||
+	    !parse_u(argv[1], 10, UINT8_MAX, &channel))
+		return false;
+	phy->page = page;
+	phy->channel = channel;
+	phy->valid |= IWPAN_PHY_PAGE | IWPAN_PHY_CHANNEL;
+	return true;
+}
+
+static bool apply_tx_power(char **argv, int argc, void *obj)
+{
+	struct iwpan_phy *phy = obj;
+
+	if (!parse_dbm(argv[0], &phy->tx_power))
+		return false;
+	phy->valid |= IWPAN_PHY_TX_POWER;
+	return true;
+}
+
+static bool apply_cca_ed_level(char **argv, int argc, void *obj)
+{
+	struct iwpan_phy *phy = obj;
+
+	if (!parse_dbm(argv[0], &phy->cca_ed_level))
+		return false;
+	phy->valid |= IWPAN_PHY_CCA_ED_LEVEL;
+	return true;
+}
+
+static bool apply_cca_mode(char **argv, int argc, void *obj)
+{
+	struct iwpan_phy *phy = obj;
+	unsigned long mode, opt;
+
+	if (!parse_u(argv[0], 10, UINT32_MAX, &mode))
+		return false;
+	if (mode == NL802154_CCA_ENERGY_CARRIER) {
+		if (argc < 2 || !parse_u(argv[1], 10, UINT32_MAX, &opt))
+			return false;
+		phy->cca_opt = opt;
+		phy->valid |= IWPAN_PHY_CCA_OPT;
+	}
+	phy->cca_mode = mode;
+	phy->valid |= IWPAN_PHY_CCA_MODE;
+	return true;
+}
+
+static const struct apply_setting apply_settings[] = {
+	{ "pan_id", false, 1, apply_pan_id },
+	{ "short_addr", false, 1, apply_short_addr },
+	{ "max_frame_retries", false, 1, apply_max_frame_retries },
+	{ "backoff_exponents", false, 2, apply_backoff_exponents },
+	{ "max_csma_backoffs", false, 1, apply_max_csma_backoffs },
+	{ "lbt", false, 1, apply_lbt },
+	{ "ackreq_default", false, 1, apply_ackreq_default },
+	{ "channel", true, 2, apply_channel },
+	{ "tx_power", true, 1, apply_tx_power },
+	{ "cca_ed_level", true, 1, apply_cca_ed_level },
+	{ "cca_mode", true, 1, apply_cca_mode },
+	{ NULL },
+};
+
+static int apply_phy_handler(struct nl_msg *msg, void *arg)
+{
+	struct apply_state *as = arg;
+	struct iwpan_phy *phys;
+
+	phys = realloc(as->phys, (as->n_phys + 1) * sizeof(*phys));
+	if (!phys)
+		return NL_SKIP;
+	as->phys = phys;
+
+	if (!iwpan_parse_phy(msg, &phys[as->n_phys]))
+		as->n_phys++;
+
+	return NL_SKIP;
+}
+
+static int apply_iface_handler(struct nl_msg *msg, void *arg)
+{
+	struct apply_state *as = arg;
+	struct iwpan_iface *ifaces;
+
+	ifaces = realloc(as->ifaces, (as->n_ifaces + 1) * sizeof(*ifaces));
+	if (!ifaces)
+		return NL_SKIP;
+	as->ifaces = ifaces;
+
+	if (!iwpan_parse_iface(msg, &ifaces[as->n_ifaces]) &&
+	    (ifaces[as->n_ifaces].valid & IWPAN_IFACE_NAME))
+		as->n_ifaces++;
+
+	return NL_SKIP;
+}
+
+static void apply_phy_reset(void *arg)
+{
+	struct apply_state *as = arg;
+
+	while (as->n_phys)
+		iwpan_phy_free(&as->phys[--as->n_phys]);
+}
+
+static void apply_iface_reset(void *arg)
+{
+	struct apply_state *as = arg;
+
+	as->n_ifaces = 0;
+}
+
+/* the object a line refers to, NULL if there is none of that name */
+static void *apply_lookup(struct apply_state *as, bool phy, const char *name,
+			  size_t *size)
+{
+	int i;
+
+	if (phy) {
+		*size = sizeof(*as->phys);
+		for (i = 0; i < as->n_phys; i++) {
+			if (strcmp(as->phys[i].name, name) == 0)
+				return &as->phys[i];
+		}
+	} else {
+		*size = sizeof(*as->ifaces);
+		for (i = 0; i < as->n_ifaces; i++) {
+			if (strcmp(as->ifaces[i].name, name) == 0)
+				return &as->ifaces[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void apply_report(const struct cmd *cmd, int err, void *priv,
+			 long lineno)
+{
+	struct apply_state *as = priv;
+
+	if (!err) {
+		as->changed++;
+		return;
+	}
+
+	if (err == 1)
+		fprintf(stderr, "%s:%ld: invalid arguments\n", as->name, lineno);
+	else if (err < 0)
+		fprintf(stderr, "%s:%ld: command failed: %s (%d)\n",
+			as->name, lineno, strerror(-err), err);
+	else
+		fprintf(stderr, "%s:%ld: command failed (%d)\n",
+			as->name, lineno, err);
+
+	as->failed++;
+}
+
+static const struct apply_setting *apply_find(const char *name)
+{
+	const struct apply_setting *set;
+
+	for (set = apply_settings; set->name; set++) {
+		if (strcmp(set->name, name) == 0)
+			return set;
+	}
+	return NULL;
+}
+
+/* Returns 1 if the setting changed obj, 0 if not, -EINVAL if it doesn't parse */
+static int apply_update(const struct apply_setting *set, int argc, char **argv,
+			void *obj, size_t size)
+{
+	union {
+		struct iwpan_phy phy;
+		struct iwpan_iface iface;
+	} desired;
+
+	if (argc < set->argc)
+		return -EINVAL;
+
+	memcpy(&desired, obj, size);
+	if (!set->parse(argv, argc, &desired))
+		return -EINVAL;
+
+	if (memcmp(&desired, obj, size) == 0)
+		return 0;
+
+	/* later lines compare against what this one sets */
+	memcpy(obj, &desired, size);
+	return 1;
+}
+
+/*
+ * Update phy or iface, whichever the setting in argv belongs to, as "set"
+ * would. Tells which one in is_phy. Returns 1 if that changed, 0 if not,
+ * -ENOENT for settings apply doesn't know and -EINVAL if they don't parse.
+ */
+int apply_setting(int argc, char **argv, struct iwpan_phy *phy,
+		  struct iwpan_iface *iface, bool *is_phy)
+{
+	const struct apply_setting *set;
+
+	set = apply_find(argv[0]);
+	if (!set)
+		return -ENOENT;
+
+	*is_phy = set->phy;
+	if (set->phy)
+		return apply_update(set, argc - 1, argv + 1, phy, sizeof(*phy));
+	return apply_update(set, argc - 1, argv + 1, iface, sizeof(*iface));
+}
+
+/* Returns true if the line has to be sent */
+static bool apply_diff(struct apply_state *as, int argc, char **argv)
+{
+	const struct apply_setting *set;
+	void *obj;
+	bool phy;
+	size_t size;
+
+	phy = strcmp(argv[0], "phy") == 0;
+	set = apply_find(argv[3]);
+
+	/* the command reports what is wrong with it */
+	obj = apply_lookup(as, phy, argv[1], &size);
+	if (!set || set->phy != phy || !obj)
+		return true;
+
+	return apply_update(set, argc - 4, argv + 4, obj, size) != 0;
+}
+
+static int handle_apply(struct nl802154_state *state,
+			struct nl_cb *cb,
+			struct nl_msg *msg,
+			int argc, char **argv,
+			enum id_input id)
+{
+	struct apply_state as = { .name = NULL };
+	struct dump_req phy_dump = {
+		.cmd = NL802154_CMD_GET_WPAN_PHY,
+		.valid = apply_phy_handler,
+		.reset = apply_phy_reset,
+		.arg = &as,
+	};
+	struct dump_req iface_dump = {
+		.cmd = NL802154_CMD_GET_INTERFACE,
+		.valid = apply_iface_handler,
+		.reset = apply_iface_reset,
+		.arg = &as,
+	};
+	char *args[BATCH_MAX_ARGS];
+	int depth = state->pipeline_depth;
+	const struct cmd *cmd;
+	char *line = NULL;
+	int n, err, lineno = 0;
+	size_t len = 0;
+	FILE *f;
+
+	/* skip "apply" */
+	argc--;
+	argv++;
+
+	if (argc != 1)
+		return 1;
+
+	if (strcmp(argv[0], "-") == 0) {
+		f = stdin;
+		as.name = "<stdin>";
+	} else {
+		f = fopen(argv[0], "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open %s: %s\n", argv[0],
+				strerror(errno));
+			return -errno;
+		}
+		as.name = argv[0];
+	}
+
+	err = nl802154_dump(state, &phy_dump);
+	if (!err)
+		err = nl802154_dump(state, &iface_dump);
+	if (err)
+		goto out;
+
+	if (!depth) {
+		err = set_pipeline_depth(state, APPLY_PIPELINE_DEPTH);
+		if (err)
+			goto out;
+	}
+
+	while (getline(&line, &len, f) >= 0) {
+		lineno++;
+
+		n = batch_split_line(line, args);
+		if (n == 0)
+			continue;
+		if (n < 4 || strcmp(args[2], "set") ||
+		    (strcmp(args[0], "dev") && strcmp(args[0], "phy"))) {
+			fprintf(stderr, "%s:%d: not a dev or phy setting\n",
+				as.name, lineno);
+			as.failed++;
+			continue;
+		}
+
+		if (!apply_diff(&as, n, args)) {
+			as.unchanged++;
+			continue;
+		}
+
+		cmd = NULL;
+		err = handle_args(state, n, args, &cmd, apply_report, &as,
+				  lineno);
+		if (err) {
+			/* keep the reports in line order */
+			flush_cmds(state);
+			apply_report(cmd, err, &as, lineno);
+		}
+	}
+
+	flush_cmds(state);
+	if (!depth)
+		set_pipeline_depth(state, 0);
+
+	render_begin(NULL);
+	render_text("%s: %d changed, %d unchanged, %d failed\n", as.name,
+		    as.changed, as.unchanged, as.failed);
+	render_s("file", as.name);
+	render_u("changed", as.changed);
+	render_u("unchanged", as.unchanged);
+	render_u("failed", as.failed);
+	render_end();
+
+	err = as.failed ? 2 : 0;
+out:
+	free(line);
+	apply_phy_reset(&as);
+	free(as.phys);
+	free(as.ifaces);
+	if (f != stdin)
+		fclose(f);
+	return err;
+}
+TOPLEVEL(apply, "<file>", 0, 0, CIB_NONE, handle_apply,
+	 "Bring phys and interfaces to the settings of a file of\n"
+	 "'dev <name> set ...' and 'phy <name> set ...' lines ('-' for stdin).\n"
+	 "Only settings which differ from the current state are sent.");
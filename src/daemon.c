@@ -0,0 +1,418 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+/* accept4() needs _GNU_SOURCE */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <string.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "iwpan.h"
+
+/*
+ * A request is one SOCK_SEQPACKET message holding the client's output
+ * format followed by the command line, each NUL terminated, with the
+ * client's working directory, stdin, stdout, stderr and network namespace
+ * passed along as SCM_RIGHTS. The command runs in that directory and
+ * reads and writes straight to those, the daemon answers with the int the
+ * command returned. A client in another network namespace is answered
+ * with DAEMON_REFUSED before anything runs, and runs the command itself.
+ */
+#define DAEMON_MAX_REQ	4096
+#define DAEMON_MAX_ARGS	64
+#define DAEMON_REFUSED	INT_MIN
+
+enum {
+	DAEMON_FD_CWD,
+	DAEMON_FD_IN,
+	DAEMON_FD_OUT,
+	DAEMON_FD_ERR,
+	DAEMON_FD_NETNS,
+	DAEMON_FDS,
+};
+
+static int listen_fd = -1;
+static pid_t daemon_pid;
+static bool handed_off;
+static struct stat daemon_netns;
+static volatile sig_atomic_t report_timing;
+
+static int daemon_addr(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+int daemon_forward(const char *path, int argc, char **argv, int *status)
+{
+	char buf[DAEMON_MAX_REQ];
+	char cbuf[CMSG_SPACE(DAEMON_FDS * sizeof(int))];
+	int fds[DAEMON_FDS];
+	struct sockaddr_un addr;
+	struct msghdr mh;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	size_t len = 0, alen;
+	int fd, i, err;
+
+	err = daemon_addr(&addr, path);
+	if (err)
+		return err;
+
+	len = strlen(render_format_name()) + 1;
+	memcpy(buf, render_format_name(), len);
+	for (i = 0; i < argc; i++) {
+		alen = strlen(argv[i]) + 1;
+		if (len + alen > sizeof(buf))
+			return -E2BIG;
+		memcpy(buf + len, argv[i], alen);
+		len += alen;
+	}
+
+	fds[DAEMON_FD_IN] = STDIN_FILENO;
+	fds[DAEMON_FD_OUT] = STDOUT_FILENO;
+	fds[DAEMON_FD_ERR] = STDERR_FILENO;
+	fds[DAEMON_FD_CWD] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fds[DAEMON_FD_CWD] < 0)
+		return -errno;
+	fds[DAEMON_FD_NETNS] = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+	if (fds[DAEMON_FD_NETNS] < 0) {
+		err = -errno;
+		close(fds[DAEMON_FD_CWD]);
+		return err;
+	}
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		err = -errno;
+		goto out;
+	}
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		err = -errno;
+		close(fd);
+		goto out;
+	}
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	fflush(stdout);
+	if (sendmsg(fd, &mh, MSG_NOSIGNAL) < 0) {
+		err = -errno;
+		close(fd);
+		goto out;
+	}
+
+	/* from here on the command may have run, don't run it again */
+	err = 0;
+	if (recv(fd, status, sizeof(*status), 0) != sizeof(*status)) {
+		fprintf(stderr, "lost connection to iwpan daemon\n");
+		*status = 2;
+	} else if (*status == DAEMON_REFUSED) {
+		err = -EXDEV;
+	}
+
+	close(fd);
+out:
+	close(fds[DAEMON_FD_CWD]);
+	close(fds[DAEMON_FD_NETNS]);
+	return err;
+}
+
+/* whether fd is the network namespace the daemon runs in */
+static bool daemon_same_netns(int fd)
+{
+	struct stat st;
+
+	return fstat(fd, &st) == 0 && st.st_dev == daemon_netns.st_dev &&
+	       st.st_ino == daemon_netns.st_ino;
+}
+
+/*
+ * Commands which drive the socket themselves (scan, monitor) may block
+ * for long and leave the socket joined to multicast groups. Run them in a
+ * child with a socket of its own, the resolved ids are inherited.
+ */
+static int daemon_isolate(struct nl802154_state *state)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return -errno;
+	if (pid > 0) {
+		handed_off = true;
+		return 1;
+	}
+
+	close(listen_fd);
+	state->isolate = NULL;
+	return nl802154_reconnect(state);
+}
+
+static void daemon_serve(struct nl802154_state *state, int fd)
+{
+	char buf[DAEMON_MAX_REQ];
+	char cbuf[CMSG_SPACE(DAEMON_FDS * sizeof(int))];
+	char *argv[DAEMON_MAX_ARGS];
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	struct iovec iov;
+	int fds[DAEMON_FDS] = { -1, -1, -1, -1, -1 };
+	int saved_cwd, saved_in, saved_out, saved_err;
+	int argc = 0, i, err;
+	ssize_t len;
+	char *pos;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	len = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+	if (len <= 0)
+		return;
+
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	}
+
+	if (fds[0] < 0 || (mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+	    buf[len - 1] != '\0') {
+		err = -EINVAL;
+		goto reply;
+	}
+
+	/* the command would act on the wrong devices */
+	if (!daemon_same_netns(fds[DAEMON_FD_NETNS])) {
+		err = DAEMON_REFUSED;
+		goto reply;
+	}
+
+	if (render_set_format(buf)) {
+		err = -EINVAL;
+		goto reply;
+	}
+
+	for (pos = buf + strlen(buf) + 1; pos < buf + len; pos += strlen(pos) + 1) {
+		if (argc == DAEMON_MAX_ARGS) {
+			err = -E2BIG;
+			goto reply;
+		}
+		argv[argc++] = pos;
+	}
+
+	saved_cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (saved_cwd < 0 || fchdir(fds[DAEMON_FD_CWD])) {
+		err = -errno;
+		if (saved_cwd >= 0)
+			close(saved_cwd);
+		goto reply;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	saved_in = dup(STDIN_FILENO);
+	saved_out = dup(STDOUT_FILENO);
+	saved_err = dup(STDERR_FILENO);
+	dup2(fds[DAEMON_FD_IN], STDIN_FILENO);
+	dup2(fds[DAEMON_FD_OUT], STDOUT_FILENO);
+	dup2(fds[DAEMON_FD_ERR], STDERR_FILENO);
+
+	err = run_command(state, argc, argv);
+
+	/* input read ahead from this client is not the next one's */
+	__fpurge(stdin);
+	clearerr(stdin);
+	fflush(stdout);
+	fflush(stderr);
+	dup2(saved_in, STDIN_FILENO);
+	dup2(saved_out, STDOUT_FILENO);
+	dup2(saved_err, STDERR_FILENO);
+	close(saved_in);
+	close(saved_out);
+	close(saved_err);
+	if (fchdir(saved_cwd))
+		fprintf(stderr, "cannot return to the daemon's directory: %s\n",
+			strerror(errno));
+	close(saved_cwd);
+	render_set_format("text");
+
+	/* the child answers for commands it took over */
+	if (handed_off) {
+		handed_off = false;
+		goto out;
+	}
+
+reply:
+	send(fd, &err, sizeof(err), MSG_NOSIGNAL);
+	if (getpid() != daemon_pid)
+		_exit(0);
+out:
+	for (i = 0; i < DAEMON_FDS; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+}
+
+static void daemon_sigusr1(int sig)
+{
+	report_timing = 1;
+}
+
+static int handle_daemon(struct nl802154_state *state,
+			 struct nl_cb *cb,
+			 struct nl_msg *msg,
+			 int argc, char **argv,
+			 enum id_input id)
+{
+	const char *path = IWPAN_DAEMON_SOCKET;
+	struct pollfd pfd[1 + NAMES_WATCH_FDS];
+	int nfds = 1 + NAMES_WATCH_FDS;
+	struct sockaddr_un addr;
+	mode_t mask;
+	int fd, err;
+
+	/* skip "daemon" */
+	argc--;
+	argv++;
+
+	if (argc == 2 && strcmp(argv[0], "socket") == 0)
+		path = argv[1];
+	else if (argc)
+		return 1;
+
+	if (listen_fd >= 0)
+		return -EBUSY;
+
+	if (stat("/proc/self/ns/net", &daemon_netns))
+		return -errno;
+
+	err = daemon_addr(&addr, path);
+	if (err)
+		return err;
+
+	listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+		return -errno;
+
+	/* a socket nobody listens on is left over from an earlier run */
+	if (connect(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		fprintf(stderr, "iwpan daemon already running on %s\n", path);
+		err = -EADDRINUSE;
+		goto out;
+	}
+	unlink(path);
+
+	mask = umask(0077);
+	err = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (err || listen(listen_fd, 16)) {
+		err = -errno;
+		goto out;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGCHLD, SIG_IGN);
+
+	/* no SA_RESTART, poll() has to return for the report */
+	if (iwpan_timing) {
+		struct sigaction sa = { .sa_handler = daemon_sigusr1 };
+
+		sigaction(SIGUSR1, &sa, NULL);
+	}
+
+	/* names are looked up in the cache, kept current in between requests */
+	if (names_watch(state, pfd + 1))
+		nfds = 1;
+	pfd[0].fd = listen_fd;
+	pfd[0].events = POLLIN;
+
+	daemon_pid = getpid();
+	state->isolate = daemon_isolate;
+
+	while (1) {
+		if (poll(pfd, nfds, -1) < 0) {
+			if (errno == EINTR && report_timing) {
+				report_timing = 0;
+				timing_report();
+			}
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+		/* changes which came before a request apply to it */
+		if (nfds > 1)
+			names_watch_read(state, pfd + 1);
+		if (!(pfd[0].revents & POLLIN))
+			continue;
+
+		fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		daemon_serve(state, fd);
+		close(fd);
+	}
+
+	state->isolate = NULL;
+	unlink(path);
+out:
+	close(listen_fd);
+	listen_fd = -1;
+	return err;
+}
+TOPLEVEL(daemon, "[socket <path>]", 0, 0, CIB_NONE, handle_daemon,
+	"Serve commands on a local socket, keeping the netlink state warm.\n"
+	"Later invocations of iwpan forward their command to it unless\n"
+	"given -local. Runs in the foreground. Started with --timing, it\n"
+	"prints the timing of the commands served so far on SIGUSR1.");
@@ -4,6 +4,8 @@
 
 #include <net/if.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <inttypes.h>
@@ -16,6 +18,7 @@
 
 #include "nl802154.h"
 #include "nl_extras.h"
+#include "libiwpan.h"
 #include "iwpan.h"
 
 struct print_event_args {
@@ -24,17 +27,23 @@ struct print_event_args {
 	bool frame, time, reltime;
 };
 
+/* from the name cache, the interface may be gone already */
+static void print_ifname(uint32_t ifindex)
+{
+	char ifname[IF_NAMESIZE];
+
+	if (names_ifname(ifindex, ifname))
+		printf("%s", ifname);
+	else
+		printf("ifindex %u", ifindex);
+}
+
 static int print_event(struct nl_msg *msg, void *arg)
 {
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct nlattr *tb[NL802154_ATTR_MAX + 1], *nst, *nestedcoord;
-	struct nlattr *pan[NL802154_COORD_MAX + 1];
 	struct print_event_args *args = arg;
-	char ifname[100];
-	static struct nla_policy pan_policy[NL802154_COORD_MAX + 1] = {
-		[NL802154_COORD_PANID] = { .type = NLA_U16, },
-		[NL802154_COORD_ADDR] = { .minlen = 2, .maxlen = 8, }, /* 2 or 8 */
-	};
+	struct iwpan_coord coord;
 	uint8_t reg_type;
 	uint32_t wpan_phy_idx = 0;
 	int rem_nst;
@@ -61,15 +70,15 @@ static int print_event(struct nl_msg *msg, void *arg)
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
 	if (tb[NL802154_ATTR_IFINDEX] && tb[NL802154_ATTR_WPAN_PHY]) {
-		if_indextoname(nla_get_u32(tb[NL802154_ATTR_IFINDEX]), ifname);
-		printf("%s (phy #%d): ", ifname, nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]));
+		print_ifname(nla_get_u32(tb[NL802154_ATTR_IFINDEX]));
+		printf(" (phy #%d): ", nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]));
 	} else if (tb[NL802154_ATTR_WPAN_DEV] && tb[NL802154_ATTR_WPAN_PHY]) {
 		printf("wdev 0x%llx (phy #%d): ",
 			(unsigned long long)nla_get_u64(tb[NL802154_ATTR_WPAN_DEV]),
 			nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]));
 	} else if (tb[NL802154_ATTR_IFINDEX]) {
-		if_indextoname(nla_get_u32(tb[NL802154_ATTR_IFINDEX]), ifname);
-		printf("%s: ", ifname);
+		print_ifname(nla_get_u32(tb[NL802154_ATTR_IFINDEX]));
+		printf(": ");
 	} else if (tb[NL802154_ATTR_WPAN_DEV]) {
 		printf("wdev 0x%llx: ", (unsigned long long)nla_get_u64(tb[NL802154_ATTR_WPAN_DEV]));
 	} else if (tb[NL802154_ATTR_WPAN_PHY]) {
@@ -83,6 +92,12 @@ static int print_event(struct nl_msg *msg, void *arg)
 	case NL802154_CMD_DEL_WPAN_PHY:
 		printf("delete wpan_phy\n");
 		break;
+	case NL802154_CMD_NEW_INTERFACE:
+		printf("new interface\n");
+		break;
+	case NL802154_CMD_DEL_INTERFACE:
+		printf("delete interface\n");
+		break;
 	case NL802154_CMD_TRIGGER_SCAN:
 		printf("scan started\n");
 		break;
@@ -101,22 +116,16 @@ static int print_event(struct nl_msg *msg, void *arg)
 		nestedcoord = tb[NL802154_ATTR_COORDINATOR];
 		if (!nestedcoord)
 			break;
-		ret = nla_parse_nested(pan, NL802154_COORD_MAX, nestedcoord, pan_policy);
+		ret = iwpan_parse_coord(nestedcoord, &coord);
 		if (ret < 0)
 			break;
-		if (!pan[NL802154_COORD_PANID])
-			break;
-		printf("beacon received: PAN 0x%04x",
-		       le16toh(nla_get_u16(pan[NL802154_COORD_PANID])));
-		if (pan[NL802154_COORD_ADDR]) {
-			struct nlattr *coord = pan[NL802154_COORD_ADDR];
-			if (nla_len(coord) == 2) {
-				uint16_t addr = nla_get_u16(coord);
-				printf(", addr 0x%04x\n", le16toh(addr));
-			} else {
-				uint64_t addr = nla_get_u64(coord);
-				printf(", addr 0x%016" PRIx64 "\n", le64toh(addr));
-			}
+		printf("beacon received: PAN 0x%04x", coord.pan_id);
+		if (coord.valid & IWPAN_COORD_ADDR) {
+			if (coord.addr_len == 2)
+				printf(", addr 0x%04x\n", coord.short_addr);
+			else
+				printf(", addr 0x%016" PRIx64 "\n",
+				       coord.extended_addr);
 		}
 		break;
 	default:
@@ -132,8 +141,7 @@ static int __prepare_listen_events(struct nl802154_state *state)
 	int mcid, ret;
 
 	/* Configuration multicast group */
-	mcid = genl_ctrl_resolve_grp(state->nl_sock, NL802154_GENL_NAME,
-				     "config");
+	mcid = nl802154_resolve_grp(state, "config");
 	if (mcid < 0)
 		return mcid;
 	ret = nl_socket_add_membership(state->nl_sock, mcid);
@@ -141,8 +149,7 @@ static int __prepare_listen_events(struct nl802154_state *state)
 		return ret;
 
 	/* Scan multicast group */
-	mcid = genl_ctrl_resolve_grp(state->nl_sock, NL802154_GENL_NAME,
-				     "scan");
+	mcid = nl802154_resolve_grp(state, "scan");
 	if (mcid >= 0) {
 		ret = nl_socket_add_membership(state->nl_sock, mcid);
 		if (ret)
@@ -150,8 +157,7 @@ static int __prepare_listen_events(struct nl802154_state *state)
 	}
 
 	/* MLME multicast group */
-	mcid = genl_ctrl_resolve_grp(state->nl_sock, NL802154_GENL_NAME,
-				     "mlme");
+	mcid = nl802154_resolve_grp(state, "mlme");
 	if (mcid >= 0) {
 		ret = nl_socket_add_membership(state->nl_sock, mcid);
 		if (ret)
@@ -162,7 +168,8 @@ static int __prepare_listen_events(struct nl802154_state *state)
 }
 
 static int __do_listen_events(struct nl802154_state *state,
-			      struct print_event_args *args)
+			      struct print_event_args *args,
+			      struct pollfd *pfd, int nfds)
 {
 	struct nl_cb *cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
 	if (!cb) {
@@ -176,8 +183,24 @@ static int __do_listen_events(struct nl802154_state *state,
 	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, print_event, args);
 
 	/* Loop waiting until interrupted by signal */
+	pfd[0].fd = nl_socket_get_fd(state->nl_sock);
+	pfd[0].events = POLLIN;
 	while (1) {
-		int ret = nl_recvmsgs(state->nl_sock, cb);
+		int ret;
+
+		if (poll(pfd, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "poll return error %d\n", errno);
+			break;
+		}
+		/* the names first, the events are printed with them */
+		if (nfds > 1)
+			names_watch_read(state, pfd + 1);
+		if (!(pfd[0].revents & (POLLIN | POLLERR)))
+			continue;
+
+		ret = nl_recvmsgs(state->nl_sock, cb);
 		if (ret) {
 			fprintf(stderr, "nl_recvmsgs return error %d\n", ret);
 			break;
@@ -194,7 +217,9 @@ static int print_events(struct nl802154_state *state,
 			int argc, char **argv,
 			enum id_input id)
 {
+	struct pollfd pfd[1 + NAMES_WATCH_FDS];
 	struct print_event_args args;
+	int nfds = 1 + NAMES_WATCH_FDS;
 	int ret;
 
 	memset(&args, 0, sizeof(args));
@@ -219,16 +244,211 @@ static int print_events(struct nl802154_state *state,
 	if (argc)
 		return 1;
 
+	/* Names are loaded before the socket joins any group */
+	if (names_watch(state, pfd + 1))
+		nfds = 1;
+
 	/* Prepare reception of all multicast messages */
 	ret = __prepare_listen_events(state);
 	if (ret)
 		return ret;
 
 	/* Read message loop */
-	return __do_listen_events(state, &args);
+	return __do_listen_events(state, &args, pfd, nfds);
 }
 TOPLEVEL(monitor, "[-t|-r] [-f]", 0, 0, CIB_NONE, print_events,
 	"Monitor events from the kernel.\n"
 	"-t - print timestamp\n"
 	"-r - print relative timestamp\n"
 	"-f - print full frame for auth/assoc etc.");
+
+/* events "wait" knows, by the command the kernel sends them with */
+static const struct {
+	const char *name;
+	uint8_t cmd;
+} wait_events[] = {
+	{ "scan_done", NL802154_CMD_SCAN_DONE },
+	{ "beacon", NL802154_CMD_SCAN_EVENT },
+	{ "associate", NL802154_CMD_ASSOCIATE },
+	{ "disassociate", NL802154_CMD_DISASSOCIATE },
+	{ "phy_rename", NL802154_CMD_NEW_WPAN_PHY },
+	{ "phy_del", NL802154_CMD_DEL_WPAN_PHY },
+	{ "interface_add", NL802154_CMD_NEW_INTERFACE },
+	{ "interface_del", NL802154_CMD_DEL_INTERFACE },
+	{ NULL },
+};
+
+struct wait_args {
+	uint8_t cmd;
+	/* filters, by index while the devices exist, by the name they get */
+	const char *dev, *phy;
+	int64_t ifindex, phy_idx;
+	bool matched;
+};
+
+static bool wait_match(const struct wait_args *w, struct nlattr **tb)
+{
+	if (w->dev &&
+	    !(tb[NL802154_ATTR_IFINDEX] &&
+	      nla_get_u32(tb[NL802154_ATTR_IFINDEX]) == w->ifindex) &&
+	    !(tb[NL802154_ATTR_IFNAME] &&
+	      strcmp(nla_get_string(tb[NL802154_ATTR_IFNAME]), w->dev) == 0))
+		return false;
+
+	if (w->phy &&
+	    !(tb[NL802154_ATTR_WPAN_PHY] &&
+	      nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]) == w->phy_idx) &&
+	    !(tb[NL802154_ATTR_WPAN_PHY_NAME] &&
+	      strcmp(nla_get_string(tb[NL802154_ATTR_WPAN_PHY_NAME]), w->phy) == 0))
+		return false;
+
+	return true;
+}
+
+static int wait_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+	struct print_event_args args;
+	struct wait_args *w = arg;
+
+	if (w->matched || gnlh->cmd != w->cmd)
+		return NL_SKIP;
+
+	nla_parse(tb, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+	if (!wait_match(w, tb))
+		return NL_SKIP;
+
+	memset(&args, 0, sizeof(args));
+	print_event(msg, &args);
+	w->matched = true;
+	return NL_STOP;
+}
+
+static uint64_t wait_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int handle_wait(struct nl802154_state *state,
+		       struct nl_cb *cb,
+		       struct nl_msg *msg,
+		       int argc, char **argv,
+		       enum id_input id)
+{
+	struct wait_args w = { .ifindex = -1, .phy_idx = -1 };
+	uint64_t deadline = 0, now;
+	struct pollfd pfd;
+	double timeout;
+	unsigned int idx;
+	char *end;
+	int i, ret;
+
+	/* skip "wait" */
+	argc--;
+	argv++;
+
+	if (argc < 1)
+		return 1;
+
+	for (i = 0; wait_events[i].name; i++) {
+		if (strcmp(argv[0], wait_events[i].name) == 0)
+			break;
+	}
+	if (!wait_events[i].name)
+		return 1;
+	w.cmd = wait_events[i].cmd;
+	argc--;
+	argv++;
+
+	while (argc >= 2) {
+		if (strcmp(argv[0], "dev") == 0) {
+			w.dev = argv[1];
+			/* not there yet when waiting for it to be added */
+			idx = names_ifindex(w.dev);
+			if (idx)
+				w.ifindex = idx;
+		} else if (strcmp(argv[0], "phy") == 0) {
+			w.phy = argv[1];
+			w.phy_idx = names_phy(w.phy);
+		} else if (strcmp(argv[0], "timeout") == 0) {
+			timeout = strtod(argv[1], &end);
+			if (*end != '\0' || timeout < 0)
+				return 1;
+			deadline = wait_now_ms() + (uint64_t)(timeout * 1000);
+		} else {
+			return 1;
+		}
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc)
+		return 1;
+
+	ret = __prepare_listen_events(state);
+	if (ret)
+		return ret;
+
+	cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		fprintf(stderr, "failed to allocate netlink callbacks\n");
+		return 2;
+	}
+	nl_socket_set_cb(state->nl_sock, cb);
+	/* No sequence checking for multicast messages */
+	nl_socket_disable_seq_check(state->nl_sock);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, wait_handler, &w);
+
+	pfd.fd = nl_socket_get_fd(state->nl_sock);
+	pfd.events = POLLIN;
+
+	while (!w.matched) {
+		int ms = -1;
+
+		if (deadline) {
+			now = wait_now_ms();
+			if (now >= deadline) {
+				ret = -ETIMEDOUT;
+				break;
+			}
+			ms = deadline - now;
+		}
+
+		ret = poll(&pfd, 1, ms);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+		if (ret == 0)
+			continue;
+
+		ret = nl_recvmsgs(state->nl_sock, cb);
+		/* events were lost, the one waited for may be among them */
+		if (ret == -NLE_NOMEM) {
+			ret = -ENOBUFS;
+			break;
+		}
+		if (ret) {
+			fprintf(stderr, "nl_recvmsgs return error %d\n", ret);
+			ret = 2;
+			break;
+		}
+	}
+
+	nl_cb_put(cb);
+	return w.matched ? 0 : ret;
+}
+TOPLEVEL(wait, "<event> [dev <devname>] [phy <phyname>] [timeout <seconds>]",
+	0, 0, CIB_NONE, handle_wait,
+	"Wait for an event from the kernel, print it and exit, or fail once\n"
+	"the timeout passed. Start it before the action it waits for.\n"
+	"Events are: scan_done, beacon, associate, disassociate,\n"
+	"phy_rename, phy_del, interface_add and interface_del.\n"
+	"dev and phy only take events of that device, or for interface_add\n"
+	"and phy_rename, of the name it gets.");
@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "iwpan.h"
+
+/*
+ * Family and multicast group ids only change when the family registers
+ * again, i.e. on reboot or when the module is reloaded. The cache is keyed
+ * by the boot id and the identity of the module's sysfs directory, which
+ * is created anew on every load.
+ */
+#define GENL_CACHE_FILE		IWPAN_CACHE_DIR "/genl"
+#define GENL_MODULE_DIR		"/sys/module/ieee802154"
+#define BOOT_ID_FILE		"/proc/sys/kernel/random/boot_id"
+
+static int add_group(struct nl802154_state *state, const char *name, int id)
+{
+	struct nl802154_group *grp;
+
+	if (state->n_groups == NL802154_MAX_GROUPS)
+		return -ENOSPC;
+
+	grp = &state->groups[state->n_groups++];
+	snprintf(grp->name, sizeof(grp->name), "%s", name);
+	grp->id = id;
+	return 0;
+}
+
+static int family_handler(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[CTRL_ATTR_MAX + 1];
+	struct nlattr *tb_grp[CTRL_ATTR_MCAST_GRP_MAX + 1];
+	struct nl802154_state *state = arg;
+	struct nlattr *grp;
+	int rem;
+
+	nla_parse(tb, CTRL_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (!tb[CTRL_ATTR_FAMILY_ID])
+		return NL_SKIP;
+
+	state->nl802154_id = nla_get_u16(tb[CTRL_ATTR_FAMILY_ID]);
+	if (tb[CTRL_ATTR_VERSION])
+		state->nl802154_version = nla_get_u32(tb[CTRL_ATTR_VERSION]);
+
+	state->n_groups = 0;
+	if (tb[CTRL_ATTR_MCAST_GROUPS]) {
+		nla_for_each_nested(grp, tb[CTRL_ATTR_MCAST_GROUPS], rem) {
+			nla_parse_nested(tb_grp, CTRL_ATTR_MCAST_GRP_MAX, grp, NULL);
+			if (!tb_grp[CTRL_ATTR_MCAST_GRP_NAME] ||
+			    !tb_grp[CTRL_ATTR_MCAST_GRP_ID])
+				continue;
+			add_group(state,
+				  nla_get_string(tb_grp[CTRL_ATTR_MCAST_GRP_NAME]),
+				  nla_get_u32(tb_grp[CTRL_ATTR_MCAST_GRP_ID]));
+		}
+	}
+	state->groups_complete = true;
+
+	return NL_SKIP;
+}
+
+static int family_error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+				void *arg)
+{
+	int *ret = arg;
+	*ret = err->error;
+	return NL_STOP;
+}
+
+static int family_ack_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_STOP;
+}
+
+/*
+ * Resolve the family id, its version and all multicast groups with a
+ * single CTRL_CMD_GETFAMILY instead of one request for each.
+ */
+int nl802154_resolve_family(struct nl802154_state *state)
+{
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	int err;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		err = -ENOMEM;
+		goto out_free_msg;
+	}
+
+	genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, GENL_ID_CTRL, 0, 0,
+		    CTRL_CMD_GETFAMILY, 1);
+	NLA_PUT_STRING(msg, CTRL_ATTR_FAMILY_NAME, NL802154_GENL_NAME);
+
+	state->nl802154_id = -1;
+
+	err = nl_send_auto_complete(state->nl_sock, msg);
+	if (err < 0)
+		goto out;
+
+	err = 1;
+	nl_cb_err(cb, NL_CB_CUSTOM, family_error_handler, &err);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, family_ack_handler, &err);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, family_handler, state);
+
+	while (err > 0) {
+		if (nl_recvmsgs(state->nl_sock, cb) < 0 && err > 0)
+			err = -EIO;
+	}
+
+	if (!err && state->nl802154_id < 0)
+		err = -ENOENT;
+	goto out;
+
+nla_put_failure:
+	err = -ENOBUFS;
+out:
+	nl_cb_put(cb);
+out_free_msg:
+	nlmsg_free(msg);
+	return err;
+}
+
+static int genl_cache_key(char *boot_id, size_t len, struct stat *st)
+{
+	FILE *f;
+
+	f = fopen(BOOT_ID_FILE, "r");
+	if (!f)
+		return -errno;
+	if (!fgets(boot_id, len, f)) {
+		fclose(f);
+		return -EIO;
+	}
+	fclose(f);
+	boot_id[strcspn(boot_id, "\n")] = '\0';
+
+	/* a built-in stack never goes away */
+	if (stat(GENL_MODULE_DIR, st))
+		memset(st, 0, sizeof(*st));
+
+	return 0;
+}
+
+int genl_cache_load(struct nl802154_state *state)
+{
+	char boot_id[64], cboot_id[64], name[NL802154_GROUP_NAMSIZ];
+	unsigned long long ino, ctime;
+	struct stat st;
+	char line[128];
+	int id, version, err;
+	FILE *f;
+
+	err = genl_cache_key(boot_id, sizeof(boot_id), &st);
+	if (err)
+		return err;
+
+	f = fopen(GENL_CACHE_FILE, "r");
+	if (!f)
+		return -errno;
+
+	if (!fgets(line, sizeof(line), f) ||
+	    sscanf(line, "boot %63s", cboot_id) != 1 ||
+	    strcmp(boot_id, cboot_id) ||
+	    !fgets(line, sizeof(line), f) ||
+	    sscanf(line, "module %llu %llu", &ino, &ctime) != 2 ||
+	    ino != (unsigned long long)st.st_ino ||
+	    ctime != (unsigned long long)st.st_ctime ||
+	    !fgets(line, sizeof(line), f) ||
+	    sscanf(line, "family %d %d", &id, &version) != 2) {
+		err = -ESTALE;
+		goto out;
+	}
+
+	state->nl802154_id = id;
+	state->nl802154_version = version;
+	state->n_groups = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "group %15s %d", name, &id) == 2)
+			add_group(state, name, id);
+	}
+	state->groups_complete = true;
+
+out:
+	fclose(f);
+	return err;
+}
+
+void genl_cache_store(const struct nl802154_state *state)
+{
+	char boot_id[64], tmp[sizeof(GENL_CACHE_FILE) + 16];
+	struct stat st;
+	int i, err;
+	FILE *f;
+
+	if (genl_cache_key(boot_id, sizeof(boot_id), &st))
+		return;
+
+	if (mkdir(IWPAN_CACHE_DIR, 0755) && errno != EEXIST)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", GENL_CACHE_FILE, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	fprintf(f, "boot %s\n", boot_id);
+	fprintf(f, "module %llu %llu\n", (unsigned long long)st.st_ino,
+		(unsigned long long)st.st_ctime);
+	fprintf(f, "family %d %d\n", state->nl802154_id,
+		state->nl802154_version);
+	for (i = 0; i < state->n_groups; i++)
+		fprintf(f, "group %s %d\n", state->groups[i].name,
+			state->groups[i].id);
+
+	err = ferror(f);
+	if (fclose(f) || err || rename(tmp, GENL_CACHE_FILE))
+		unlink(tmp);
+}
@@ -14,20 +14,26 @@
 
 #include "nl802154.h"
 #include "nl_extras.h"
+#include "libiwpan.h"
 #include "iwpan.h"
 
-static void print_minmax_handler(int min, int max)
+static void print_minmax_handler(const char *name, int min, int max)
 {
 	int i;
 
+	render_text("\t%s: ", name);
 	for (i = min; i <= max; i++)
-		printf("%d,", i);
+		render_text(i < max ? "%d," : "%d", i);
+	render_text("\n");
 
-	/* TODO */
-	printf("\b \n");
+	render_begin(name);
+	render_d("min", min);
+	render_d("max", max);
+	render_end();
 }
 
-static void print_freq_handler(int channel_page, int channel)
+/* in MHz, fmt is set to how to print it or NULL for unknown pages */
+static float channel_freq(int channel_page, int channel, const char **fmt)
 {
 	float freq = 0;
 
@@ -35,34 +41,34 @@ static void print_freq_handler(int channel_page, int channel)
 	case 0:
 		if (channel == 0) {
 			freq = 868.3;
-			printf("%5.1f", freq);
+			*fmt = "%5.1f";
 			break;
 		} else if (channel > 0 && channel < 11) {
 			freq = 906 + 2 * (channel - 1);
 		} else {
 			freq = 2405 + 5 * (channel - 11);
 		}
-		printf("%5.0f", freq);
+		*fmt = "%5.0f";
 		break;
 	case 1:
 		if (channel == 0) {
 			freq = 868.3;
-			printf("%5.1f", freq);
+			*fmt = "%5.1f";
 			break;
 		} else if (channel >= 1 && channel <= 10) {
 			freq = 906 + 2 * (channel - 1);
 		}
-		printf("%5.0f", freq);
+		*fmt = "%5.0f";
 		break;
 	case 2:
 		if (channel == 0) {
 			freq = 868.3;
-			printf("%5.1f", freq);
+			*fmt = "%5.1f";
 			break;
 		} else if (channel >= 1 && channel <= 10) {
 			freq = 906 + 2 * (channel - 1);
 		}
-		printf("%5.0f", freq);
+		*fmt = "%5.0f";
 		break;
 	case 3:
 		if (channel >= 0 && channel <= 12) {
@@ -70,7 +76,7 @@ static void print_freq_handler(int channel_page, int channel)
 		} else if (channel == 13) {
 			freq = 2484;
 		}
-		printf("%4.0f", freq);
+		*fmt = "%4.0f";
 		break;
 	case 4:
 		switch (channel) {
@@ -123,7 +129,7 @@ static void print_freq_handler(int channel_page, int channel)
 			freq = 9484.8;
 			break;
 		}
-		printf("%6.1f", freq);
+		*fmt = "%6.1f";
 		break;
 	case 5:
 		if (channel >= 0 && channel <= 3) {
@@ -131,7 +137,7 @@ static void print_freq_handler(int channel_page, int channel)
 		} else if (channel >= 4 && channel <= 7) {
 			freq = 780 + 2 * (channel - 4);
 		}
-		printf("%3.0f", freq);
+		*fmt = "%3.0f";
 		break;
 	case 6:
 		if (channel >= 0 && channel <= 7) {
@@ -142,12 +148,26 @@ static void print_freq_handler(int channel_page, int channel)
 			freq = 951.1 + 0.4 * (channel - 10);
 		}
 
-		printf("%5.1f", freq);
+		*fmt = "%5.1f";
 		break;
 	default:
-		printf("Unknown");
+		*fmt = NULL;
 		break;
 	}
+
+	return freq;
+}
+
+static void print_freq_handler(int channel_page, int channel)
+{
+	const char *fmt;
+	float freq;
+
+	freq = channel_freq(channel_page, channel, &fmt);
+	if (fmt)
+		render_text(fmt, freq);
+	else
+		render_text("Unknown");
 }
 
 static char cca_mode_buf[100];
@@ -234,266 +254,234 @@ static const char *command_name(enum nl802154_commands cmd)
 	return cmdbuf;
 }
 
-static int print_phy_handler(struct nl_msg *msg, void *arg)
+static void print_levels(const char *name, const int32_t *levels, int n)
 {
-	struct nlattr *tb_msg[NL802154_ATTR_MAX + 1];
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	int rem_page, i, ret;
-	int64_t phy_id = -1;
-	bool print_name = true;
-	struct nlattr *nl_page;
-	enum nl802154_cca_modes cca_mode;
-
-	nla_parse(tb_msg, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
-
-	if (tb_msg[NL802154_ATTR_WPAN_PHY]) {
-		if (nla_get_u32(tb_msg[NL802154_ATTR_WPAN_PHY]) == phy_id)
-			print_name = false;
-		phy_id = nla_get_u32(tb_msg[NL802154_ATTR_WPAN_PHY]);
+	int i;
+
+	render_text("\t%s: ", name);
+	render_list_begin(name);
+	for (i = 0; i < n; i++) {
+		if (i % 6 == 0)
+			render_text("%s\n\t\t\t", i ? "," : "");
+		else
+			render_text(", ");
+		render_text("%.3g dBm", MBM_TO_DBM(levels[i]));
+		render_f(NULL, MBM_TO_DBM(levels[i]));
 	}
-	if (print_name && tb_msg[NL802154_ATTR_WPAN_PHY_NAME])
-		printf("wpan_phy %s\n", nla_get_string(tb_msg[NL802154_ATTR_WPAN_PHY_NAME]));
+	render_list_end();
+	render_text("\n");
+}
 
-	/* TODO remove this handling it's deprecated */
-	if (tb_msg[NL802154_ATTR_CHANNELS_SUPPORTED]) {
-		unsigned char page = 0;
-		unsigned long channel;
-		printf("supported channels:\n");
-		nla_for_each_nested(nl_page,
-				    tb_msg[NL802154_ATTR_CHANNELS_SUPPORTED],
-				    rem_page) {
-			channel = nla_get_u32(nl_page);
-			if (channel) {
-				printf("\tpage %d: ", page);
-				for (i = 0; i <= 31; i++) {
-					if (channel & 0x1)
-						printf("%d,", i);
-					channel >>= 1;
-				}
-				/* TODO hack use sprintf here */
-				printf("\b \b\n");
+static void print_cca_mode(enum nl802154_cca_modes mode,
+			   enum nl802154_cca_opts opt)
+{
+	render_text("\n\t\t%s", print_cca_mode_handler(mode, opt));
+	render_begin(NULL);
+	render_u("mode", mode);
+	if (opt != NL802154_CCA_OPT_ATTR_MAX)
+		render_u("opt", opt);
+	render_end();
+}
+
+static const char *supported_bool_name(enum nl802154_supported_bool_states b)
+{
+	switch (b) {
+	case NL802154_SUPPORTED_BOOL_FALSE:
+		return "false";
+	case NL802154_SUPPORTED_BOOL_TRUE:
+		return "true";
+	case NL802154_SUPPORTED_BOOL_BOTH:
+		return "false,true";
+	default:
+		return "unknown";
+	}
+}
+
+static void print_caps(const struct iwpan_caps *caps)
+{
+	int page, channel, mode, opt, counter;
+	const char *sep = "";
+
+	render_text("capabilities:\n");
+	render_begin("capabilities");
+
+	if (caps->valid & IWPAN_CAPS_IFTYPES) {
+		render_text("\tiftypes: ");
+		render_list_begin("iftypes");
+		for (mode = 0; mode < 32; mode++) {
+			if (!(caps->iftypes & (1U << mode)))
+				continue;
+			render_text("%s%s", sep, iftype_name(mode));
+			render_s(NULL, iftype_name(mode));
+			sep = ",";
+		}
+		render_list_end();
+		render_text("\n");
+	}
+
+	if (caps->valid & IWPAN_CAPS_CHANNELS) {
+		render_text("\tchannels:\n");
+		render_list_begin("channels");
+		for (page = 0; page < IWPAN_MAX_PAGES; page++) {
+			if (!caps->channels[page])
+				continue;
+			counter = 0;
+			render_text("\t\tpage %d: ", page);
+			render_begin(NULL);
+			render_u("page", page);
+			render_list_begin("channels");
+			for (channel = 0; channel < 32; channel++) {
+				if (!(caps->channels[page] & (1U << channel)))
+					continue;
+				if (counter % 3 == 0)
+					render_text("%s\n\t\t\t", counter ? "," : "");
+				else
+					render_text(", ");
+				render_text("[%2d] ", channel);
+				print_freq_handler(page, channel);
+				render_text(" MHz");
+				render_u(NULL, channel);
+				counter++;
 			}
-			page++;
+			render_list_end();
+			render_end();
+			render_text("\n");
 		}
+		render_list_end();
 	}
 
-	if (tb_msg[NL802154_ATTR_PAGE])
-		printf("current_page: %d\n", nla_get_u8(tb_msg[NL802154_ATTR_PAGE]));
+	if (caps->valid & IWPAN_CAPS_TX_POWERS)
+		print_levels("tx_powers", caps->tx_powers, caps->n_tx_powers);
+
+	if (caps->valid & IWPAN_CAPS_CCA_ED_LEVELS)
+		print_levels("cca_ed_levels", caps->cca_ed_levels,
+			     caps->n_cca_ed_levels);
+
+	if (caps->valid & IWPAN_CAPS_CCA_MODES) {
+		render_text("\tcca_modes: ");
+		render_list_begin("cca_modes");
+		for (mode = 0; mode < 32; mode++) {
+			if (!(caps->cca_modes & (1U << mode)))
+				continue;
+			/* Loop through all CCA options only if it is a
+			 * CCA mode that takes CCA options into
+			 * consideration.
+			 */
+			if ((caps->valid & IWPAN_CAPS_CCA_OPTS) &&
+			    mode == NL802154_CCA_ENERGY_CARRIER) {
+				for (opt = 0; opt < 32; opt++) {
+					if (caps->cca_opts & (1U << opt))
+						print_cca_mode(mode, opt);
+				}
+			} else {
+				print_cca_mode(mode, NL802154_CCA_OPT_ATTR_MAX);
+			}
+		}
+		render_list_end();
+		render_text("\n");
+	}
 
-	if (tb_msg[NL802154_ATTR_CHANNEL] &&
-	    tb_msg[NL802154_ATTR_PAGE]) {
-		printf("current_channel: %d, ", nla_get_u8(tb_msg[NL802154_ATTR_CHANNEL]));
-		print_freq_handler(nla_get_u8(tb_msg[NL802154_ATTR_PAGE]),
-				   nla_get_u8(tb_msg[NL802154_ATTR_CHANNEL]));
-		printf(" MHz\n");
+	if (caps->valid & IWPAN_CAPS_BE) {
+		print_minmax_handler("min_be", caps->min_minbe, caps->max_minbe);
+		print_minmax_handler("max_be", caps->min_maxbe, caps->max_maxbe);
 	}
 
-	if (tb_msg[NL802154_ATTR_CCA_MODE]) {
-		enum nl802154_cca_opts cca_opt = NL802154_CCA_OPT_ATTR_MAX;
-		if (tb_msg[NL802154_ATTR_CCA_OPT])
-			cca_opt = nla_get_u32(tb_msg[NL802154_ATTR_CCA_OPT]);
+	if (caps->valid & IWPAN_CAPS_CSMA_BACKOFFS)
+		print_minmax_handler("csma_backoffs", caps->min_csma_backoffs,
+				     caps->max_csma_backoffs);
 
-		cca_mode = nla_get_u32(tb_msg[NL802154_ATTR_CCA_MODE]);
+	if (caps->valid & IWPAN_CAPS_FRAME_RETRIES)
+		print_minmax_handler("frame_retries", caps->min_frame_retries,
+				     caps->max_frame_retries);
 
-		printf("cca_mode: %s", print_cca_mode_handler(cca_mode, cca_opt));
-		printf("\n");
+	if (caps->valid & IWPAN_CAPS_LBT) {
+		render_text("\tlbt: %s\n", supported_bool_name(caps->lbt));
+		render_s("lbt", supported_bool_name(caps->lbt));
 	}
 
-	if (tb_msg[NL802154_ATTR_CCA_ED_LEVEL])
-		printf("cca_ed_level: %.3g\n", MBM_TO_DBM(nla_get_s32(tb_msg[NL802154_ATTR_CCA_ED_LEVEL])));
-
-	if (tb_msg[NL802154_ATTR_TX_POWER])
-		printf("tx_power: %.3g\n", MBM_TO_DBM(nla_get_s32(tb_msg[NL802154_ATTR_TX_POWER])));
-
-	if (tb_msg[NL802154_ATTR_WPAN_PHY_CAPS]) {
-		struct nlattr *tb_caps[NL802154_CAP_ATTR_MAX + 1];
-		/* TODO fix netlink lib that we can use NLA_S32 here
-		 * see function  validate_nla line if (pt->type > NLA_TYPE_MAX) */
-		static struct nla_policy caps_policy[NL802154_CAP_ATTR_MAX + 1] = {
-			[NL802154_CAP_ATTR_CHANNELS] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_TX_POWERS] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_CCA_ED_LEVELS] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_CCA_MODES] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_CCA_OPTS] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_MIN_MINBE] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MAX_MINBE] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MIN_MAXBE] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MAX_MAXBE] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MIN_CSMA_BACKOFFS] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MAX_CSMA_BACKOFFS] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MIN_FRAME_RETRIES] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_MAX_FRAME_RETRIES] = { .type = NLA_U8 },
-			[NL802154_CAP_ATTR_IFTYPES] = { .type = NLA_NESTED },
-			[NL802154_CAP_ATTR_LBT] = { .type = NLA_U32 },
-		};
-
-		printf("capabilities:\n");
-
-		ret = nla_parse_nested(tb_caps, NL802154_CAP_ATTR_MAX,
-				       tb_msg[NL802154_ATTR_WPAN_PHY_CAPS],
-				       caps_policy);
-		if (ret) {
-			printf("failed to parse caps\n");
-			return -EIO;
-		}
+	render_end();
+}
 
-		if (tb_caps[NL802154_CAP_ATTR_IFTYPES]) {
-			struct nlattr *nl_iftypes;
-			int rem_iftypes;
-			printf("\tiftypes: ");
-			nla_for_each_nested(nl_iftypes,
-					    tb_caps[NL802154_CAP_ATTR_IFTYPES],
-					    rem_iftypes)
-				printf("%s,", iftype_name(nla_type(nl_iftypes)));
-			/* TODO */
-			printf("\b \n");
-		}
+static int print_phy_handler(struct nl_msg *msg, void *arg)
+{
+	struct iwpan_phy phy;
+	unsigned long channel;
+	const char *fmt;
+	int page, i;
+	float freq;
+
+	if (iwpan_parse_phy(msg, &phy)) {
+		render_text("failed to parse phy\n");
+		return NL_SKIP;
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_CHANNELS]) {
-			int counter = 0;
-			int rem_pages;
-			struct nlattr *nl_pages;
-			printf("\tchannels:\n");
-			nla_for_each_nested(nl_pages, tb_caps[NL802154_CAP_ATTR_CHANNELS],
-					    rem_pages) {
-				int rem_channels;
-				struct nlattr *nl_channels;
-				counter = 0;
-				printf("\t\tpage %d: ", nla_type(nl_pages));
-				nla_for_each_nested(nl_channels, nl_pages, rem_channels) {
-					if (counter % 3 == 0) {
-						printf("\n\t\t\t[%2d] ", nla_type(nl_channels));
-						print_freq_handler(nla_type(nl_pages), nla_type(nl_channels));
-						printf(" MHz, ");
-					} else {
-						printf("[%2d] ", nla_type(nl_channels));
-						print_freq_handler(nla_type(nl_pages), nla_type(nl_channels));
-						printf(" MHz, ");
-					}
-					counter++;
-				}
-				/*  TODO hack use sprintf here */
-				printf("\b\b \b\n");
-			}
-		}
+	render_begin(NULL);
+	render_u("index", phy.index);
 
-		if (tb_caps[NL802154_CAP_ATTR_TX_POWERS]) {
-			int rem_pwrs;
-			int counter = 0;
-			struct nlattr *nl_pwrs;
-
-			printf("\ttx_powers: ");
-			nla_for_each_nested(nl_pwrs, tb_caps[NL802154_CAP_ATTR_TX_POWERS], rem_pwrs) {
-				if (counter % 6 == 0) {
-					printf("\n\t\t\t%.3g dBm, ", MBM_TO_DBM(nla_get_s32(nl_pwrs)));
-				} else {
-					printf("%.3g dBm, ", MBM_TO_DBM(nla_get_s32(nl_pwrs)));
-				}
-				counter++;
-			}
-			/* TODO */
-			printf("\b \n");
-		}
+	if (phy.valid & IWPAN_PHY_NAME) {
+		render_text("wpan_phy %s\n", phy.name);
+		render_s("name", phy.name);
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_CCA_ED_LEVELS]) {
-			int rem_levels;
-			int counter = 0;
-			struct nlattr *nl_levels;
-
-			printf("\tcca_ed_levels: ");
-			nla_for_each_nested(nl_levels, tb_caps[NL802154_CAP_ATTR_CCA_ED_LEVELS], rem_levels) {
-				if (counter % 6 == 0) {
-					printf("\n\t\t\t%.3g dBm, ", MBM_TO_DBM(nla_get_s32(nl_levels)));
-				} else {
-					printf("%.3g dBm, ", MBM_TO_DBM(nla_get_s32(nl_levels)));
-				}
-				counter++;
+	/* TODO remove this handling it's deprecated */
+	if (phy.valid & IWPAN_PHY_CHANNELS_SUPPORTED) {
+		render_text("supported channels:\n");
+		for (page = 0; page < IWPAN_MAX_PAGES; page++) {
+			channel = phy.channels_supported[page];
+			if (!channel)
+				continue;
+			render_text("\tpage %d: ", page);
+			for (i = 0; i <= 31; i++, channel >>= 1) {
+				if (channel & 0x1)
+					render_text(channel > 1 ? "%d," : "%d", i);
 			}
-			/* TODO */
-			printf("\b \n");
+			render_text("\n");
 		}
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_CCA_MODES]) {
-			struct nlattr *nl_cca_modes;
-			int rem_cca_modes;
-			printf("\tcca_modes: ");
-			nla_for_each_nested(nl_cca_modes,
-					    tb_caps[NL802154_CAP_ATTR_CCA_MODES],
-					    rem_cca_modes) {
-				/* Loop through all CCA options only if it is a
-				 * CCA mode that takes CCA options into
-				 * consideration.
-				 */
-				if (tb_caps[NL802154_CAP_ATTR_CCA_OPTS] &&
-				    nla_type(nl_cca_modes) == NL802154_CCA_ENERGY_CARRIER) {
-					struct nlattr *nl_cca_opts;
-					int rem_cca_opts;
-
-					nla_for_each_nested(nl_cca_opts,
-								tb_caps[NL802154_CAP_ATTR_CCA_OPTS],
-								rem_cca_opts) {
-						printf("\n\t\t%s",
-							print_cca_mode_handler(
-								nla_type(nl_cca_modes),
-								nla_type(nl_cca_opts)));
-					}
-				} else {
-					printf("\n\t\t%s",
-						print_cca_mode_handler(
-							nla_type(nl_cca_modes),
-							NL802154_CCA_OPT_ATTR_MAX));
-
-				}
-			}
-			/* TODO */
-			printf("\n");
-		}
+	if (phy.valid & IWPAN_PHY_PAGE) {
+		render_text("current_page: %d\n", phy.page);
+		render_u("page", phy.page);
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_MIN_MINBE] &&
-		    tb_caps[NL802154_CAP_ATTR_MAX_MINBE] &&
-		    tb_caps[NL802154_CAP_ATTR_MIN_MAXBE] &&
-		    tb_caps[NL802154_CAP_ATTR_MAX_MAXBE]) {
-			printf("\tmin_be: ");
-			print_minmax_handler(nla_get_u8(tb_caps[NL802154_CAP_ATTR_MIN_MINBE]),
-					     nla_get_u8(tb_caps[NL802154_CAP_ATTR_MAX_MINBE]));
-			printf("\tmax_be: ");
-			print_minmax_handler(nla_get_u8(tb_caps[NL802154_CAP_ATTR_MIN_MAXBE]),
-					     nla_get_u8(tb_caps[NL802154_CAP_ATTR_MAX_MAXBE]));
-		}
+	if ((phy.valid & IWPAN_PHY_CHANNEL) && (phy.valid & IWPAN_PHY_PAGE)) {
+		render_text("current_channel: %d, ", phy.channel);
+		print_freq_handler(phy.page, phy.channel);
+		render_text(" MHz\n");
+		render_u("channel", phy.channel);
+		freq = channel_freq(phy.page, phy.channel, &fmt);
+		if (fmt)
+			render_f("frequency", freq);
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_MIN_CSMA_BACKOFFS] &&
-		    tb_caps[NL802154_CAP_ATTR_MAX_CSMA_BACKOFFS]) {
-			printf("\tcsma_backoffs: ");
-			print_minmax_handler(nla_get_u8(tb_caps[NL802154_CAP_ATTR_MIN_CSMA_BACKOFFS]),
-					     nla_get_u8(tb_caps[NL802154_CAP_ATTR_MAX_CSMA_BACKOFFS]));
-		}
+	if (phy.valid & IWPAN_PHY_CCA_MODE) {
+		enum nl802154_cca_opts cca_opt = NL802154_CCA_OPT_ATTR_MAX;
+		if (phy.valid & IWPAN_PHY_CCA_OPT)
+			cca_opt = phy.cca_opt;
+
+		render_text("cca_mode: %s\n",
+			    print_cca_mode_handler(phy.cca_mode, cca_opt));
+		render_u("cca_mode", phy.cca_mode);
+		if (phy.valid & IWPAN_PHY_CCA_OPT)
+			render_u("cca_opt", phy.cca_opt);
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_MIN_FRAME_RETRIES] &&
-		    tb_caps[NL802154_CAP_ATTR_MAX_FRAME_RETRIES]) {
-			printf("\tframe_retries: ");
-			print_minmax_handler(nla_get_s8(tb_caps[NL802154_CAP_ATTR_MIN_FRAME_RETRIES]),
-					     nla_get_s8(tb_caps[NL802154_CAP_ATTR_MAX_FRAME_RETRIES]));
-		}
+	if (phy.valid & IWPAN_PHY_CCA_ED_LEVEL) {
+		render_text("cca_ed_level: %.3g\n", MBM_TO_DBM(phy.cca_ed_level));
+		render_f("cca_ed_level", MBM_TO_DBM(phy.cca_ed_level));
+	}
 
-		if (tb_caps[NL802154_CAP_ATTR_LBT]) {
-			printf("\tlbt: ");
-			switch (nla_get_u32(tb_caps[NL802154_CAP_ATTR_LBT])) {
-			case NL802154_SUPPORTED_BOOL_FALSE:
-				printf("false\n");
-				break;
-			case NL802154_SUPPORTED_BOOL_TRUE:
-				printf("true\n");
-				break;
-			case NL802154_SUPPORTED_BOOL_BOTH:
-				printf("false,true\n");
-				break;
-			default:
-				printf("unknown\n");
-				break;
-			}
-		}
+	if (phy.valid & IWPAN_PHY_TX_POWER) {
+		render_text("tx_power: %.3g\n", MBM_TO_DBM(phy.tx_power));
+		render_f("tx_power", MBM_TO_DBM(phy.tx_power));
 	}
+
+	if (phy.valid & IWPAN_PHY_CAPS)
+		print_caps(&phy.caps);
+
+	render_end();
+	iwpan_phy_free(&phy);
+
 	return 0;
 }
 
@@ -16,6 +16,7 @@
 
 #include "nl802154.h"
 #include "nl_extras.h"
+#include "libiwpan.h"
 #include "iwpan.h"
 
 SECTION(interface);
@@ -180,55 +181,44 @@ HIDDEN(interface, del, NULL, NL802154_CMD_DEL_INTERFACE, 0, CIB_NETDEV, handle_i
 
 static int print_iface_handler(struct nl_msg *msg, void *arg)
 {
-	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
-	struct nlattr *tb_msg[NL802154_ATTR_MAX + 1];
+	const struct iwpan_field *f;
+	struct iwpan_iface iface;
 	unsigned int *wpan_phy = arg;
 	const char *indent = "";
 
-	nla_parse(tb_msg, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
-		  genlmsg_attrlen(gnlh, 0), NULL);
+	if (iwpan_parse_iface(msg, &iface))
+		return NL_SKIP;
 
-	if (wpan_phy && tb_msg[NL802154_ATTR_WPAN_PHY]) {
-		unsigned int thiswpan_phy = nla_get_u32(tb_msg[NL802154_ATTR_WPAN_PHY]);
+	if (wpan_phy && (iface.valid & IWPAN_IFACE_PHY)) {
 		indent = "\t";
-		if (*wpan_phy != thiswpan_phy)
-			printf("phy#%d\n", thiswpan_phy);
-		*wpan_phy = thiswpan_phy;
+		if (*wpan_phy != iface.phy)
+			render_text("phy#%d\n", iface.phy);
+		*wpan_phy = iface.phy;
 	}
 
-	if (tb_msg[NL802154_ATTR_IFNAME])
-		printf("%sInterface %s\n", indent, nla_get_string(tb_msg[NL802154_ATTR_IFNAME]));
+	render_begin(NULL);
+	if (iface.valid & IWPAN_IFACE_NAME)
+		render_text("%sInterface %s\n", indent, iface.name);
 	else
-		printf("%sUnnamed/non-netdev interface\n", indent);
-
-	if (tb_msg[NL802154_ATTR_IFINDEX])
-		printf("%s\tifindex %d\n", indent, nla_get_u32(tb_msg[NL802154_ATTR_IFINDEX]));
-	if (tb_msg[NL802154_ATTR_WPAN_DEV])
-		printf("%s\twpan_dev 0x%llx\n", indent,
-		       (unsigned long long)nla_get_u64(tb_msg[NL802154_ATTR_WPAN_DEV]));
-	if (tb_msg[NL802154_ATTR_EXTENDED_ADDR])
-		printf("%s\textended_addr 0x%016" PRIx64 "\n", indent,
-		       le64toh(nla_get_u64(tb_msg[NL802154_ATTR_EXTENDED_ADDR])));
-	if (tb_msg[NL802154_ATTR_SHORT_ADDR])
-		printf("%s\tshort_addr 0x%04x\n", indent,
-		       le16toh(nla_get_u16(tb_msg[NL802154_ATTR_SHORT_ADDR])));
-	if (tb_msg[NL802154_ATTR_PAN_ID])
-		printf("%s\tpan_id 0x%04x\n", indent,
-		       le16toh(nla_get_u16(tb_msg[NL802154_ATTR_PAN_ID])));
-	if (tb_msg[NL802154_ATTR_IFTYPE])
-		printf("%s\ttype %s\n", indent, iftype_name(nla_get_u32(tb_msg[NL802154_ATTR_IFTYPE])));
-	if (tb_msg[NL802154_ATTR_MAX_FRAME_RETRIES])
-		printf("%s\tmax_frame_retries %d\n", indent, nla_get_s8(tb_msg[NL802154_ATTR_MAX_FRAME_RETRIES]));
-	if (tb_msg[NL802154_ATTR_MIN_BE])
-		printf("%s\tmin_be %d\n", indent, nla_get_u8(tb_msg[NL802154_ATTR_MIN_BE]));
-	if (tb_msg[NL802154_ATTR_MAX_BE])
-		printf("%s\tmax_be %d\n", indent, nla_get_u8(tb_msg[NL802154_ATTR_MAX_BE]));
-	if (tb_msg[NL802154_ATTR_MAX_CSMA_BACKOFFS])
-		printf("%s\tmax_csma_backoffs %d\n", indent, nla_get_u8(tb_msg[NL802154_ATTR_MAX_CSMA_BACKOFFS]));
-	if (tb_msg[NL802154_ATTR_LBT_MODE])
-		printf("%s\tlbt %d\n", indent, nla_get_u8(tb_msg[NL802154_ATTR_LBT_MODE]));
-	if (tb_msg[NL802154_ATTR_ACKREQ_DEFAULT])
-		printf("%s\tackreq_default %d\n", indent, nla_get_u8(tb_msg[NL802154_ATTR_ACKREQ_DEFAULT]));
+		render_text("%sUnnamed/non-netdev interface\n", indent);
+
+	for (f = iwpan_iface_fields; f->name; f++) {
+		if (!(iface.valid & f->valid))
+			continue;
+		/*
+		 * in text the phy is shown as group, the name as title and
+		 * the generation is left to snapshot
+		 */
+		if (f->valid == IWPAN_IFACE_PHY)
+			render_u(f->name, iface.phy);
+		else if (f->valid == IWPAN_IFACE_NAME)
+			render_s(f->name, iface.name);
+		else if (f->valid == IWPAN_IFACE_GENERATION)
+			render_u(f->name, iface.generation);
+		else
+			render_field(indent, f, &iface);
+	}
+	render_end();
 
 	return NL_SKIP;
 }
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: ISC
 
 #include <errno.h>
+#include <fnmatch.h>
 #include <stdio.h>
 #include <string.h>
 #include <net/if.h>
@@ -11,6 +12,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
@@ -19,15 +23,19 @@
 #include <netlink/attr.h>
 
 #include "nl802154.h"
+#include "libiwpan.h"
+#include "nl_sock.h"
 #include "iwpan.h"
 #include "config.h"
 
 /* TODO libnl 1.x compatibility code */
 
 int iwpan_debug = 0;
+static bool dump_stats;
 
-static int nl802154_init(struct nl802154_state *state)
+static int nl802154_init(struct nl802154_state *state, bool cache, int rcvbuf)
 {
+	uint64_t t = timing_now();
 	int err;
 
 	state->nl_sock = nl_socket_alloc();
@@ -36,7 +44,13 @@ static int nl802154_init(struct nl802154_state *state)
 		return -ENOMEM;
 	}
 
-	nl_socket_set_buffer_size(state->nl_sock, 8192, 8192);
+	state->pipeline = NULL;
+	state->pipeline_depth = 0;
+	state->pipeline_len = 0;
+	state->n_groups = 0;
+	state->groups_complete = false;
+	state->isolate = NULL;
+	state->rcvbuf = rcvbuf;
 
 	if (genl_connect(state->nl_sock)) {
 		fprintf(stderr, "Failed to connect to generic netlink.\n");
@@ -44,13 +58,25 @@ static int nl802154_init(struct nl802154_state *state)
 		goto out_handle_destroy;
 	}
 
-	state->nl802154_id = genl_ctrl_resolve(state->nl_sock, "nl802154");
-	if (state->nl802154_id < 0) {
+	nlsock_tune(state->nl_sock, state->rcvbuf);
+	timing_add(TIMING_INIT, t);
+
+	t = timing_now();
+	if (cache && genl_cache_load(state) == 0) {
+		timing_add(TIMING_RESOLVE, t);
+		return 0;
+	}
+
+	if (nl802154_resolve_family(state)) {
 		fprintf(stderr, "nl802154 not found.\n");
 		err = -ENOENT;
 		goto out_handle_destroy;
 	}
 
+	if (cache)
+		genl_cache_store(state);
+	timing_add(TIMING_RESOLVE, t);
+
 	return 0;
 
 out_handle_destroy:
@@ -58,8 +84,92 @@ out_handle_destroy:
 	return err;
 }
 
+/* all acks and replies of a pipeline flush are queued before we read them */
+static int nl802154_rcvbuf(const struct nl802154_state *state)
+{
+	if (state->pipeline_depth * PIPELINE_RCVBUF_PER_REQ > state->rcvbuf)
+		return state->pipeline_depth * PIPELINE_RCVBUF_PER_REQ;
+	return state->rcvbuf;
+}
+
+/* Replace the socket by a fresh one, the resolved ids stay valid */
+int nl802154_reconnect(struct nl802154_state *state)
+{
+	struct nl_sock *sock;
+
+	sock = nl_socket_alloc();
+	if (!sock) {
+		fprintf(stderr, "Failed to allocate netlink socket.\n");
+		return -ENOMEM;
+	}
+
+	if (genl_connect(sock)) {
+		fprintf(stderr, "Failed to connect to generic netlink.\n");
+		nl_socket_free(sock);
+		return -ENOLINK;
+	}
+
+	nlsock_tune(sock, nl802154_rcvbuf(state));
+
+	nl_socket_free(state->nl_sock);
+	state->nl_sock = sock;
+	return 0;
+}
+
+/*
+ * The receive buffer overran and replies were dropped. The old socket still
+ * has the rest of them queued, start over on a fresh one with twice the
+ * buffer.
+ */
+static int nl802154_grow_rcvbuf(struct nl802154_state *state)
+{
+	int rcvbuf = nl802154_rcvbuf(state);
+
+	if (rcvbuf >= NL_RCVBUF_MAX) {
+		fprintf(stderr, "netlink receive buffer overrun at %d bytes\n",
+			rcvbuf);
+		return -ENOBUFS;
+	}
+
+	state->rcvbuf = 2 * rcvbuf;
+	if (state->rcvbuf > NL_RCVBUF_MAX)
+		state->rcvbuf = NL_RCVBUF_MAX;
+	fprintf(stderr, "netlink receive buffer overrun, raising it to %d bytes\n",
+		state->rcvbuf);
+
+	return nl802154_reconnect(state);
+}
+
+int nl802154_resolve_grp(struct nl802154_state *state, const char *name)
+{
+	uint64_t t;
+	int i, id;
+
+	for (i = 0; i < state->n_groups; i++) {
+		if (strcmp(state->groups[i].name, name) == 0)
+			return state->groups[i].id;
+	}
+
+	if (state->groups_complete)
+		return -ENOENT;
+
+	t = timing_now();
+	id = genl_ctrl_resolve_grp(state->nl_sock, NL802154_GENL_NAME, name);
+	timing_add(TIMING_RESOLVE, t);
+	if (id >= 0 && state->n_groups < NL802154_MAX_GROUPS) {
+		snprintf(state->groups[state->n_groups].name,
+			 NL802154_GROUP_NAMSIZ, "%s", name);
+		state->groups[state->n_groups].id = id;
+		state->n_groups++;
+	}
+
+	return id;
+}
+
 static void nl802154_cleanup(struct nl802154_state *state)
 {
+	flush_cmds(state);
+	free(state->pipeline);
 	nl_socket_free(state->nl_sock);
 }
 
@@ -154,10 +264,98 @@ static void __usage_cmd(const struct cmd *cmd, char *indent, bool full)
 	for (_cmd = &__start___cmd; _cmd < &__stop___cmd;		\
 	     _cmd = (const struct cmd *)((char *)_cmd + cmd_size))
 
+/*
+ * All commands sorted by parent section, then name, then position in the
+ * __cmd section. Lookups bsearch for the first entry with a given parent
+ * and name, the entries sharing that key are adjacent.
+ */
+static const struct cmd **cmd_index;
+static int cmd_count;
+
+static int cmd_key_cmp(const struct cmd *parent, const char *name,
+		       const struct cmd *cmd)
+{
+	if ((uintptr_t)parent != (uintptr_t)cmd->parent)
+		return (uintptr_t)parent < (uintptr_t)cmd->parent ? -1 : 1;
+	if (!name)
+		return cmd->name ? -1 : 0;
+	if (!cmd->name)
+		return 1;
+	return strcmp(name, cmd->name);
+}
+
+static int cmd_index_cmp(const void *a, const void *b)
+{
+	const struct cmd *ca = *(const struct cmd * const *)a;
+	const struct cmd *cb = *(const struct cmd * const *)b;
+	int ret;
+
+	ret = cmd_key_cmp(ca->parent, ca->name, cb);
+	if (ret)
+		return ret;
+	/* keep the link order for duplicates */
+	return (uintptr_t)ca < (uintptr_t)cb ? -1 : (ca != cb);
+}
+
+static int cmd_index_init(void)
+{
+	const struct cmd *cmd;
+	int i = 0;
+
+	cmd_count = ((char *)&__stop___cmd - (char *)&__start___cmd) / cmd_size;
+	cmd_index = malloc(cmd_count * sizeof(*cmd_index));
+	if (!cmd_index)
+		return -ENOMEM;
+
+	for_each_cmd(cmd)
+		cmd_index[i++] = cmd;
+
+	qsort(cmd_index, cmd_count, sizeof(*cmd_index), cmd_index_cmp);
+	return 0;
+}
+
+/* index of the first command with the given key, or where it would be */
+static int cmd_index_find(const struct cmd *parent, const char *name)
+{
+	int lo = 0, hi = cmd_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cmd_key_cmp(parent, name, cmd_index[mid]) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+#define for_each_cmd_key(_i, _cmd, _parent, _name)			\
+	for (_i = cmd_index_find(_parent, _name);			\
+	     _i < cmd_count && (_cmd = cmd_index[_i]) &&		\
+	     !cmd_key_cmp(_parent, _name, _cmd); _i++)
+
+/* all commands of a section, sorted by name */
+#define for_each_section_cmd(_i, _cmd, _section)			\
+	for (_i = cmd_index_find(_section, NULL);			\
+	     _i < cmd_count && (_cmd = cmd_index[_i]) &&		\
+	     _cmd->parent == _section; _i++)
+
 static void usage_options(void)
 {
 	printf("Options:\n");
 	printf("\t--debug\t\tenable netlink debugging\n");
+	printf("\t-batch <file>\tread commands from file or stdin ('-'), one per line\n");
+	printf("\t-force\t\tdon't stop on errors in batch mode\n");
+	printf("\t-pipeline <n>\tsend up to n batch commands before waiting for their acks\n");
+	printf("\t-socket <path>\tdaemon socket to forward commands to (default " IWPAN_DAEMON_SOCKET ")\n");
+	printf("\t-local\t\tdon't forward the command to a running daemon\n");
+	printf("\t-cache\t\tkeep netlink family and group ids in " IWPAN_CACHE_DIR "\n");
+	printf("\t-format <fmt>\toutput of info and dumps as text (default), json or table\n");
+	printf("\t-rcvbuf <bytes>\tnetlink receive buffer to start with (default %d)\n",
+	       NL_RCVBUF_DEFAULT);
+	printf("\t-dumpstats\tshow size, passes and duration of dumps on stderr\n");
+	printf("\t--timing\tshow where the time went per command type on stderr\n");
 }
 
 static const char *argv0;
@@ -166,6 +364,7 @@ static void usage(int argc, char **argv)
 {
 	const struct cmd *section, *cmd;
 	bool full = argc >= 0;
+	int i;
 	const char *sect_filt = NULL;
 	const char *cmd_filt = NULL;
 
@@ -189,9 +388,7 @@ static void usage(int argc, char **argv)
 		if (section->handler && !section->hidden)
 			__usage_cmd(section, "\t", full);
 
-		for_each_cmd(cmd) {
-			if (section != cmd->parent)
-				continue;
+		for_each_section_cmd(i, cmd, section) {
 			if (!cmd->handler || cmd->hidden)
 				continue;
 			if (cmd_filt && strcmp(cmd->name, cmd_filt))
@@ -201,6 +398,9 @@ static void usage(int argc, char **argv)
 	}
 	printf("\nCommands that use the netdev ('dev') can also be given the\n"
 	       "'wdev' instead to identify the device.\n");
+	printf("\n'phy' and 'dev' also take comma separated names and globs,\n"
+	       "or 'all', e.g. \"iwpan dev 'wpan*' set lbt 1\", to run the\n"
+	       "command on each matching device.\n");
 	printf("\nYou can omit the 'phy' or 'dev' if "
 			"the identification is unique,\n"
 			"e.g. \"iwpan wpan0 info\" or \"iwpan phy0 info\". "
@@ -221,24 +421,12 @@ static void version(void)
 	printf("iwpan version " PACKAGE_VERSION "\n");
 }
 
-static int phy_lookup(char *name)
+static void print_ext_ack(const struct nlmsgerr *err)
 {
-	char buf[200];
-	int fd, pos;
+	const char *msg = nlsock_ext_ack_msg(err);
 
-	snprintf(buf, sizeof(buf), "/sys/class/ieee802154/%s/index", name);
-
-	fd = open(buf, O_RDONLY);
-	if (fd < 0)
-		return -1;
-	pos = read(fd, buf, sizeof(buf) - 1);
-	if (pos < 0) {
-		close(fd);
-		return -1;
-	}
-	buf[pos] = '\0';
-	close(fd);
-	return atoi(buf);
+	if (msg)
+		fprintf(stderr, "kernel reports: %s\n", msg);
 }
 
 static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
@@ -246,6 +434,7 @@ static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
 {
 	int *ret = arg;
 	*ret = err->error;
+	print_ext_ack(err);
 	return NL_STOP;
 }
 
@@ -263,18 +452,201 @@ static int ack_handler(struct nl_msg *msg, void *arg)
 	return NL_STOP;
 }
 
-static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
-			int argc, char **argv, const struct cmd **cmdout)
+struct cmd_request {
+	const struct cmd *cmd;
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	unsigned int seq;
+	/* 1 while waiting for the ack, the outcome afterwards */
+	int err;
+	cmd_done_t done;
+	void *priv;
+	long tag;
+};
+
+static void free_cmd_request(struct cmd_request *req)
+{
+	nl_cb_put(req->cb);
+	nlmsg_free(req->msg);
+	req->cb = NULL;
+	req->msg = NULL;
+}
+
+static struct cmd_request *pipeline_find(struct nl802154_state *state,
+					 unsigned int seq)
+{
+	int i;
+
+	for (i = 0; i < state->pipeline_len; i++) {
+		if (state->pipeline[i].seq == seq)
+			return &state->pipeline[i];
+	}
+
+	return NULL;
+}
+
+static int pipeline_error_handler(struct sockaddr_nl *nla,
+				  struct nlmsgerr *err, void *arg)
+{
+	struct cmd_request *req = pipeline_find(arg, err->msg.nlmsg_seq);
+
+	if (req)
+		req->err = err->error;
+	print_ext_ack(err);
+	/* keep going, the same read may hold acks of other requests */
+	return NL_SKIP;
+}
+
+static int pipeline_ack_handler(struct nl_msg *msg, void *arg)
+{
+	struct cmd_request *req = pipeline_find(arg, nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (req)
+		req->err = 0;
+	return NL_SKIP;
+}
+
+static int pipeline_finish_handler(struct nl_msg *msg, void *arg)
+{
+	struct cmd_request *req = pipeline_find(arg, nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (req)
+		req->err = 0;
+	return NL_SKIP;
+}
+
+static int no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+int set_pipeline_depth(struct nl802154_state *state, int depth)
+{
+	struct cmd_request *reqs;
+
+	flush_cmds(state);
+
+	if (depth <= 1) {
+		free(state->pipeline);
+		state->pipeline = NULL;
+		state->pipeline_depth = 0;
+		return 0;
+	}
+
+	reqs = realloc(state->pipeline, depth * sizeof(*reqs));
+	if (!reqs)
+		return -ENOMEM;
+
+	state->pipeline = reqs;
+	state->pipeline_depth = depth;
+
+	nl_socket_set_buffer_size(state->nl_sock, nl802154_rcvbuf(state), 8192);
+	return 0;
+}
+
+/*
+ * Send all queued requests with a single sendto(), the kernel processes
+ * them in order and queues one ack (or error) per request. Acks are mapped
+ * back to their request by sequence number, replies go to the callbacks of
+ * the request which is still waiting for its ack.
+ */
+int flush_cmds(struct nl802154_state *state)
+{
+	struct cmd_request *req;
+	struct nlmsghdr *hdr;
+	uint64_t t, kernel;
+	size_t size = 0;
+	char *buf, *pos;
+	int i, err, ret = 0;
+
+	if (!state->pipeline_len)
+		return 0;
+
+	for (i = 0; i < state->pipeline_len; i++) {
+		req = &state->pipeline[i];
+		nl_complete_msg(state->nl_sock, req->msg);
+		hdr = nlmsg_hdr(req->msg);
+		req->seq = hdr->nlmsg_seq;
+		size += NLMSG_ALIGN(hdr->nlmsg_len);
+	}
+
+	buf = malloc(size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	pos = buf;
+	for (i = 0; i < state->pipeline_len; i++) {
+		hdr = nlmsg_hdr(state->pipeline[i].msg);
+		memcpy(pos, hdr, hdr->nlmsg_len);
+		pos += NLMSG_ALIGN(hdr->nlmsg_len);
+	}
+
+	t = timing_now();
+	err = nl_sendto(state->nl_sock, buf, size);
+	timing_add(TIMING_KERNEL, t);
+	free(buf);
+	if (err < 0)
+		goto out;
+
+	err = 0;
+	t = timing_now();
+	kernel = timing_get(TIMING_KERNEL);
+	for (i = 0; i < state->pipeline_len; i++) {
+		req = &state->pipeline[i];
+		while (req->err > 0) {
+			err = nl_recvmsgs(state->nl_sock, req->cb);
+			if (err < 0) {
+				/* the acks still missing are lost */
+				err = err == -NLE_NOMEM ? -ENOBUFS : -EIO;
+				break;
+			}
+		}
+		if (err < 0)
+			break;
+	}
+	timing_add_handled(t, kernel);
+
+out:
+	for (i = 0; i < state->pipeline_len; i++) {
+		req = &state->pipeline[i];
+		if (req->err > 0)
+			req->err = err ? err : -EIO;
+		if (req->err && !ret)
+			ret = req->err;
+		if (req->done)
+			req->done(req->cmd, req->err, req->priv, req->tag);
+		free_cmd_request(req);
+	}
+	state->pipeline_len = 0;
+
+	if (err == -ENOBUFS)
+		nl802154_grow_rcvbuf(state);
+
+	return ret;
+}
+
+/*
+ * Look up the command, build its netlink message and let the command
+ * handler fill it. Commands without a netlink command run right away, in
+ * that case req->msg is NULL and the handler's result is returned.
+ */
+static int __prepare_cmd(struct nl802154_state *state, enum id_input idby,
+			 int argc, char **argv, const struct cmd **cmdout,
+			 struct cmd_request *req)
 {
 	const struct cmd *cmd, *match = NULL, *sectcmd;
 	struct nl_cb *cb;
-	struct nl_cb *s_cb;
 	struct nl_msg *msg;
 	signed long long devidx = 0;
-	int err, o_argc;
+	int err, o_argc, i;
 	const char *command, *section;
 	char *tmp, **o_argv;
 	enum command_identify_by command_idby = CIB_NONE;
+	uint64_t t = timing_now();
+
+	memset(req, 0, sizeof(*req));
 
 	if (argc <= 1 && idby != II_NONE)
 		return 1;
@@ -293,13 +665,13 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 		break;
 	case II_PHY_NAME:
 		command_idby = CIB_PHY;
-		devidx = phy_lookup(*argv);
+		devidx = names_phy(*argv);
 		argc--;
 		argv++;
 		break;
 	case II_NETDEV:
 		command_idby = CIB_NETDEV;
-		devidx = if_nametoindex(*argv);
+		devidx = names_ifindex(*argv);
 		if (devidx == 0)
 			devidx = -1;
 		argc--;
@@ -315,6 +687,7 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	default:
 		break;
 	}
+	timing_add(TIMING_LOOKUP, t);
 
 	if (devidx < 0)
 		return -errno;
@@ -323,14 +696,17 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	argc--;
 	argv++;
 
-	for_each_cmd(sectcmd) {
-		if (sectcmd->parent)
-			continue;
-		/* ok ... bit of a hack for the dupe 'info' section */
-		if (match && sectcmd->idby != command_idby)
-			continue;
-		if (strcmp(sectcmd->name, section) == 0)
+	/*
+	 * The 'info' section exists once per id type, prefer the one matching
+	 * how the device was given.
+	 */
+	for_each_cmd_key(i, sectcmd, NULL, section) {
+		if (!match)
+			match = sectcmd;
+		if (sectcmd->idby == command_idby) {
 			match = sectcmd;
+			break;
+		}
 	}
 
 	sectcmd = match;
@@ -341,11 +717,9 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	if (argc > 0) {
 		command = *argv;
 
-		for_each_cmd(cmd) {
+		for_each_cmd_key(i, cmd, sectcmd, command) {
 			if (!cmd->handler)
 				continue;
-			if (cmd->parent != sectcmd)
-				continue;
 			/*
 			 * ignore mismatch id by, but allow WPAN_DEV
 			 * in place of NETDEV
@@ -354,8 +728,6 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 			    !(cmd->idby == CIB_NETDEV &&
 			      command_idby == CIB_WPAN_DEV))
 				continue;
-			if (strcmp(cmd->name, command))
-				continue;
 			if (argc > 1 && !cmd->args)
 				continue;
 			match = cmd;
@@ -391,12 +763,21 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	if (cmdout)
 		*cmdout = cmd;
 
+	req->cmd = cmd;
+
 	if (!cmd->cmd) {
 		argc = o_argc;
 		argv = o_argv;
+		flush_cmds(state);
+		if (state->isolate) {
+			err = state->isolate(state);
+			if (err)
+				return err < 0 ? err : 0;
+		}
 		return cmd->handler(state, NULL, NULL, argc, argv, idby);
 	}
 
+	t = timing_now();
 	msg = nlmsg_alloc();
 	if (!msg) {
 		fprintf(stderr, "failed to allocate netlink message\n");
@@ -404,12 +785,12 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	}
 
 	cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
-	s_cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
-	if (!cb || !s_cb) {
+	if (!cb) {
 		fprintf(stderr, "failed to allocate netlink callbacks\n");
 		err = 2;
 		goto out_free_msg;
 	}
+	timing_cb(cb);
 
 	genlmsg_put(msg, 0, 0, state->nl802154_id, 0,
 		    cmd->nl_msg_flags, cmd->cmd, 0);
@@ -431,29 +812,488 @@ static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
 	err = cmd->handler(state, cb, msg, argc, argv, idby);
 	if (err)
 		goto out;
+	timing_add(TIMING_BUILD, t);
+
+	req->msg = msg;
+	req->cb = cb;
+	req->err = 1;
+	return 0;
+
+nla_put_failure:
+	fprintf(stderr, "building message failed\n");
+	err = 2;
+out:
+	nl_cb_put(cb);
+out_free_msg:
+	nlmsg_free(msg);
+	return err;
+}
 
+/* Read replies on cb until the handlers set err, the ack or error is in */
+static void wait_for_ack(struct nl802154_state *state, struct nl_cb *cb,
+			 int *err)
+{
+	uint64_t t = timing_now();
+	uint64_t kernel = timing_get(TIMING_KERNEL);
+
+	while (*err > 0) {
+		/* libnl reports ENOBUFS as out of memory */
+		if (nl_recvmsgs(state->nl_sock, cb) == -NLE_NOMEM)
+			*err = -ENOBUFS;
+	}
+
+	timing_add_handled(t, kernel);
+}
+
+/* Send a prepared request and wait for its ack */
+static int __run_cmd(struct nl802154_state *state, struct cmd_request *req)
+{
+	struct nl_cb *s_cb;
+	uint64_t t;
+	int err;
+
+	/* requests queued earlier have to hit the kernel first */
+	flush_cmds(state);
+
+	s_cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!s_cb) {
+		fprintf(stderr, "failed to allocate netlink callbacks\n");
+		err = 2;
+		goto out;
+	}
 	nl_socket_set_cb(state->nl_sock, s_cb);
+	nl_cb_put(s_cb);
 
-	err = nl_send_auto_complete(state->nl_sock, msg);
+	t = timing_now();
+	err = nl_send_auto_complete(state->nl_sock, req->msg);
+	timing_add(TIMING_KERNEL, t);
 	if (err < 0)
 		goto out;
 
 	err = 1;
 
+	nl_cb_err(req->cb, NL_CB_CUSTOM, error_handler, &err);
+	nl_cb_set(req->cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
+	nl_cb_set(req->cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
+
+	wait_for_ack(state, req->cb, &err);
+out:
+	free_cmd_request(req);
+	return err;
+}
+
+/*
+ * Interfaces carry the generation of their phy's interface list. A dump
+ * which sees one phy with two generations, or which the kernel flags with
+ * NLM_F_DUMP_INTR, mixes objects from before and after a change.
+ */
+#define DUMP_RETRIES		3
+#define DUMP_CHECK_PHYS		32
+
+struct dump_check_gen {
+	uint32_t phy;
+	uint32_t generation;
+};
+
+/* gens grows as phys show up and is kept over the passes of a dump */
+struct dump_check {
+	bool torn;
+	int messages;
+	size_t bytes;
+	int n, size;
+	struct dump_check_gen *gens;
+};
+
+static int dump_check_handler(struct nl_msg *msg, void *arg)
+{
+	struct dump_check *check = arg;
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *gen, *phy;
+	int i;
+
+	/* this replaces the message dump of the debug callbacks */
+	if (iwpan_debug)
+		nl_msg_dump(msg, stderr);
+
+	check->messages++;
+	check->bytes += nlh->nlmsg_len;
+
+	if (nlh->nlmsg_flags & NLM_F_DUMP_INTR)
+		check->torn = true;
+	if (nlh->nlmsg_type < NLMSG_MIN_TYPE)
+		return NL_OK;
+
+	gen = nlmsg_find_attr(nlh, GENL_HDRLEN, NL802154_ATTR_GENERATION);
+	phy = nlmsg_find_attr(nlh, GENL_HDRLEN, NL802154_ATTR_WPAN_PHY);
+	if (!gen || !phy)
+		return NL_OK;
+
+	for (i = 0; i < check->n; i++) {
+		if (check->gens[i].phy != nla_get_u32(phy))
+			continue;
+		if (check->gens[i].generation != nla_get_u32(gen))
+			check->torn = true;
+		return NL_OK;
+	}
+
+	if (check->n == check->size) {
+		struct dump_check_gen *gens;
+		int size = check->size ? check->size * 2 : DUMP_CHECK_PHYS;
+
+		gens = realloc(check->gens, size * sizeof(*gens));
+		if (!gens) {
+			/* a phy not tracked cannot be checked */
+			check->torn = true;
+			return NL_OK;
+		}
+		check->gens = gens;
+		check->size = size;
+	}
+
+	check->gens[check->n].phy = nla_get_u32(phy);
+	check->gens[check->n].generation = nla_get_u32(gen);
+	check->n++;
+
+	return NL_OK;
+}
+
+static void dump_check_init(struct nl_cb *cb, struct dump_check *check)
+{
+	check->torn = false;
+	check->messages = 0;
+	check->bytes = 0;
+	check->n = 0;
+	nl_cb_set(cb, NL_CB_MSG_IN, NL_CB_CUSTOM, dump_check_handler, check);
+}
+
+static void dump_check_free(struct dump_check *check)
+{
+	free(check->gens);
+}
+
+/* FNV-1a over the generations seen, 0 if the dump carried none */
+static uint64_t dump_generation(const struct dump_check *check)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint32_t vals[2];
+	int i, j;
+
+	if (!check->n)
+		return 0;
+
+	for (i = 0; i < check->n; i++) {
+		vals[0] = check->gens[i].phy;
+		vals[1] = check->gens[i].generation;
+		for (j = 0; j < (int)sizeof(vals); j++) {
+			hash ^= ((uint8_t *)vals)[j];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+
+	return hash;
+}
+
+static const char *dump_name(enum nl802154_commands cmd)
+{
+	switch (cmd) {
+	case NL802154_CMD_GET_WPAN_PHY:
+		return "phys";
+	case NL802154_CMD_GET_INTERFACE:
+		return "interfaces";
+	case NL802154_CMD_LIST_ASSOCIATIONS:
+		return "associations";
+	default:
+		return "objects";
+	}
+}
+
+static void dump_stats_start(struct timespec *start)
+{
+	if (dump_stats)
+		clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+/* for -dumpstats, the size is the one of the last pass */
+static void dump_stats_print(struct nl802154_state *state,
+			     enum nl802154_commands cmd,
+			     const struct timespec *start, int passes,
+			     const struct dump_check *check)
+{
+	struct timespec now;
+
+	if (!dump_stats)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	fprintf(stderr, "dump of %s: %d messages, %zu bytes, %d pass%s, "
+		"%.3f ms, rcvbuf %d\n", dump_name(cmd), check->messages,
+		check->bytes, passes, passes == 1 ? "" : "es",
+		(now.tv_sec - start->tv_sec) * 1e3 +
+		(now.tv_nsec - start->tv_nsec) / 1e6, state->rcvbuf);
+}
+
+static int __nl802154_dump(struct nl802154_state *state, struct dump_req *req,
+			   struct dump_check *check)
+{
+	struct nl_msg *msg;
+	struct nl_cb *cb;
+	uint64_t t;
+	int err;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -ENOMEM;
+
+	cb = nl_cb_alloc(iwpan_debug ? NL_CB_DEBUG : NL_CB_DEFAULT);
+	if (!cb) {
+		err = -ENOMEM;
+		goto out_free_msg;
+	}
+	timing_cb(cb);
+
+	genlmsg_put(msg, 0, 0, state->nl802154_id, 0, NLM_F_DUMP, req->cmd, 0);
+	if (req->ifindex)
+		NLA_PUT_U32(msg, NL802154_ATTR_IFINDEX, req->ifindex);
+
+	t = timing_now();
+	err = nl_send_auto_complete(state->nl_sock, msg);
+	timing_add(TIMING_KERNEL, t);
+	if (err < 0)
+		goto out;
+
+	err = 1;
 	nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
 	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
 	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, req->valid, req->arg);
+	dump_check_init(cb, check);
 
-	while (err > 0)
-		nl_recvmsgs(state->nl_sock, cb);
+	wait_for_ack(state, cb, &err);
+	goto out;
+
+nla_put_failure:
+	err = -ENOBUFS;
 out:
 	nl_cb_put(cb);
 out_free_msg:
 	nlmsg_free(msg);
 	return err;
-nla_put_failure:
-	fprintf(stderr, "building message failed\n");
-	return 2;
+}
+
+int nl802154_dump(struct nl802154_state *state, struct dump_req *req)
+{
+	struct dump_check check = { .gens = NULL };
+	struct timespec start;
+	int err, tries = 0, passes = 0;
+
+	flush_cmds(state);
+	dump_stats_start(&start);
+
+	while (1) {
+		passes++;
+		err = __nl802154_dump(state, req, &check);
+		if (err == -ENOBUFS) {
+			err = nl802154_grow_rcvbuf(state);
+			if (err)
+				break;
+		} else if (err || !check.torn || ++tries == DUMP_RETRIES) {
+			break;
+		}
+		if (req->reset)
+			req->reset(req->arg);
+	}
+
+	dump_stats_print(state, req->cmd, &start, passes, &check);
+	if (!err && check.torn)
+		err = -EAGAIN;
+	else
+		req->generation = dump_generation(&check);
+
+	dump_check_free(&check);
+	return err;
+}
+
+struct iface_get {
+	uint32_t ifindex;
+	struct iwpan_iface *iface;
+	struct iwpan_phy *phy;
+	bool have_iface, have_phy;
+};
+
+static int iface_get_handler(struct nl_msg *msg, void *arg)
+{
+	struct iface_get *ig = arg;
+	struct iwpan_iface iface;
+
+	if (!iwpan_parse_iface(msg, &iface) &&
+	    (iface.valid & IWPAN_IFACE_IFINDEX) &&
+	    (iface.valid & IWPAN_IFACE_PHY) &&
+	    iface.ifindex == ig->ifindex) {
+		*ig->iface = iface;
+		ig->have_iface = true;
+	}
+	return NL_SKIP;
+}
+
+static int iface_get_phy_handler(struct nl_msg *msg, void *arg)
+{
+	struct iface_get *ig = arg;
+	struct iwpan_phy phy;
+
+	if (ig->have_phy || iwpan_parse_phy(msg, &phy))
+		return NL_SKIP;
+
+	if (phy.index == ig->iface->phy) {
+		*ig->phy = phy;
+		ig->have_phy = true;
+	} else {
+		iwpan_phy_free(&phy);
+	}
+	return NL_SKIP;
+}
+
+static void iface_get_reset(void *arg)
+{
+	struct iface_get *ig = arg;
+
+	if (ig->have_phy)
+		iwpan_phy_free(ig->phy);
+	ig->have_iface = false;
+	ig->have_phy = false;
+}
+
+/*
+ * The interface ifindex and its phy, -ENODEV if there is no such interface.
+ * The phy is the caller's to free with iwpan_phy_free().
+ */
+int nl802154_get_iface(struct nl802154_state *state, uint32_t ifindex,
+		       struct iwpan_iface *iface, struct iwpan_phy *phy)
+{
+	struct iface_get ig = {
+		.ifindex = ifindex,
+		.iface = iface,
+		.phy = phy,
+	};
+	struct dump_req iface_dump = {
+		.cmd = NL802154_CMD_GET_INTERFACE,
+		.valid = iface_get_handler,
+		.reset = iface_get_reset,
+		.arg = &ig,
+	};
+	struct dump_req phy_dump = {
+		.cmd = NL802154_CMD_GET_WPAN_PHY,
+		.valid = iface_get_phy_handler,
+		.reset = iface_get_reset,
+		.arg = &ig,
+	};
+	int err;
+
+	err = nl802154_dump(state, &iface_dump);
+	if (err)
+		return err;
+	if (!ig.have_iface)
+		return -ENODEV;
+
+	err = nl802154_dump(state, &phy_dump);
+	if (err && ig.have_phy)
+		iwpan_phy_free(phy);
+	if (err)
+		return err;
+	return ig.have_phy ? 0 : -ENODEV;
+}
+
+/*
+ * Dump commands render as they go, a dump which turns out to be torn or
+ * overran the receive buffer is thrown away and run again from the start.
+ */
+static int __run_dump(struct nl802154_state *state, enum id_input idby,
+		      int argc, char **argv, const struct cmd **cmdout,
+		      struct cmd_request *req)
+{
+	enum nl802154_commands cmd = req->cmd->cmd;
+	struct dump_check check = { .gens = NULL };
+	struct timespec start;
+	int err, tries = 0, passes = 0;
+
+	dump_stats_start(&start);
+
+	while (1) {
+		passes++;
+		dump_check_init(req->cb, &check);
+		render_save();
+		err = __run_cmd(state, req);
+		if (err == -ENOBUFS) {
+			err = nl802154_grow_rcvbuf(state);
+			if (err)
+				break;
+		} else if (err || !check.torn || ++tries == DUMP_RETRIES) {
+			break;
+		}
+
+		render_restore();
+		err = __prepare_cmd(state, idby, argc, argv, cmdout, req);
+		if (err || !req->msg)
+			goto out;
+	}
+
+	dump_stats_print(state, cmd, &start, passes, &check);
+	if (!err && check.torn)
+		fprintf(stderr, "objects kept changing during the dump, "
+			"output may be inconsistent\n");
+
+out:
+	dump_check_free(&check);
+	return err;
+}
+
+/*
+ * With a pipeline depth set and a completion callback given, requests which
+ * don't dump are queued and sent together once the pipeline is full or
+ * flush_cmds() is called. Their outcome is reported through done(), the
+ * return value only covers errors found before queueing.
+ */
+static int __handle_cmd_cb(struct nl802154_state *state, enum id_input idby,
+			   int argc, char **argv, const struct cmd **cmdout,
+			   cmd_done_t done, void *priv, long tag)
+{
+	struct cmd_request req, *queued;
+	int err;
+
+	err = __prepare_cmd(state, idby, argc, argv, cmdout, &req);
+	if (err || !req.msg)
+		return err;
+
+	if (req.cmd->nl_msg_flags & NLM_F_DUMP)
+		return __run_dump(state, idby, argc, argv, cmdout, &req);
+	if (!done || !state->pipeline_depth) {
+		err = __run_cmd(state, &req);
+		/* the ack may still be queued, don't read it as a reply later */
+		if (err == -ENOBUFS)
+			nl802154_grow_rcvbuf(state);
+		return err;
+	}
+
+	req.done = done;
+	req.priv = priv;
+	req.tag = tag;
+	nl_cb_err(req.cb, NL_CB_CUSTOM, pipeline_error_handler, state);
+	nl_cb_set(req.cb, NL_CB_FINISH, NL_CB_CUSTOM, pipeline_finish_handler, state);
+	nl_cb_set(req.cb, NL_CB_ACK, NL_CB_CUSTOM, pipeline_ack_handler, state);
+	nl_cb_set(req.cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
+
+	queued = &state->pipeline[state->pipeline_len++];
+	*queued = req;
+
+	if (state->pipeline_len == state->pipeline_depth)
+		flush_cmds(state);
+
+	return 0;
+}
+
+static int __handle_cmd(struct nl802154_state *state, enum id_input idby,
+			int argc, char **argv, const struct cmd **cmdout)
+{
+	return __handle_cmd_cb(state, idby, argc, argv, cmdout, NULL, NULL, 0);
 }
 
 int handle_cmd(struct nl802154_state *state, enum id_input idby,
@@ -462,67 +1302,437 @@ int handle_cmd(struct nl802154_state *state, enum id_input idby,
 	return __handle_cmd(state, idby, argc, argv, NULL);
 }
 
-int main(int argc, char **argv)
+/*
+ * "dev" and "phy" also take lists of names and globs, e.g. "wpan*,lowpan0",
+ * or "all". The targets are resolved from a single dump and the command is
+ * queued for each of them, the outcome is reported per target. A plain name
+ * in the list which matches no device is reported as a failed target.
+ */
+#define FANOUT_PIPELINE_DEPTH	32
+
+struct fanout_state {
+	bool phy;
+	char **names;
+	int n_names;
+	int *results;
+};
+
+static bool is_fanout_target(const char *target)
 {
-	struct nl802154_state nlstate;
-	const struct cmd *cmd = NULL;
-	int err;
+	return strcmp(target, "all") == 0 || strpbrk(target, "*?[,");
+}
 
-	/* calculate command size including padding */
-	cmd_size = labs((long)&__section_set - (long)&__section_get);
-	/* strip off self */
-	argc--;
-	argv0 = *argv++;
+static int fanout_add(struct fanout_state *fs, const char *name)
+{
+	char **names;
 
-	if (argc > 0 && strcmp(*argv, "--debug") == 0) {
-		iwpan_debug = 1;
-		argc--;
-		argv++;
+	names = realloc(fs->names, (fs->n_names + 1) * sizeof(*names));
+	if (!names)
+		return -ENOMEM;
+	fs->names = names;
+
+	names[fs->n_names] = strdup(name);
+	if (!names[fs->n_names])
+		return -ENOMEM;
+	fs->n_names++;
+	return 0;
+}
+
+static void fanout_reset(void *arg)
+{
+	struct fanout_state *fs = arg;
+	int i;
+
+	for (i = 0; i < fs->n_names; i++)
+		free(fs->names[i]);
+	fs->n_names = 0;
+}
+
+static int fanout_handler(struct nl_msg *msg, void *arg)
+{
+	struct fanout_state *fs = arg;
+	struct iwpan_iface iface;
+	struct iwpan_phy phy;
+
+	if (fs->phy) {
+		if (iwpan_parse_phy(msg, &phy))
+			return NL_SKIP;
+		if (phy.valid & IWPAN_PHY_NAME)
+			fanout_add(fs, phy.name);
+		iwpan_phy_free(&phy);
+	} else {
+		if (!iwpan_parse_iface(msg, &iface) &&
+		    (iface.valid & IWPAN_IFACE_NAME))
+			fanout_add(fs, iface.name);
 	}
 
-	if (argc > 0 && strcmp(*argv, "--version") == 0) {
-		version();
-		return 0;
+	return NL_SKIP;
+}
+
+static bool fanout_match(const char *target, const char *name)
+{
+	char pattern[64];
+	const char *pos, *end;
+	size_t len;
+
+	if (strcmp(target, "all") == 0)
+		return true;
+
+	for (pos = target; *pos; pos = *end ? end + 1 : end) {
+		end = pos + strcspn(pos, ",");
+		len = end - pos;
+		if (len >= sizeof(pattern))
+			continue;
+		memcpy(pattern, pos, len);
+		pattern[len] = '\0';
+		if (fnmatch(pattern, name, 0) == 0)
+			return true;
 	}
 
-	/* need to treat "help" command specially so it works w/o nl802154 */
-	if (argc == 0 || strcmp(*argv, "help") == 0) {
-		usage(argc - 1, argv + 1);
-		return 0;
+	return false;
+}
+
+/* names in the list which are not globs and matched nothing fail too */
+static int fanout_missing(struct fanout_state *fs, const char *target)
+{
+	char name[64];
+	const char *pos, *end;
+	int i, missing = 0;
+	size_t len;
+
+	for (pos = target; *pos; pos = *end ? end + 1 : end) {
+		end = pos + strcspn(pos, ",");
+		len = end - pos;
+		if (!len || len >= sizeof(name))
+			continue;
+		memcpy(name, pos, len);
+		name[len] = '\0';
+		if (strpbrk(name, "*?["))
+			continue;
+
+		for (i = 0; i < fs->n_names; i++) {
+			if (strcmp(fs->names[i], name) == 0)
+				break;
+		}
+		if (i < fs->n_names)
+			continue;
+
+		render_begin(NULL);
+		render_s(fs->phy ? "phy" : "dev", name);
+		render_text("%s: failed: %s (%d)\n", name, strerror(ENODEV),
+			    -ENODEV);
+		render_d("status", -ENODEV);
+		render_end();
+		missing++;
 	}
 
-	err = nl802154_init(&nlstate);
+	return missing;
+}
+
+static void fanout_done(const struct cmd *cmd, int err, void *priv, long tag)
+{
+	struct fanout_state *fs = priv;
+
+	fs->results[tag] = err;
+}
+
+static int handle_fanout(struct nl802154_state *state, int argc, char **argv,
+			 const struct cmd **cmdout)
+{
+	struct fanout_state fs = { .phy = strcmp(argv[0], "phy") == 0 };
+	struct dump_req dump = {
+		.cmd = fs.phy ? NL802154_CMD_GET_WPAN_PHY :
+				NL802154_CMD_GET_INTERFACE,
+		.valid = fanout_handler,
+		.reset = fanout_reset,
+		.arg = &fs,
+	};
+	int depth = state->pipeline_depth;
+	const char *target = argv[1];
+	int i, err, matched = 0, failed = 0, usage = 0, missing = 0;
+
+	err = nl802154_dump(state, &dump);
 	if (err)
-		return 1;
+		goto out;
+
+	fs.results = calloc(fs.n_names, sizeof(*fs.results));
+	if (fs.n_names && !fs.results) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (!depth) {
+		err = set_pipeline_depth(state, FANOUT_PIPELINE_DEPTH);
+		if (err)
+			goto out;
+	}
+
+	for (i = 0; i < fs.n_names; i++) {
+		if (!fanout_match(target, fs.names[i])) {
+			fs.results[i] = -ENOENT;
+			continue;
+		}
+
+		matched++;
+		argv[1] = fs.names[i];
+		err = __handle_cmd_cb(state, fs.phy ? II_PHY_NAME : II_NETDEV,
+				      argc - 1, argv + 1, cmdout,
+				      fanout_done, &fs, i);
+		if (err)
+			fs.results[i] = err;
+	}
+	argv[1] = (char *)target;
+
+	flush_cmds(state);
+	if (!depth)
+		set_pipeline_depth(state, 0);
+
+	for (i = 0; i < fs.n_names; i++) {
+		if (!fanout_match(target, fs.names[i]))
+			continue;
+
+		err = fs.results[i];
+		render_begin(NULL);
+		render_s(fs.phy ? "phy" : "dev", fs.names[i]);
+		if (!err) {
+			render_text("%s: ok\n", fs.names[i]);
+		} else if (err == 1) {
+			render_text("%s: invalid arguments\n", fs.names[i]);
+			usage++;
+		} else if (err < 0) {
+			render_text("%s: failed: %s (%d)\n", fs.names[i],
+				    strerror(-err), err);
+		} else {
+			render_text("%s: failed (%d)\n", fs.names[i], err);
+		}
+		render_d("status", err);
+		render_end();
+		if (err)
+			failed++;
+	}
+
+	if (strcmp(target, "all") != 0)
+		missing = fanout_missing(&fs, target);
+
+	if (!matched) {
+		if (!missing)
+			fprintf(stderr, "no %s matches %s\n",
+				fs.phy ? "phy" : "dev", target);
+		err = -ENODEV;
+	} else if (missing) {
+		err = 2;
+	} else if (usage == matched) {
+		err = 1;
+	} else {
+		err = failed ? 2 : 0;
+	}
+out:
+	for (i = 0; i < fs.n_names; i++)
+		free(fs.names[i]);
+	free(fs.names);
+	free(fs.results);
+	return err;
+}
 
-	if (strcmp(*argv, "dev") == 0 && argc > 1) {
+/* Identify the device the command operates on and run it */
+int handle_args(struct nl802154_state *state, int argc, char **argv,
+		const struct cmd **cmdout, cmd_done_t done, void *priv,
+		long tag)
+{
+	int err;
+
+	if ((strcmp(*argv, "dev") == 0 || strcmp(*argv, "phy") == 0) &&
+	    argc > 2 && is_fanout_target(argv[1])) {
+		/* the outcome is only known once all targets are done */
+		err = handle_fanout(state, argc, argv, cmdout);
+		/* failures go to the caller, like those of a request not queued */
+		if (!err && done)
+			done(cmdout ? *cmdout : NULL, 0, priv, tag);
+	} else if (strcmp(*argv, "dev") == 0 && argc > 1) {
 		argc--;
 		argv++;
-		err = __handle_cmd(&nlstate, II_NETDEV, argc, argv, &cmd);
+		err = __handle_cmd_cb(state, II_NETDEV, argc, argv, cmdout,
+				      done, priv, tag);
 	} else if (strncmp(*argv, "phy", 3) == 0 && argc > 1) {
 		if (strlen(*argv) == 3) {
 			argc--;
 			argv++;
-			err = __handle_cmd(&nlstate, II_PHY_NAME, argc, argv, &cmd);
+			err = __handle_cmd_cb(state, II_PHY_NAME, argc, argv, cmdout,
+					      done, priv, tag);
 		} else if (*(*argv + 3) == '#')
-			err = __handle_cmd(&nlstate, II_PHY_IDX, argc, argv, &cmd);
+			err = __handle_cmd_cb(state, II_PHY_IDX, argc, argv, cmdout,
+					      done, priv, tag);
 		else
 			goto detect;
 	} else if (strcmp(*argv, "wdev") == 0 && argc > 1) {
 		argc--;
 		argv++;
-		err = __handle_cmd(&nlstate, II_WPAN_DEV, argc, argv, &cmd);
+		err = __handle_cmd_cb(state, II_WPAN_DEV, argc, argv, cmdout,
+				      done, priv, tag);
 	} else {
 		int idx;
 		enum id_input idby = II_NONE;
+		uint64_t t;
  detect:
-		if ((idx = if_nametoindex(argv[0])) != 0)
+		t = timing_now();
+		if ((idx = names_ifindex(argv[0])) != 0)
 			idby = II_NETDEV;
-		else if ((idx = phy_lookup(argv[0])) >= 0)
+		else if ((idx = names_phy(argv[0])) >= 0)
 			idby = II_PHY_NAME;
-		err = __handle_cmd(&nlstate, idby, argc, argv, &cmd);
+		timing_add(TIMING_LOOKUP, t);
+		err = __handle_cmd_cb(state, idby, argc, argv, cmdout,
+				      done, priv, tag);
+	}
+
+	return err;
+}
+
+/* split a batch line into arguments, honouring quotes and comments */
+int batch_split_line(char *line, char **argv)
+{
+	int argc = 0;
+	char *dst;
+	char quote;
+
+	while (*line) {
+		while (*line == ' ' || *line == '\t' || *line == '\n' ||
+		       *line == '\r')
+			line++;
+		if (!*line || *line == '#')
+			break;
+		if (argc == BATCH_MAX_ARGS)
+			return -E2BIG;
+
+		argv[argc++] = dst = line;
+		quote = 0;
+		while (*line) {
+			if (quote && *line == quote) {
+				quote = 0;
+			} else if (!quote && (*line == '"' || *line == '\'')) {
+				quote = *line;
+			} else if (!quote && (*line == ' ' || *line == '\t' ||
+					      *line == '\n' || *line == '\r')) {
+				line++;
+				break;
+			} else {
+				*dst++ = *line;
+			}
+			line++;
+		}
+		*dst = '\0';
+		if (quote)
+			return -EINVAL;
 	}
 
+	return argc;
+}
+
+struct batch_state {
+	const char *name;
+	int ret;
+};
+
+static void batch_report(const struct cmd *cmd, int err, void *priv,
+			 long lineno)
+{
+	struct batch_state *bs = priv;
+
+	if (!err)
+		return;
+
+	if (err == 1) {
+		fprintf(stderr, "%s:%ld: invalid arguments\n", bs->name, lineno);
+		if (cmd)
+			usage_cmd(cmd);
+	} else if (err < 0) {
+		fprintf(stderr, "%s:%ld: command failed: %s (%d)\n",
+			bs->name, lineno, strerror(-err), err);
+	} else {
+		fprintf(stderr, "%s:%ld: command failed (%d)\n",
+			bs->name, lineno, err);
+	}
+
+	bs->ret = err;
+}
+
+/*
+ * Run the commands of a batch file. With a pipeline depth set, failures of
+ * queued commands are only seen when the pipeline is flushed, so without
+ * -force a few lines after the failing one may already have been applied.
+ */
+static int handle_batch(struct nl802154_state *state, const char *name,
+			bool force)
+{
+	struct batch_state bs = { .ret = 0 };
+	char *argv[BATCH_MAX_ARGS];
+	char *line = NULL;
+	size_t len = 0;
+	int argc, err, lineno = 0;
+	const struct cmd *cmd;
+	FILE *f;
+
+	if (strcmp(name, "-") == 0) {
+		f = stdin;
+		name = "<stdin>";
+	} else {
+		f = fopen(name, "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open batch file %s: %s\n",
+				name, strerror(errno));
+			return -errno;
+		}
+	}
+	bs.name = name;
+
+	while (getline(&line, &len, f) >= 0) {
+		lineno++;
+
+		argc = batch_split_line(line, argv);
+		if (argc < 0) {
+			flush_cmds(state);
+			fprintf(stderr, "%s:%d: cannot parse line\n", name, lineno);
+			bs.ret = 1;
+		} else if (argc > 0) {
+			cmd = NULL;
+			err = handle_args(state, argc, argv, &cmd, batch_report,
+					  &bs, lineno);
+			if (err) {
+				/* keep the reports in line order */
+				flush_cmds(state);
+				batch_report(cmd, err, &bs, lineno);
+			}
+			timing_end(cmd, "unknown");
+		}
+
+		if (bs.ret && !force)
+			break;
+	}
+
+	flush_cmds(state);
+	render_done();
+	timing_end(NULL, "batch end");
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return bs.ret;
+}
+
+/* Run a single command line, reporting errors like the command line does */
+int run_command(struct nl802154_state *state, int argc, char **argv)
+{
+	const struct cmd *cmd = NULL;
+	int err;
+
+	if (argc == 0 || strcmp(*argv, "help") == 0) {
+		usage(argc - 1, argv + 1);
+		return 0;
+	}
+
+	err = handle_args(state, argc, argv, &cmd, NULL, NULL, 0);
+	render_done();
+	timing_end(cmd, "unknown");
+
 	if (err == 1) {
 		if (cmd)
 			usage_cmd(cmd);
@@ -531,7 +1741,141 @@ int main(int argc, char **argv)
 	} else if (err < 0)
 		fprintf(stderr, "command failed: %s (%d)\n", strerror(-err), err);
 
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	struct nl802154_state nlstate;
+	const char *socket_path = IWPAN_DAEMON_SOCKET;
+	const char *batch = NULL;
+	bool force = false, local = false, cache = false;
+	int depth = 0, rcvbuf = NL_RCVBUF_DEFAULT;
+	char *end;
+	int err;
+
+	/* calculate command size including padding */
+	cmd_size = labs((long)&__section_set - (long)&__section_get);
+	render_init();
+	if (cmd_index_init()) {
+		fprintf(stderr, "failed to allocate command index\n");
+		return 1;
+	}
+	/* strip off self */
+	argc--;
+	argv0 = *argv++;
+
+	if (argc > 0 && strcmp(*argv, "--debug") == 0) {
+		iwpan_debug = 1;
+		argc--;
+		argv++;
+	}
+
+	if (argc > 0 && strcmp(*argv, "--version") == 0) {
+		version();
+		return 0;
+	}
+
+	while (argc > 0) {
+		if (strcmp(*argv, "-batch") == 0 && argc > 1) {
+			batch = argv[1];
+			argc -= 2;
+			argv += 2;
+		} else if (strcmp(*argv, "-force") == 0) {
+			force = true;
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "-pipeline") == 0 && argc > 1) {
+			depth = strtol(argv[1], &end, 0);
+			if (*end != '\0' || depth < 1) {
+				fprintf(stderr, "invalid pipeline depth %s\n",
+					argv[1]);
+				return 1;
+			}
+			argc -= 2;
+			argv += 2;
+		} else if (strcmp(*argv, "-socket") == 0 && argc > 1) {
+			socket_path = argv[1];
+			argc -= 2;
+			argv += 2;
+		} else if (strcmp(*argv, "-local") == 0) {
+			local = true;
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "-cache") == 0) {
+			cache = true;
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "-rcvbuf") == 0 && argc > 1) {
+			rcvbuf = strtol(argv[1], &end, 0);
+			if (*end != '\0' || rcvbuf < 4096 ||
+			    rcvbuf > NL_RCVBUF_MAX) {
+				fprintf(stderr, "invalid receive buffer size %s\n",
+					argv[1]);
+				return 1;
+			}
+			argc -= 2;
+			argv += 2;
+		} else if (strcmp(*argv, "--timing") == 0) {
+			timing_enable();
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "-dumpstats") == 0) {
+			dump_stats = true;
+			argc--;
+			argv++;
+		} else if (strcmp(*argv, "-format") == 0 && argc > 1) {
+			if (render_set_format(argv[1])) {
+				fprintf(stderr, "invalid output format %s\n",
+					argv[1]);
+				return 1;
+			}
+			argc -= 2;
+			argv += 2;
+		} else {
+			break;
+		}
+	}
+
+	if (batch) {
+		if (argc) {
+			usage(0, NULL);
+			return 1;
+		}
+		if (nl802154_init(&nlstate, cache, rcvbuf))
+			return 1;
+		timing_end(NULL, "startup");
+		if (set_pipeline_depth(&nlstate, depth)) {
+			nl802154_cleanup(&nlstate);
+			return 1;
+		}
+		err = handle_batch(&nlstate, batch, force);
+		nl802154_cleanup(&nlstate);
+		timing_report();
+		return err;
+	}
+
+	/* need to treat "help" command specially so it works w/o nl802154 */
+	if (argc == 0 || strcmp(*argv, "help") == 0) {
+		usage(argc - 1, argv + 1);
+		return 0;
+	}
+
+	/* let a running daemon do the work, it has everything set up */
+	if (!local && !iwpan_debug && !dump_stats && !iwpan_timing &&
+	    strcmp(*argv, "daemon") != 0 &&
+	    daemon_forward(socket_path, argc, argv, &err) == 0)
+		return err;
+
+	err = nl802154_init(&nlstate, cache, rcvbuf);
+	if (err)
+		return 1;
+	timing_end(NULL, "startup");
+
+	err = run_command(&nlstate, argc, argv);
+
 	nl802154_cleanup(&nlstate);
+	timing_report();
 
 	return err;
 }
@@ -17,9 +17,36 @@
 /* TODO libnl1 compatibility */
 //#define nl_sock nl_handle
 
+struct cmd_request;
+
+#define NL802154_MAX_GROUPS	8
+#define NL802154_GROUP_NAMSIZ	16
+
+struct nl802154_group {
+	char name[NL802154_GROUP_NAMSIZ];
+	int id;
+};
+
 struct nl802154_state {
 	struct nl_sock *nl_sock;
 	int nl802154_id;
+	int nl802154_version;
+	/* requests queued for a single send, see flush_cmds() */
+	struct cmd_request *pipeline;
+	int pipeline_depth;
+	int pipeline_len;
+	/* multicast group ids resolved so far */
+	struct nl802154_group groups[NL802154_MAX_GROUPS];
+	int n_groups;
+	/* all groups of the family are known, no need to ask for others */
+	bool groups_complete;
+	/* receive buffer size, grows when dumps overrun it */
+	int rcvbuf;
+	/*
+	 * Called before running a command which drives the socket itself,
+	 * returns 0 to run it here, > 0 if it was handed off.
+	 */
+	int (*isolate)(struct nl802154_state *state);
 };
 
 enum command_identify_by {
@@ -105,14 +132,157 @@ struct cmd {
 #define DECLARE_SECTION(_name)						\
 	extern struct cmd __section ## _ ## _name;
 
+/* rounded, -16.3 is not quite -16.3 as a float */
 #define DBM_TO_MBM(gain)						\
-	((int)(((float)gain) * 100))
+	((int)(((float)(gain)) * 100 + ((gain) < 0 ? -0.5f : 0.5f)))
 #define MBM_TO_DBM(gain)						\
 	((float)(gain) / 100)
 
 int handle_cmd(struct nl802154_state *state, enum id_input idby,
 	       int argc, char **argv);
 
+/* completion of a pipelined command, err as returned by handle_cmd() */
+typedef void (*cmd_done_t)(const struct cmd *cmd, int err, void *priv,
+			   long tag);
+
+int handle_args(struct nl802154_state *state, int argc, char **argv,
+		const struct cmd **cmdout, cmd_done_t done, void *priv,
+		long tag);
+
+#define BATCH_MAX_ARGS	64
+
+int batch_split_line(char *line, char **argv);
+
+#define PIPELINE_RCVBUF_PER_REQ	4096
+
+int set_pipeline_depth(struct nl802154_state *state, int depth);
+int flush_cmds(struct nl802154_state *state);
+
+int nl802154_resolve_family(struct nl802154_state *state);
+int nl802154_resolve_grp(struct nl802154_state *state, const char *name);
+int nl802154_reconnect(struct nl802154_state *state);
+int run_command(struct nl802154_state *state, int argc, char **argv);
+
+/*
+ * A dump of cmd outside of the command table, restricted to one interface
+ * if ifindex is set. valid is called for each object. If the objects
+ * changed while the dump was read it is retried, reset has to drop what
+ * valid collected so far.
+ */
+struct dump_req {
+	enum nl802154_commands cmd;
+	uint32_t ifindex;
+	nl_recvmsg_msg_cb_t valid;
+	void (*reset)(void *arg);
+	void *arg;
+	/* set by nl802154_dump(), identifies the interface lists seen */
+	uint64_t generation;
+};
+
+int nl802154_dump(struct nl802154_state *state, struct dump_req *req);
+
+struct iwpan_iface;
+struct iwpan_phy;
+int nl802154_get_iface(struct nl802154_state *state, uint32_t ifindex,
+		       struct iwpan_iface *iface, struct iwpan_phy *phy);
+
+#define IWPAN_DAEMON_SOCKET	"/run/iwpan.sock"
+#define IWPAN_CACHE_DIR		"/run/iwpan"
+
+int genl_cache_load(struct nl802154_state *state);
+void genl_cache_store(const struct nl802154_state *state);
+
+int daemon_forward(const char *path, int argc, char **argv, int *status);
+
+/* name and index cache of netdevs and phys, see names.c */
+#define NAMES_WATCH_FDS	2
+
+struct pollfd;
+int names_load(struct nl802154_state *state);
+void names_update(struct nl_msg *msg);
+int names_watch(struct nl802154_state *state, struct pollfd *pfd);
+void names_watch_read(struct nl802154_state *state, const struct pollfd *pfd);
+unsigned int names_ifindex(const char *name);
+char *names_ifname(unsigned int ifindex, char *buf);
+int names_phy(const char *name);
+bool names_drop(void);
+
+/* namespace files of "set netns", see phy.c */
+int netns_get_fd(const char *name);
+void netns_cache_fds(bool on);
+
+int apply_setting(int argc, char **argv, struct iwpan_phy *phy,
+		  struct iwpan_iface *iface, bool *is_phy);
+
+#define IWPAN_PROFILE_DIR	"/etc/iwpan/profiles"
+
+/* echo probes answered by "wpan-ping -d", see probe.c */
+#define PROBE_MAX_WINDOW	16
+#define PROBE_MAX_LEN		105
+
+struct probe_peer {
+	uint16_t pan_id;
+	bool extended;
+	uint16_t short_addr;
+	uint64_t extended_addr;
+};
+
+struct probe_result {
+	unsigned int sent;
+	unsigned int received;
+	uint64_t bytes;
+	uint64_t rtt_us;
+	uint64_t elapsed_us;
+	/* if set, the round trip of each answer, up to max_rtts of them */
+	uint32_t *rtts;
+	unsigned int max_rtts;
+};
+
+int probe_parse_addr(const char *arg, struct probe_peer *peer);
+int probe_open(const struct iwpan_iface *iface, struct probe_peer *peer);
+int probe_link(int sd, const char *dev, bool up);
+int probe_run(int sd, const struct probe_peer *peer, unsigned int count,
+	      unsigned int window, unsigned int len, unsigned int timeout_ms,
+	      struct probe_result *res);
+double probe_throughput(const struct probe_result *res);
+double probe_latency(const struct probe_result *res);
+double probe_loss(const struct probe_result *res);
+double probe_percentile(struct probe_result *res, unsigned int pct);
+
+/*
+ * Output of info and dump commands, see render.c. render_text() is only
+ * emitted in text mode, the typed fields only in json and table mode.
+ */
+enum render_format {
+	RENDER_TEXT,
+	RENDER_JSON,
+	RENDER_TABLE,
+};
+
+void render_init(void);
+int render_set_format(const char *name);
+const char *render_format_name(void);
+enum render_format render_format(void);
+void render_text(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void render_begin(const char *key);
+void render_end(void);
+void render_list_begin(const char *key);
+void render_list_end(void);
+void render_u(const char *key, unsigned long long val);
+void render_d(const char *key, long long val);
+void render_x(const char *key, unsigned long long val, int width);
+void render_f(const char *key, double val);
+void render_bool(const char *key, bool val);
+void render_s(const char *key, const char *val);
+struct iwpan_field;
+void render_field(const char *indent, const struct iwpan_field *f,
+		  const void *obj);
+void render_flush(void);
+void render_done(void);
+/* drop everything rendered since the last render_save(), for retried dumps */
+void render_save(void);
+void render_restore(void);
+
 DECLARE_SECTION(set);
 DECLARE_SECTION(get);
 
@@ -120,4 +290,27 @@ const char *iftype_name(enum nl802154_iftype iftype);
 
 extern int iwpan_debug;
 
+/* phases --timing tells apart, see timing.c */
+enum timing_phase {
+	TIMING_INIT,
+	TIMING_RESOLVE,
+	TIMING_LOOKUP,
+	TIMING_BUILD,
+	TIMING_KERNEL,
+	TIMING_HANDLE,
+	TIMING_OUTPUT,
+	TIMING_PHASES,
+};
+
+extern bool iwpan_timing;
+
+void timing_enable(void);
+uint64_t timing_now(void);
+void timing_add(enum timing_phase phase, uint64_t since);
+uint64_t timing_get(enum timing_phase phase);
+void timing_add_handled(uint64_t since, uint64_t kernel);
+void timing_cb(struct nl_cb *cb);
+void timing_end(const struct cmd *cmd, const char *name);
+void timing_report(void);
+
 #endif /* __IWPAN_H */
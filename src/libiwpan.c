@@ -0,0 +1,951 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <endian.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "nl_extras.h"
+#include "nl_sock.h"
+#include "libiwpan.h"
+#include "nl802154_schema.h"
+
+struct iwpan {
+	struct nl_sock *nl_sock;
+	int nl802154_id;
+};
+
+#define PHY_FIELD(...)		IWPAN_SCHEMA_FIELD(iwpan_phy, __VA_ARGS__)
+#define IFACE_FIELD(...)	IWPAN_SCHEMA_FIELD(iwpan_iface, __VA_ARGS__)
+#define COORD_FIELD(...)	IWPAN_SCHEMA_FIELD(iwpan_coord, __VA_ARGS__)
+#define ASSOC_FIELD(...)	IWPAN_SCHEMA_FIELD(iwpan_assoc, __VA_ARGS__)
+#define CAPS_FIELD(...)		IWPAN_SCHEMA_FIELD(iwpan_caps, __VA_ARGS__)
+
+const struct iwpan_field iwpan_phy_fields[] = {
+	IWPAN_PHY_SCHEMA(PHY_FIELD)
+	{ .name = NULL },
+};
+
+const struct iwpan_field iwpan_iface_fields[] = {
+	IWPAN_IFACE_SCHEMA(IFACE_FIELD)
+	{ .name = NULL },
+};
+
+const struct iwpan_field iwpan_coord_fields[] = {
+	IWPAN_COORD_SCHEMA(COORD_FIELD)
+	{ .name = NULL },
+};
+
+const struct iwpan_field iwpan_assoc_fields[] = {
+	IWPAN_ASSOC_SCHEMA(ASSOC_FIELD)
+	{ .name = NULL },
+};
+
+static const struct iwpan_field caps_fields[] = {
+	IWPAN_CAPS_SCHEMA(CAPS_FIELD)
+	{ .name = NULL },
+};
+
+/* TODO fix netlink lib that we can use NLA_S32 here
+ * see function  validate_nla line if (pt->type > NLA_TYPE_MAX) */
+static struct nla_policy phy_policy[NL802154_ATTR_MAX + 1] = {
+	IWPAN_PHY_SCHEMA(IWPAN_SCHEMA_POLICY)
+	[NL802154_ATTR_WPAN_PHY] = { .type = NLA_U32 },
+	[NL802154_ATTR_CHANNELS_SUPPORTED] = { .type = NLA_NESTED },
+	[NL802154_ATTR_WPAN_PHY_CAPS] = { .type = NLA_NESTED },
+};
+
+static struct nla_policy iface_policy[NL802154_ATTR_MAX + 1] = {
+	IWPAN_IFACE_SCHEMA(IWPAN_SCHEMA_POLICY)
+};
+
+static struct nla_policy coord_policy[NL802154_COORD_MAX + 1] = {
+	IWPAN_COORD_SCHEMA(IWPAN_SCHEMA_POLICY)
+	[NL802154_COORD_ADDR] = { .minlen = 2, .maxlen = 8, }, /* 2 or 8 */
+	[NL802154_COORD_GTS_PERMIT] = { .type = NLA_FLAG, },
+};
+
+static struct nla_policy assoc_policy[NL802154_DEV_ADDR_ATTR_MAX + 1] = {
+	IWPAN_ASSOC_SCHEMA(IWPAN_SCHEMA_POLICY)
+	[NL802154_DEV_ADDR_ATTR_MODE] = { .type = NLA_U8, },
+};
+
+static struct nla_policy caps_policy[NL802154_CAP_ATTR_MAX + 1] = {
+	IWPAN_CAPS_SCHEMA(IWPAN_SCHEMA_POLICY)
+	[NL802154_CAP_ATTR_CHANNELS] = { .type = NLA_NESTED },
+	[NL802154_CAP_ATTR_TX_POWERS] = { .type = NLA_NESTED },
+	[NL802154_CAP_ATTR_CCA_ED_LEVELS] = { .type = NLA_NESTED },
+	[NL802154_CAP_ATTR_CCA_MODES] = { .type = NLA_NESTED },
+	[NL802154_CAP_ATTR_CCA_OPTS] = { .type = NLA_NESTED },
+	[NL802154_CAP_ATTR_IFTYPES] = { .type = NLA_NESTED },
+};
+
+int64_t iwpan_field_get(const struct iwpan_field *f, const void *obj)
+{
+	const char *p = (const char *)obj + f->offset;
+
+	switch (f->type) {
+	case IWPAN_FIELD_U8:
+		return *(const uint8_t *)p;
+	case IWPAN_FIELD_S8:
+		return *(const int8_t *)p;
+	case IWPAN_FIELD_U16:
+		return *(const uint16_t *)p;
+	case IWPAN_FIELD_U32:
+		return *(const uint32_t *)p;
+	case IWPAN_FIELD_S32:
+		return *(const int32_t *)p;
+	case IWPAN_FIELD_U64:
+		return *(const uint64_t *)p;
+	default:
+		return 0;
+	}
+}
+
+/* enums are stored in members wider than their attribute */
+static void field_store(const struct iwpan_field *f, void *obj, uint64_t val)
+{
+	char *p = (char *)obj + f->offset;
+
+	switch (f->size) {
+	case 1:
+		*(uint8_t *)p = val;
+		break;
+	case 2:
+		*(uint16_t *)p = val;
+		break;
+	case 4:
+		*(uint32_t *)p = val;
+		break;
+	case 8:
+		*(uint64_t *)p = val;
+		break;
+	}
+}
+
+static uint32_t parse_fields(struct nlattr **tb, const struct iwpan_field *f,
+			     void *obj)
+{
+	struct nlattr *attr;
+	uint32_t valid = 0;
+	uint64_t val;
+
+	for (; f->name; f++) {
+		attr = tb[f->attr];
+		if (!attr)
+			continue;
+
+		switch (f->type) {
+		case IWPAN_FIELD_U8:
+			val = nla_get_u8(attr);
+			break;
+		case IWPAN_FIELD_S8:
+			val = (int8_t)nla_get_u8(attr);
+			break;
+		case IWPAN_FIELD_U16:
+			val = nla_get_u16(attr);
+			if (f->le)
+				val = le16toh(val);
+			break;
+		case IWPAN_FIELD_U32:
+			val = nla_get_u32(attr);
+			break;
+		case IWPAN_FIELD_S32:
+			val = (int32_t)nla_get_u32(attr);
+			break;
+		case IWPAN_FIELD_U64:
+			val = nla_get_u64(attr);
+			if (f->le)
+				val = le64toh(val);
+			break;
+		case IWPAN_FIELD_STR:
+			strncpy((char *)obj + f->offset, nla_get_string(attr),
+				f->size - 1);
+			valid |= f->valid;
+			continue;
+		default:
+			continue;
+		}
+
+		field_store(f, obj, val);
+		valid |= f->valid;
+	}
+
+	return valid;
+}
+
+static int parse_attrs(struct nl_msg *msg, struct nlattr **tb,
+		       struct nla_policy *policy)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+
+	if (nla_parse(tb, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		      genlmsg_attrlen(gnlh, 0), policy))
+		return -EIO;
+
+	return 0;
+}
+
+static int parse_levels(struct nlattr *nested, int32_t **levels, int *n)
+{
+	struct nlattr *nl_level;
+	int rem, i = 0;
+
+	*n = 0;
+	nla_for_each_nested(nl_level, nested, rem)
+		(*n)++;
+	if (!*n)
+		return 0;
+
+	*levels = calloc(*n, sizeof(**levels));
+	if (!*levels)
+		return -ENOMEM;
+
+	nla_for_each_nested(nl_level, nested, rem)
+		(*levels)[i++] = nla_get_s32(nl_level);
+
+	return 0;
+}
+
+static uint32_t parse_type_mask(struct nlattr *nested)
+{
+	struct nlattr *nl_type;
+	uint32_t mask = 0;
+	int rem;
+
+	nla_for_each_nested(nl_type, nested, rem) {
+		if (nla_type(nl_type) < 32)
+			mask |= 1U << nla_type(nl_type);
+	}
+
+	return mask;
+}
+
+static int parse_caps(struct nlattr *nested, struct iwpan_caps *caps)
+{
+	struct nlattr *tb_caps[NL802154_CAP_ATTR_MAX + 1];
+	int ret;
+
+	ret = nla_parse_nested(tb_caps, NL802154_CAP_ATTR_MAX, nested,
+			       caps_policy);
+	if (ret)
+		return -EIO;
+
+	if (tb_caps[NL802154_CAP_ATTR_IFTYPES]) {
+		caps->iftypes = parse_type_mask(tb_caps[NL802154_CAP_ATTR_IFTYPES]);
+		caps->valid |= IWPAN_CAPS_IFTYPES;
+	}
+
+	if (tb_caps[NL802154_CAP_ATTR_CHANNELS]) {
+		struct nlattr *nl_pages;
+		int rem_pages;
+
+		nla_for_each_nested(nl_pages, tb_caps[NL802154_CAP_ATTR_CHANNELS],
+				    rem_pages) {
+			if (nla_type(nl_pages) >= IWPAN_MAX_PAGES)
+				continue;
+			caps->channels[nla_type(nl_pages)] =
+				parse_type_mask(nl_pages);
+		}
+		caps->valid |= IWPAN_CAPS_CHANNELS;
+	}
+
+	if (tb_caps[NL802154_CAP_ATTR_TX_POWERS]) {
+		ret = parse_levels(tb_caps[NL802154_CAP_ATTR_TX_POWERS],
+				   &caps->tx_powers, &caps->n_tx_powers);
+		if (ret)
+			return ret;
+		caps->valid |= IWPAN_CAPS_TX_POWERS;
+	}
+
+	if (tb_caps[NL802154_CAP_ATTR_CCA_ED_LEVELS]) {
+		ret = parse_levels(tb_caps[NL802154_CAP_ATTR_CCA_ED_LEVELS],
+				   &caps->cca_ed_levels, &caps->n_cca_ed_levels);
+		if (ret)
+			return ret;
+		caps->valid |= IWPAN_CAPS_CCA_ED_LEVELS;
+	}
+
+	if (tb_caps[NL802154_CAP_ATTR_CCA_MODES]) {
+		caps->cca_modes = parse_type_mask(tb_caps[NL802154_CAP_ATTR_CCA_MODES]);
+		caps->valid |= IWPAN_CAPS_CCA_MODES;
+	}
+
+	if (tb_caps[NL802154_CAP_ATTR_CCA_OPTS]) {
+		caps->cca_opts = parse_type_mask(tb_caps[NL802154_CAP_ATTR_CCA_OPTS]);
+		caps->valid |= IWPAN_CAPS_CCA_OPTS;
+	}
+
+	parse_fields(tb_caps, caps_fields, caps);
+
+	if (tb_caps[NL802154_CAP_ATTR_MIN_MINBE] &&
+	    tb_caps[NL802154_CAP_ATTR_MAX_MINBE] &&
+	    tb_caps[NL802154_CAP_ATTR_MIN_MAXBE] &&
+	    tb_caps[NL802154_CAP_ATTR_MAX_MAXBE])
+		caps->valid |= IWPAN_CAPS_BE;
+
+	if (tb_caps[NL802154_CAP_ATTR_MIN_CSMA_BACKOFFS] &&
+	    tb_caps[NL802154_CAP_ATTR_MAX_CSMA_BACKOFFS])
+		caps->valid |= IWPAN_CAPS_CSMA_BACKOFFS;
+
+	if (tb_caps[NL802154_CAP_ATTR_MIN_FRAME_RETRIES] &&
+	    tb_caps[NL802154_CAP_ATTR_MAX_FRAME_RETRIES])
+		caps->valid |= IWPAN_CAPS_FRAME_RETRIES;
+
+	if (tb_caps[NL802154_CAP_ATTR_LBT])
+		caps->valid |= IWPAN_CAPS_LBT;
+
+	return 0;
+}
+
+int iwpan_parse_phy(struct nl_msg *msg, struct iwpan_phy *phy)
+{
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+	int ret;
+
+	memset(phy, 0, sizeof(*phy));
+	if (parse_attrs(msg, tb, phy_policy))
+		return -EIO;
+
+	if (!tb[NL802154_ATTR_WPAN_PHY])
+		return -EINVAL;
+	phy->index = nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]);
+
+	phy->valid = parse_fields(tb, iwpan_phy_fields, phy);
+
+	if (tb[NL802154_ATTR_CHANNELS_SUPPORTED]) {
+		struct nlattr *nl_page;
+		int page = 0, rem_page;
+
+		nla_for_each_nested(nl_page, tb[NL802154_ATTR_CHANNELS_SUPPORTED],
+				    rem_page) {
+			if (page == IWPAN_MAX_PAGES)
+				break;
+			phy->channels_supported[page++] = nla_get_u32(nl_page);
+		}
+		phy->valid |= IWPAN_PHY_CHANNELS_SUPPORTED;
+	}
+
+	if (tb[NL802154_ATTR_WPAN_PHY_CAPS]) {
+		ret = parse_caps(tb[NL802154_ATTR_WPAN_PHY_CAPS], &phy->caps);
+		if (ret) {
+			iwpan_phy_free(phy);
+			return ret;
+		}
+		phy->valid |= IWPAN_PHY_CAPS;
+	}
+
+	return 0;
+}
+
+void iwpan_phy_free(struct iwpan_phy *phy)
+{
+	free(phy->caps.tx_powers);
+	phy->caps.tx_powers = NULL;
+	phy->caps.n_tx_powers = 0;
+	free(phy->caps.cca_ed_levels);
+	phy->caps.cca_ed_levels = NULL;
+	phy->caps.n_cca_ed_levels = 0;
+}
+
+int iwpan_parse_iface(struct nl_msg *msg, struct iwpan_iface *iface)
+{
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+
+	memset(iface, 0, sizeof(*iface));
+	if (parse_attrs(msg, tb, iface_policy))
+		return -EIO;
+
+	iface->valid = parse_fields(tb, iwpan_iface_fields, iface);
+
+	return 0;
+}
+
+int iwpan_parse_assoc(struct nlattr *nested, struct iwpan_assoc *assoc)
+{
+	struct nlattr *tb[NL802154_DEV_ADDR_ATTR_MAX + 1];
+	int ret;
+
+	ret = nla_parse_nested(tb, NL802154_DEV_ADDR_ATTR_MAX, nested,
+			       assoc_policy);
+	if (ret < 0)
+		return ret;
+
+	if (!tb[NL802154_DEV_ADDR_ATTR_PEER_TYPE] ||
+	    !tb[NL802154_DEV_ADDR_ATTR_SHORT] ||
+	    !tb[NL802154_DEV_ADDR_ATTR_EXTENDED])
+		return -EINVAL;
+
+	memset(assoc, 0, sizeof(*assoc));
+	parse_fields(tb, iwpan_assoc_fields, assoc);
+
+	return 0;
+}
+
+int iwpan_parse_coord(struct nlattr *nested, struct iwpan_coord *coord)
+{
+	struct nlattr *pan[NL802154_COORD_MAX + 1];
+	int ret;
+
+	memset(coord, 0, sizeof(*coord));
+
+	ret = nla_parse_nested(pan, NL802154_COORD_MAX, nested, coord_policy);
+	if (ret < 0)
+		return ret;
+	if (!pan[NL802154_COORD_PANID])
+		return -EINVAL;
+
+	coord->valid = parse_fields(pan, iwpan_coord_fields, coord);
+
+	if (pan[NL802154_COORD_ADDR]) {
+		struct nlattr *addr = pan[NL802154_COORD_ADDR];
+
+		if (nla_len(addr) == 2) {
+			coord->addr_len = 2;
+			coord->short_addr = le16toh(nla_get_u16(addr));
+		} else {
+			coord->addr_len = 8;
+			coord->extended_addr = le64toh(nla_get_u64(addr));
+		}
+		coord->valid |= IWPAN_COORD_ADDR;
+	}
+	if (pan[NL802154_COORD_GTS_PERMIT])
+		coord->valid |= IWPAN_COORD_GTS_PERMIT;
+
+	return 0;
+}
+
+struct iwpan *iwpan_open(void)
+{
+	struct iwpan *iw;
+
+	iw = calloc(1, sizeof(*iw));
+	if (!iw)
+		return NULL;
+
+	iw->nl_sock = nl_socket_alloc();
+	if (!iw->nl_sock)
+		goto out_free;
+
+	if (genl_connect(iw->nl_sock))
+		goto out_sock;
+
+	nlsock_tune(iw->nl_sock, NL_RCVBUF_DEFAULT);
+
+	iw->nl802154_id = genl_ctrl_resolve(iw->nl_sock, NL802154_GENL_NAME);
+	if (iw->nl802154_id < 0)
+		goto out_sock;
+
+	return iw;
+
+out_sock:
+	nl_socket_free(iw->nl_sock);
+out_free:
+	free(iw);
+	return NULL;
+}
+
+void iwpan_close(struct iwpan *iw)
+{
+	if (!iw)
+		return;
+
+	nl_socket_free(iw->nl_sock);
+	free(iw);
+}
+
+int iwpan_family(struct iwpan *iw)
+{
+	return iw->nl802154_id;
+}
+
+static struct nl_msg *iwpan_msg(struct iwpan *iw, int cmd, int flags)
+{
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return NULL;
+
+	if (!genlmsg_put(msg, 0, 0, iw->nl802154_id, 0, flags, cmd, 0)) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+
+	return msg;
+}
+
+static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
+			 void *arg)
+{
+	int *ret = arg;
+	*ret = err->error;
+	return NL_STOP;
+}
+
+static int finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int ack_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_STOP;
+}
+
+/* Send msg, hand replies to valid and wait for the ack. Frees msg. */
+static int iwpan_request(struct iwpan *iw, struct nl_msg *msg,
+			 nl_recvmsg_msg_cb_t valid, void *arg)
+{
+	struct nl_cb *cb;
+	int err;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!cb) {
+		nlmsg_free(msg);
+		return -ENOMEM;
+	}
+
+	err = nl_send_auto_complete(iw->nl_sock, msg);
+	nlmsg_free(msg);
+	if (err < 0) {
+		err = -EIO;
+		goto out;
+	}
+
+	err = 1;
+	nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
+	if (valid)
+		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, valid, arg);
+
+	while (err > 0) {
+		if (nl_recvmsgs(iw->nl_sock, cb) < 0 && err > 0)
+			err = -EIO;
+	}
+out:
+	nl_cb_put(cb);
+	return err;
+}
+
+struct dump_ctx {
+	void *cb;
+	void *priv;
+	/* first non-zero callback or parser result */
+	int ret;
+	/* for the get functions, the object asked for */
+	void *obj;
+};
+
+static int phy_valid(struct nl_msg *msg, void *arg)
+{
+	struct dump_ctx *ctx = arg;
+	struct iwpan_phy phy;
+	int ret;
+
+	if (ctx->ret)
+		return NL_SKIP;
+
+	ret = iwpan_parse_phy(msg, ctx->obj ? ctx->obj : &phy);
+	if (!ret && !ctx->obj) {
+		ret = ((iwpan_phy_cb)ctx->cb)(&phy, ctx->priv);
+		iwpan_phy_free(&phy);
+	}
+	ctx->ret = ret;
+
+	return NL_SKIP;
+}
+
+int iwpan_dump_phys(struct iwpan *iw, iwpan_phy_cb cb, void *priv)
+{
+	struct dump_ctx ctx = { .cb = cb, .priv = priv };
+	struct nl_msg *msg;
+	int err;
+
+	msg = iwpan_msg(iw, NL802154_CMD_GET_WPAN_PHY, NLM_F_DUMP);
+	if (!msg)
+		return -ENOMEM;
+
+	err = iwpan_request(iw, msg, phy_valid, &ctx);
+	return err ? err : ctx.ret;
+}
+
+int iwpan_get_phy(struct iwpan *iw, uint32_t index, struct iwpan_phy *phy)
+{
+	struct dump_ctx ctx = { .obj = phy };
+	struct nl_msg *msg;
+	int err;
+
+	msg = iwpan_msg(iw, NL802154_CMD_GET_WPAN_PHY, 0);
+	if (!msg)
+		return -ENOMEM;
+
+	NLA_PUT_U32(msg, NL802154_ATTR_WPAN_PHY, index);
+
+	err = iwpan_request(iw, msg, phy_valid, &ctx);
+	return err ? err : ctx.ret;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+static int iface_valid(struct nl_msg *msg, void *arg)
+{
+	struct dump_ctx *ctx = arg;
+	struct iwpan_iface iface;
+	int ret;
+
+	if (ctx->ret)
+		return NL_SKIP;
+
+	ret = iwpan_parse_iface(msg, ctx->obj ? ctx->obj : &iface);
+	if (!ret && !ctx->obj)
+		ret = ((iwpan_iface_cb)ctx->cb)(&iface, ctx->priv);
+	ctx->ret = ret;
+
+	return NL_SKIP;
+}
+
+int iwpan_dump_ifaces(struct iwpan *iw, iwpan_iface_cb cb, void *priv)
+{
+	struct dump_ctx ctx = { .cb = cb, .priv = priv };
+	struct nl_msg *msg;
+	int err;
+
+	msg = iwpan_msg(iw, NL802154_CMD_GET_INTERFACE, NLM_F_DUMP);
+	if (!msg)
+		return -ENOMEM;
+
+	err = iwpan_request(iw, msg, iface_valid, &ctx);
+	return err ? err : ctx.ret;
+}
+
+int iwpan_get_iface(struct iwpan *iw, uint32_t ifindex,
+		    struct iwpan_iface *iface)
+{
+	struct dump_ctx ctx = { .obj = iface };
+	struct nl_msg *msg;
+	int err;
+
+	msg = iwpan_msg(iw, NL802154_CMD_GET_INTERFACE, 0);
+	if (!msg)
+		return -ENOMEM;
+
+	NLA_PUT_U32(msg, NL802154_ATTR_IFINDEX, ifindex);
+
+	err = iwpan_request(iw, msg, iface_valid, &ctx);
+	return err ? err : ctx.ret;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+static int assoc_valid(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+	struct dump_ctx *ctx = arg;
+	struct iwpan_assoc assoc;
+	int ret;
+
+	if (ctx->ret)
+		return NL_SKIP;
+
+	parse_attrs(msg, tb, NULL);
+	if (!tb[NL802154_ATTR_PEER])
+		return NL_SKIP;
+
+	ret = iwpan_parse_assoc(tb[NL802154_ATTR_PEER], &assoc);
+	if (!ret)
+		ctx->ret = ((iwpan_assoc_cb)ctx->cb)(&assoc, ctx->priv);
+
+	return NL_SKIP;
+}
+
+int iwpan_dump_assocs(struct iwpan *iw, uint32_t ifindex,
+		      iwpan_assoc_cb cb, void *priv)
+{
+	struct dump_ctx ctx = { .cb = cb, .priv = priv };
+	struct nl_msg *msg;
+	int err;
+
+	msg = iwpan_msg(iw, NL802154_CMD_LIST_ASSOCIATIONS, NLM_F_DUMP);
+	if (!msg)
+		return -ENOMEM;
+
+	NLA_PUT_U32(msg, NL802154_ATTR_IFINDEX, ifindex);
+
+	err = iwpan_request(iw, msg, assoc_valid, &ctx);
+	return err ? err : ctx.ret;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+struct scan_ctx {
+	struct dump_ctx dump;
+	uint32_t ifindex;
+	bool done;
+};
+
+static int scan_valid(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+	struct scan_ctx *ctx = arg;
+	struct iwpan_coord coord;
+
+	parse_attrs(msg, tb, NULL);
+	if (!tb[NL802154_ATTR_IFINDEX] ||
+	    nla_get_u32(tb[NL802154_ATTR_IFINDEX]) != ctx->ifindex)
+		return NL_SKIP;
+
+	switch (gnlh->cmd) {
+	case NL802154_CMD_SCAN_EVENT:
+		if (ctx->dump.ret || !tb[NL802154_ATTR_COORDINATOR])
+			break;
+		if (iwpan_parse_coord(tb[NL802154_ATTR_COORDINATOR], &coord))
+			break;
+		coord.ifindex = ctx->ifindex;
+		coord.valid |= IWPAN_COORD_IFINDEX;
+		ctx->dump.ret = ((iwpan_coord_cb)ctx->dump.cb)(&coord,
+							       ctx->dump.priv);
+		break;
+	case NL802154_CMD_SCAN_DONE:
+	case NL802154_CMD_ABORT_SCAN:
+		ctx->done = true;
+		break;
+	default:
+		break;
+	}
+
+	return NL_SKIP;
+}
+
+static int no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+int iwpan_scan(struct iwpan *iw, uint32_t ifindex,
+	       const struct iwpan_scan_req *req,
+	       iwpan_coord_cb cb, void *priv)
+{
+	struct scan_ctx ctx = {
+		.dump = { .cb = cb, .priv = priv },
+		.ifindex = ifindex,
+	};
+	struct nl_sock *sock;
+	struct nl_cb *ncb;
+	struct nl_msg *msg;
+	int group, err;
+
+	/* a socket of its own, we join the scan group and skip seq checks */
+	sock = nl_socket_alloc();
+	if (!sock)
+		return -ENOMEM;
+
+	if (genl_connect(sock)) {
+		err = -ENOLINK;
+		goto out_sock;
+	}
+
+	/* results of a busy channel arrive as a burst */
+	nlsock_tune(sock, 8 * NL_RCVBUF_DEFAULT);
+
+	group = genl_ctrl_resolve_grp(sock, NL802154_GENL_NAME, "scan");
+	if (group < 0) {
+		err = group;
+		goto out_sock;
+	}
+
+	err = nl_socket_add_membership(sock, group);
+	if (err) {
+		err = -EIO;
+		goto out_sock;
+	}
+
+	msg = iwpan_msg(iw, NL802154_CMD_TRIGGER_SCAN, 0);
+	if (!msg) {
+		err = -ENOMEM;
+		goto out_sock;
+	}
+
+	NLA_PUT_U32(msg, NL802154_ATTR_IFINDEX, ifindex);
+	NLA_PUT_U8(msg, NL802154_ATTR_SCAN_TYPE, req->type);
+	if (req->duration >= 0)
+		NLA_PUT_U8(msg, NL802154_ATTR_SCAN_DURATION, req->duration);
+	if (req->page >= 0)
+		NLA_PUT_U8(msg, NL802154_ATTR_PAGE, req->page);
+	if (req->channels >= 0)
+		NLA_PUT_U32(msg, NL802154_ATTR_SCAN_CHANNELS, req->channels);
+
+	/* triggering is acked on the request socket */
+	err = iwpan_request(iw, msg, NULL, NULL);
+	if (err)
+		goto out_sock;
+
+	ncb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!ncb) {
+		err = -ENOMEM;
+		goto out_sock;
+	}
+	nl_cb_set(ncb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
+	nl_cb_set(ncb, NL_CB_VALID, NL_CB_CUSTOM, scan_valid, &ctx);
+
+	while (!ctx.done) {
+		if (nl_recvmsgs(sock, ncb) < 0) {
+			err = -EIO;
+			break;
+		}
+	}
+
+	nl_cb_put(ncb);
+	if (!err)
+		err = ctx.dump.ret;
+out_sock:
+	nl_socket_free(sock);
+	return err;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	err = -ENOBUFS;
+	goto out_sock;
+}
+
+static int set_phy_attrs(struct iwpan *iw, int cmd, uint32_t phy,
+			 int attr1, int len1, const void *val1,
+			 int attr2, int len2, const void *val2)
+{
+	struct nl_msg *msg;
+
+	msg = iwpan_msg(iw, cmd, 0);
+	if (!msg)
+		return -ENOMEM;
+
+	NLA_PUT_U32(msg, NL802154_ATTR_WPAN_PHY, phy);
+	NLA_PUT(msg, attr1, len1, val1);
+	if (val2)
+		NLA_PUT(msg, attr2, len2, val2);
+
+	return iwpan_request(iw, msg, NULL, NULL);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+static int set_iface_attrs(struct iwpan *iw, int cmd, uint32_t ifindex,
+			   int attr1, int len1, const void *val1,
+			   int attr2, int len2, const void *val2)
+{
+	struct nl_msg *msg;
+
+	msg = iwpan_msg(iw, cmd, 0);
+	if (!msg)
+		return -ENOMEM;
+
+	NLA_PUT_U32(msg, NL802154_ATTR_IFINDEX, ifindex);
+	NLA_PUT(msg, attr1, len1, val1);
+	if (val2)
+		NLA_PUT(msg, attr2, len2, val2);
+
+	return iwpan_request(iw, msg, NULL, NULL);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+
+int iwpan_set_channel(struct iwpan *iw, uint32_t phy, uint8_t page,
+		      uint8_t channel)
+{
+	return set_phy_attrs(iw, NL802154_CMD_SET_CHANNEL, phy,
+			     NL802154_ATTR_PAGE, 1, &page,
+			     NL802154_ATTR_CHANNEL, 1, &channel);
+}
+
+int iwpan_set_tx_power(struct iwpan *iw, uint32_t phy, int32_t mbm)
+{
+	return set_phy_attrs(iw, NL802154_CMD_SET_TX_POWER, phy,
+			     NL802154_ATTR_TX_POWER, 4, &mbm, 0, 0, NULL);
+}
+
+int iwpan_set_cca_ed_level(struct iwpan *iw, uint32_t phy, int32_t mbm)
+{
+	return set_phy_attrs(iw, NL802154_CMD_SET_CCA_ED_LEVEL, phy,
+			     NL802154_ATTR_CCA_ED_LEVEL, 4, &mbm, 0, 0, NULL);
+}
+
+int iwpan_set_pan_id(struct iwpan *iw, uint32_t ifindex, uint16_t pan_id)
+{
+	uint16_t le = htole16(pan_id);
+
+	return set_iface_attrs(iw, NL802154_CMD_SET_PAN_ID, ifindex,
+			       NL802154_ATTR_PAN_ID, 2, &le, 0, 0, NULL);
+}
+
+int iwpan_set_short_addr(struct iwpan *iw, uint32_t ifindex,
+			 uint16_t short_addr)
+{
+	uint16_t le = htole16(short_addr);
+
+	return set_iface_attrs(iw, NL802154_CMD_SET_SHORT_ADDR, ifindex,
+			       NL802154_ATTR_SHORT_ADDR, 2, &le, 0, 0, NULL);
+}
+
+int iwpan_set_max_frame_retries(struct iwpan *iw, uint32_t ifindex,
+				int8_t retries)
+{
+	return set_iface_attrs(iw, NL802154_CMD_SET_MAX_FRAME_RETRIES, ifindex,
+			       NL802154_ATTR_MAX_FRAME_RETRIES, 1, &retries,
+			       0, 0, NULL);
+}
+
+int iwpan_set_backoff_exponents(struct iwpan *iw, uint32_t ifindex,
+				uint8_t min_be, uint8_t max_be)
+{
+	return set_iface_attrs(iw, NL802154_CMD_SET_BACKOFF_EXPONENT, ifindex,
+			       NL802154_ATTR_MIN_BE, 1, &min_be,
+			       NL802154_ATTR_MAX_BE, 1, &max_be);
+}
+
+int iwpan_set_max_csma_backoffs(struct iwpan *iw, uint32_t ifindex,
+				uint8_t backoffs)
+{
+	return set_iface_attrs(iw, NL802154_CMD_SET_MAX_CSMA_BACKOFFS, ifindex,
+			       NL802154_ATTR_MAX_CSMA_BACKOFFS, 1, &backoffs,
+			       0, 0, NULL);
+}
+
+int iwpan_set_lbt(struct iwpan *iw, uint32_t ifindex, bool lbt)
+{
+	uint8_t mode = lbt;
+
+	return set_iface_attrs(iw, NL802154_CMD_SET_LBT_MODE, ifindex,
+			       NL802154_ATTR_LBT_MODE, 1, &mode, 0, 0, NULL);
+}
+
+int iwpan_set_ackreq_default(struct iwpan *iw, uint32_t ifindex, bool ackreq)
+{
+	uint8_t val = ackreq;
+
+	return set_iface_attrs(iw, NL802154_CMD_SET_ACKREQ_DEFAULT, ifindex,
+			       NL802154_ATTR_ACKREQ_DEFAULT, 1, &val, 0, 0, NULL);
+}
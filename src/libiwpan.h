@@ -0,0 +1,291 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#ifndef __LIBIWPAN_H
+#define __LIBIWPAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IWPAN_EXPORT __attribute__((visibility("default")))
+
+#define IWPAN_MAX_PAGES		32
+#define IWPAN_NAME_LEN		32
+
+/*
+ * All values are in host byte order, power levels are in mBm. Optional
+ * attributes are only valid if their bit is set in the valid mask.
+ */
+
+enum iwpan_caps_valid {
+	IWPAN_CAPS_IFTYPES		= 1 << 0,
+	IWPAN_CAPS_CHANNELS		= 1 << 1,
+	IWPAN_CAPS_TX_POWERS		= 1 << 2,
+	IWPAN_CAPS_CCA_ED_LEVELS	= 1 << 3,
+	IWPAN_CAPS_CCA_MODES		= 1 << 4,
+	IWPAN_CAPS_CCA_OPTS		= 1 << 5,
+	IWPAN_CAPS_BE			= 1 << 6,
+	IWPAN_CAPS_CSMA_BACKOFFS	= 1 << 7,
+	IWPAN_CAPS_FRAME_RETRIES	= 1 << 8,
+	IWPAN_CAPS_LBT			= 1 << 9,
+};
+
+struct iwpan_caps {
+	uint32_t valid;
+	/* bitmaps indexed by nl802154_iftype, cca mode and cca option */
+	uint32_t iftypes;
+	uint32_t cca_modes;
+	uint32_t cca_opts;
+	/* supported channels per page */
+	uint32_t channels[IWPAN_MAX_PAGES];
+	/* as many as the phy reports, see iwpan_phy_free() */
+	int32_t *tx_powers;
+	int n_tx_powers;
+	int32_t *cca_ed_levels;
+	int n_cca_ed_levels;
+	uint8_t min_minbe, max_minbe;
+	uint8_t min_maxbe, max_maxbe;
+	uint8_t min_csma_backoffs, max_csma_backoffs;
+	int8_t min_frame_retries, max_frame_retries;
+	enum nl802154_supported_bool_states lbt;
+};
+
+enum iwpan_phy_valid {
+	IWPAN_PHY_NAME			= 1 << 0,
+	IWPAN_PHY_CHANNELS_SUPPORTED	= 1 << 1,
+	IWPAN_PHY_PAGE			= 1 << 2,
+	IWPAN_PHY_CHANNEL		= 1 << 3,
+	IWPAN_PHY_CCA_MODE		= 1 << 4,
+	IWPAN_PHY_CCA_OPT		= 1 << 5,
+	IWPAN_PHY_CCA_ED_LEVEL		= 1 << 6,
+	IWPAN_PHY_TX_POWER		= 1 << 7,
+	IWPAN_PHY_CAPS			= 1 << 8,
+};
+
+struct iwpan_phy {
+	uint32_t index;
+	uint32_t valid;
+	char name[IWPAN_NAME_LEN];
+	/* deprecated per page channel bitmaps, superseded by caps */
+	uint32_t channels_supported[IWPAN_MAX_PAGES];
+	uint8_t page;
+	uint8_t channel;
+	enum nl802154_cca_modes cca_mode;
+	enum nl802154_cca_opts cca_opt;
+	int32_t cca_ed_level;
+	int32_t tx_power;
+	struct iwpan_caps caps;
+};
+
+enum iwpan_iface_valid {
+	IWPAN_IFACE_PHY			= 1 << 0,
+	IWPAN_IFACE_NAME		= 1 << 1,
+	IWPAN_IFACE_IFINDEX		= 1 << 2,
+	IWPAN_IFACE_WPAN_DEV		= 1 << 3,
+	IWPAN_IFACE_EXTENDED_ADDR	= 1 << 4,
+	IWPAN_IFACE_SHORT_ADDR		= 1 << 5,
+	IWPAN_IFACE_PAN_ID		= 1 << 6,
+	IWPAN_IFACE_TYPE		= 1 << 7,
+	IWPAN_IFACE_MAX_FRAME_RETRIES	= 1 << 8,
+	IWPAN_IFACE_MIN_BE		= 1 << 9,
+	IWPAN_IFACE_MAX_BE		= 1 << 10,
+	IWPAN_IFACE_MAX_CSMA_BACKOFFS	= 1 << 11,
+	IWPAN_IFACE_LBT			= 1 << 12,
+	IWPAN_IFACE_ACKREQ_DEFAULT	= 1 << 13,
+	IWPAN_IFACE_GENERATION		= 1 << 14,
+};
+
+struct iwpan_iface {
+	uint32_t valid;
+	uint32_t phy;
+	char name[IWPAN_NAME_LEN];
+	uint32_t ifindex;
+	uint64_t wpan_dev;
+	uint64_t extended_addr;
+	uint16_t short_addr;
+	uint16_t pan_id;
+	enum nl802154_iftype type;
+	int8_t max_frame_retries;
+	uint8_t min_be;
+	uint8_t max_be;
+	uint8_t max_csma_backoffs;
+	uint8_t lbt;
+	uint8_t ackreq_default;
+	/* changes whenever an interface is added to or removed from the phy */
+	uint32_t generation;
+};
+
+struct iwpan_assoc {
+	enum nl802154_peer_type peer_type;
+	uint16_t short_addr;
+	uint64_t extended_addr;
+};
+
+enum iwpan_coord_valid {
+	IWPAN_COORD_IFINDEX		= 1 << 0,
+	IWPAN_COORD_ADDR		= 1 << 1,
+	IWPAN_COORD_CHANNEL		= 1 << 2,
+	IWPAN_COORD_PAGE		= 1 << 3,
+	IWPAN_COORD_PREAMBLE_CODE	= 1 << 4,
+	IWPAN_COORD_MEAN_PRF		= 1 << 5,
+	IWPAN_COORD_SUPERFRAME_SPEC	= 1 << 6,
+	IWPAN_COORD_LINK_QUALITY	= 1 << 7,
+	IWPAN_COORD_GTS_PERMIT		= 1 << 8,
+};
+
+struct iwpan_coord {
+	uint32_t valid;
+	uint32_t ifindex;
+	uint16_t pan_id;
+	/* 2 for short, 8 for extended addresses */
+	uint8_t addr_len;
+	uint16_t short_addr;
+	uint64_t extended_addr;
+	uint8_t channel;
+	uint8_t page;
+	uint8_t preamble_code;
+	uint8_t mean_prf;
+	uint16_t superframe_spec;
+	uint8_t link_quality;
+};
+
+struct iwpan_scan_req {
+	enum nl802154_scan_types type;
+	/* negative to leave the choice to the kernel */
+	int page;
+	int64_t channels;
+	int duration;
+};
+
+enum iwpan_field_type {
+	IWPAN_FIELD_U8,
+	IWPAN_FIELD_S8,
+	IWPAN_FIELD_U16,
+	IWPAN_FIELD_U32,
+	IWPAN_FIELD_S32,
+	IWPAN_FIELD_U64,
+	IWPAN_FIELD_STR,
+};
+
+enum iwpan_field_fmt {
+	IWPAN_FMT_DEC,
+	IWPAN_FMT_HEX,
+	/* hex, zero padded to the size of the field */
+	IWPAN_FMT_ADDR,
+	IWPAN_FMT_BOOL,
+	/* power level in mBm, shown in dBm */
+	IWPAN_FMT_MBM,
+	IWPAN_FMT_IFTYPE,
+	IWPAN_FMT_STR,
+};
+
+/*
+ * Description of a scalar struct member and the attribute it comes from.
+ * A valid bit of 0 means the attribute is mandatory.
+ */
+struct iwpan_field {
+	const char *name;
+	int attr;
+	enum iwpan_field_type type;
+	enum iwpan_field_fmt fmt;
+	bool le;
+	uint32_t valid;
+	size_t offset;
+	size_t size;
+};
+
+/* terminated by an entry without name */
+IWPAN_EXPORT extern const struct iwpan_field iwpan_phy_fields[];
+IWPAN_EXPORT extern const struct iwpan_field iwpan_iface_fields[];
+IWPAN_EXPORT extern const struct iwpan_field iwpan_coord_fields[];
+IWPAN_EXPORT extern const struct iwpan_field iwpan_assoc_fields[];
+
+/* value of a numeric field of obj, sign extended */
+IWPAN_EXPORT int64_t iwpan_field_get(const struct iwpan_field *f,
+				     const void *obj);
+
+/*
+ * Parsers for nl802154 messages and nested attributes, usable on messages
+ * received by other means. They return 0 or a negative error code. The
+ * level lists of a parsed phy are allocated, iwpan_phy_free() releases
+ * them, on failure nothing is left to free.
+ */
+IWPAN_EXPORT int iwpan_parse_phy(struct nl_msg *msg, struct iwpan_phy *phy);
+IWPAN_EXPORT void iwpan_phy_free(struct iwpan_phy *phy);
+IWPAN_EXPORT int iwpan_parse_iface(struct nl_msg *msg,
+				   struct iwpan_iface *iface);
+IWPAN_EXPORT int iwpan_parse_assoc(struct nlattr *nested,
+				   struct iwpan_assoc *assoc);
+IWPAN_EXPORT int iwpan_parse_coord(struct nlattr *nested,
+				   struct iwpan_coord *coord);
+
+struct iwpan;
+
+/*
+ * Dump callbacks are called once per object, returning non-zero stops
+ * further calls and becomes the return value of the dump. The object is
+ * only valid during the call.
+ */
+typedef int (*iwpan_phy_cb)(const struct iwpan_phy *phy, void *priv);
+typedef int (*iwpan_iface_cb)(const struct iwpan_iface *iface, void *priv);
+typedef int (*iwpan_assoc_cb)(const struct iwpan_assoc *assoc, void *priv);
+typedef int (*iwpan_coord_cb)(const struct iwpan_coord *coord, void *priv);
+
+IWPAN_EXPORT struct iwpan *iwpan_open(void);
+IWPAN_EXPORT void iwpan_close(struct iwpan *iw);
+IWPAN_EXPORT int iwpan_family(struct iwpan *iw);
+
+IWPAN_EXPORT int iwpan_dump_phys(struct iwpan *iw, iwpan_phy_cb cb,
+				 void *priv);
+IWPAN_EXPORT int iwpan_get_phy(struct iwpan *iw, uint32_t index,
+			       struct iwpan_phy *phy);
+IWPAN_EXPORT int iwpan_dump_ifaces(struct iwpan *iw, iwpan_iface_cb cb,
+				   void *priv);
+IWPAN_EXPORT int iwpan_get_iface(struct iwpan *iw, uint32_t ifindex,
+				 struct iwpan_iface *iface);
+IWPAN_EXPORT int iwpan_dump_assocs(struct iwpan *iw, uint32_t ifindex,
+				   iwpan_assoc_cb cb, void *priv);
+/* blocks until the kernel reports the scan done or aborted */
+IWPAN_EXPORT int iwpan_scan(struct iwpan *iw, uint32_t ifindex,
+			    const struct iwpan_scan_req *req,
+			    iwpan_coord_cb cb, void *priv);
+
+IWPAN_EXPORT int iwpan_set_channel(struct iwpan *iw, uint32_t phy,
+				   uint8_t page, uint8_t channel);
+IWPAN_EXPORT int iwpan_set_tx_power(struct iwpan *iw, uint32_t phy,
+				    int32_t mbm);
+IWPAN_EXPORT int iwpan_set_cca_ed_level(struct iwpan *iw, uint32_t phy,
+					int32_t mbm);
+IWPAN_EXPORT int iwpan_set_pan_id(struct iwpan *iw, uint32_t ifindex,
+				  uint16_t pan_id);
+IWPAN_EXPORT int iwpan_set_short_addr(struct iwpan *iw, uint32_t ifindex,
+				      uint16_t short_addr);
+IWPAN_EXPORT int iwpan_set_max_frame_retries(struct iwpan *iw,
+					     uint32_t ifindex, int8_t retries);
+IWPAN_EXPORT int iwpan_set_backoff_exponents(struct iwpan *iw,
+					     uint32_t ifindex,
+					     uint8_t min_be, uint8_t max_be);
+IWPAN_EXPORT int iwpan_set_max_csma_backoffs(struct iwpan *iw,
+					     uint32_t ifindex,
+					     uint8_t backoffs);
+IWPAN_EXPORT int iwpan_set_lbt(struct iwpan *iw, uint32_t ifindex,
+			       bool lbt);
+IWPAN_EXPORT int iwpan_set_ackreq_default(struct iwpan *iw, uint32_t ifindex,
+					  bool ackreq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LIBIWPAN_H */
@@ -15,6 +15,7 @@
 
 #include "nl_extras.h"
 #include "nl802154.h"
+#include "libiwpan.h"
 #include "iwpan.h"
 
 static int handle_pan_id_set(struct nl802154_state *state,
@@ -267,37 +268,29 @@ COMMAND(set, max_associations, "<max_associations>",
 	NL802154_CMD_SET_MAX_ASSOCIATIONS, 0, CIB_NETDEV,
 	handle_set_max_associations, NULL);
 
-int parse_associated_devices(struct nlattr *nestedassoc)
+static int parse_associated_devices(struct nlattr *nestedassoc)
 {
-	struct nlattr *assoc[NL802154_DEV_ADDR_ATTR_MAX + 1];
-	static struct nla_policy assoc_policy[NL802154_DEV_ADDR_ATTR_MAX + 1] = {
-		[NL802154_DEV_ADDR_ATTR_PEER_TYPE] = { .type = NLA_U8, },
-		[NL802154_DEV_ADDR_ATTR_MODE] = { .type = NLA_U8, },
-		[NL802154_DEV_ADDR_ATTR_SHORT] = { .type = NLA_U16, },
-		[NL802154_DEV_ADDR_ATTR_EXTENDED] = { .type = NLA_U64, },
-	};
-	bool short_addressing;
-	uint8_t peer_type;
+	struct iwpan_assoc assoc;
 	int ret;
 
-	ret = nla_parse_nested(assoc, NL802154_DEV_ADDR_ATTR_MAX, nestedassoc,
-			       assoc_policy);
+	ret = iwpan_parse_assoc(nestedassoc, &assoc);
+	if (ret == -EINVAL)
+		return NL_SKIP;
 	if (ret < 0) {
 		fprintf(stderr, "failed to parse nested attributes! (ret = %d)\n",
 			ret);
 		return NL_SKIP;
 	}
 
-	if (!assoc[NL802154_DEV_ADDR_ATTR_PEER_TYPE] ||
-	    !assoc[NL802154_DEV_ADDR_ATTR_SHORT] ||
-	    !assoc[NL802154_DEV_ADDR_ATTR_EXTENDED])
-		return NL_SKIP;
-
-	peer_type = nla_get_u8(assoc[NL802154_DEV_ADDR_ATTR_PEER_TYPE]);
-	printf("%s: 0x%04x / 0x%016llx\n",
-	       peer_type == NL802154_PEER_TYPE_PARENT ? "parent" : "child ",
-	       nla_get_u16(assoc[NL802154_DEV_ADDR_ATTR_SHORT]),
-	       nla_get_u64(assoc[NL802154_DEV_ADDR_ATTR_EXTENDED]));
+	render_text("%s: 0x%04x / 0x%016llx\n",
+		    assoc.peer_type == NL802154_PEER_TYPE_PARENT ? "parent" : "child ",
+		    assoc.short_addr, (unsigned long long)assoc.extended_addr);
+	render_begin(NULL);
+	render_s("peer", assoc.peer_type == NL802154_PEER_TYPE_PARENT ?
+		 "parent" : "child");
+	render_x("short_addr", assoc.short_addr, 4);
+	render_x("extended_addr", assoc.extended_addr, 16);
+	render_end();
 
 	return NL_OK;
 }
@@ -0,0 +1,411 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * Moves the phys of a set of interfaces to one channel at once: the
+ * channel changes of all phys go out pipelined, each phy once however many
+ * of the interfaces sit on it. The clock starts right before they are
+ * sent. An interface given a peer then probes it until an echo comes
+ * back, the time until then is its outage. The peers are probed in turn,
+ * one request each, so the outage is known to within a round of them.
+ * Each request waits for its echo in proportion to the data rate of the
+ * new channel unless probe_timeout is given.
+ */
+#define MIGRATE_PIPELINE_DEPTH	16
+#define MIGRATE_DEFAULT_TIMEOUT	10000
+/* the wait for one echo at 250 kbit/s, the slowest pages wait 250 ms */
+#define MIGRATE_PROBE_TIMEOUT	20
+#define MIGRATE_PROBE_BITRATE	250000
+#define MIGRATE_PROBE_LEN	8
+
+struct migrate_node {
+	const char *dev;
+	struct iwpan_iface iface;
+	struct iwpan_phy phy;
+	bool have_peer;
+	struct probe_peer peer;
+	int sd;
+	/* node setting the channel of this one's phy */
+	int owner;
+	char line[64];
+	int err;
+	uint64_t set_us;
+	uint64_t back_us;
+	bool back;
+};
+
+struct migrate_state {
+	struct migrate_node *nodes;
+	int n_nodes;
+	uint64_t start_us;
+	unsigned int probe_timeout;
+};
+
+static volatile sig_atomic_t migrate_stop;
+
+static void migrate_sigint(int sig)
+{
+	migrate_stop = 1;
+}
+
+static uint64_t migrate_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void migrate_done(const struct cmd *cmd, int err, void *priv,
+			 long node)
+{
+	struct migrate_state *ms = priv;
+
+	ms->nodes[node].err = err;
+	ms->nodes[node].set_us = migrate_now_us() - ms->start_us;
+}
+
+static int migrate_add(struct nl802154_state *state, struct migrate_state *ms,
+		       const char *dev)
+{
+	struct migrate_node *node;
+	int err;
+
+	node = realloc(ms->nodes, (ms->n_nodes + 1) * sizeof(*node));
+	if (!node)
+		return -ENOMEM;
+	ms->nodes = node;
+	node = &ms->nodes[ms->n_nodes];
+	memset(node, 0, sizeof(*node));
+	node->dev = dev;
+	node->sd = -1;
+
+	err = nl802154_get_iface(state, names_ifindex(dev), &node->iface,
+				 &node->phy);
+	if (err) {
+		fprintf(stderr, "%s: %s (%d)\n", dev, strerror(-err), err);
+		return err;
+	}
+
+	ms->n_nodes++;
+	return 0;
+}
+
+static bool migrate_supported(const struct iwpan_phy *phy, unsigned int page,
+			      unsigned int channel)
+{
+	if (phy->valid & IWPAN_PHY_CAPS)
+		return phy->caps.channels[page] & (1u << channel);
+	if (phy->valid & IWPAN_PHY_CHANNELS_SUPPORTED)
+		return phy->channels_supported[page] & (1u << channel);
+	/* let the kernel decide */
+	return true;
+}
+
+/* PHY data rate of a page/channel in bit/s, 0 if unknown */
+static unsigned int migrate_bitrate(unsigned int page, unsigned int channel)
+{
+	switch (page) {
+	case 0:
+		if (channel == 0)
+			return 20000; /* 868 MHz BPSK */
+		if (channel <= 10)
+			return 40000; /* 915 MHz BPSK */
+		return 250000; /* 2450 MHz O-QPSK */
+	case 1:
+		return 250000; /* 868/915 MHz ASK */
+	case 2:
+		if (channel == 0)
+			return 100000; /* 868 MHz O-QPSK */
+		return 250000; /* 915 MHz O-QPSK */
+	case 3:
+		return 1000000; /* 2450 MHz CSS */
+	case 4:
+		return 850000; /* UWB, nominal rate */
+	case 5:
+		return 250000; /* 780 MHz O-QPSK/MPSK */
+	case 6:
+		if (channel <= 9)
+			return 100000; /* 950 MHz GFSK */
+		return 20000; /* 950 MHz BPSK */
+	default:
+		return 0;
+	}
+}
+
+/* how long one probe waits for its echo on page/channel, in ms */
+static unsigned int migrate_probe_timeout(unsigned int page,
+					  unsigned int channel)
+{
+	unsigned int bitrate = migrate_bitrate(page, channel);
+	unsigned int timeout;
+
+	if (!bitrate)
+		bitrate = 20000;
+
+	timeout = MIGRATE_PROBE_TIMEOUT * MIGRATE_PROBE_BITRATE / bitrate;
+	return timeout < MIGRATE_PROBE_TIMEOUT ? MIGRATE_PROBE_TIMEOUT : timeout;
+}
+
+/* send the channel changes, pipelined, and wait for all of them */
+static int migrate_set(struct nl802154_state *state, struct migrate_state *ms,
+		       unsigned int page, unsigned int channel)
+{
+	char *args[BATCH_MAX_ARGS];
+	int depth = state->pipeline_depth;
+	struct migrate_node *node;
+	const struct cmd *cmd;
+	int i, n, err;
+
+	if (!depth) {
+		err = set_pipeline_depth(state, MIGRATE_PIPELINE_DEPTH);
+		if (err)
+			return err;
+	}
+
+	ms->start_us = migrate_now_us();
+	for (i = 0; i < ms->n_nodes; i++) {
+		node = &ms->nodes[i];
+		if (node->owner != i)
+			continue;
+
+		snprintf(node->line, sizeof(node->line),
+			 "phy %s set channel %u %u", node->phy.name, page,
+			 channel);
+		n = batch_split_line(node->line, args);
+		cmd = NULL;
+		err = handle_args(state, n, args, &cmd, migrate_done, ms, i);
+		if (err)
+			migrate_done(cmd, err, ms, i);
+	}
+
+	flush_cmds(state);
+	if (!depth)
+		set_pipeline_depth(state, 0);
+
+	for (i = 0; i < ms->n_nodes; i++) {
+		node = &ms->nodes[i];
+		node->err = ms->nodes[node->owner].err;
+		node->set_us = ms->nodes[node->owner].set_us;
+	}
+	return 0;
+}
+
+/* probe the peers in turn until all answered or the time is up */
+static void migrate_probe(struct migrate_state *ms, unsigned int timeout_ms)
+{
+	uint64_t deadline = ms->start_us + timeout_ms * 1000ULL;
+	struct migrate_node *node;
+	struct probe_result res;
+	bool pending = true;
+	int i;
+
+	while (pending && !migrate_stop && migrate_now_us() < deadline) {
+		pending = false;
+		for (i = 0; i < ms->n_nodes; i++) {
+			node = &ms->nodes[i];
+			if (node->sd < 0 || node->err || node->back)
+				continue;
+
+			memset(&res, 0, sizeof(res));
+			if (probe_run(node->sd, &node->peer, 1, 1,
+				      MIGRATE_PROBE_LEN, ms->probe_timeout,
+				      &res) == 0 && res.received) {
+				node->back = true;
+				node->back_us = migrate_now_us() - ms->start_us;
+			} else {
+				pending = true;
+			}
+		}
+	}
+}
+
+static int migrate_report(struct migrate_state *ms, unsigned int page,
+			  unsigned int channel)
+{
+	struct migrate_node *node;
+	int i, failed = 0;
+
+	for (i = 0; i < ms->n_nodes; i++) {
+		node = &ms->nodes[i];
+
+		render_begin(NULL);
+		render_s("dev", node->dev);
+		render_s("phy", node->phy.name);
+		render_u("page", page);
+		render_u("channel", channel);
+
+		if (node->err) {
+			failed++;
+			render_text("%s (%s): channel change failed: %s (%d)\n",
+				    node->dev, node->phy.name,
+				    node->err < 0 ? strerror(-node->err) :
+				    "invalid arguments", node->err);
+			render_d("error", node->err);
+			render_end();
+			continue;
+		}
+
+		render_text("%s (%s): on page %u channel %u after %.1f ms",
+			    node->dev, node->phy.name, page, channel,
+			    node->set_us / 1e3);
+		render_f("set_ms", node->set_us / 1e3);
+		if (node->back) {
+			render_text(", link back after %.1f ms\n",
+				    node->back_us / 1e3);
+			render_f("outage_ms", node->back_us / 1e3);
+		} else if (node->sd >= 0) {
+			failed++;
+			render_text(", no answer from the peer\n");
+			render_bool("reachable", false);
+		} else {
+			render_text("\n");
+		}
+		render_end();
+	}
+
+	return failed ? 2 : 0;
+}
+
+static int handle_migrate(struct nl802154_state *state,
+			  struct nl_cb *cb,
+			  struct nl_msg *msg,
+			  int argc, char **argv,
+			  enum id_input id)
+{
+	struct migrate_state ms = { .nodes = NULL };
+	unsigned int page, channel, timeout = MIGRATE_DEFAULT_TIMEOUT;
+	struct migrate_node *node;
+	unsigned long val;
+	char *end;
+	int i, j, err = 0;
+
+	/* skip "migrate" */
+	argc--;
+	argv++;
+
+	if (argc < 4)
+		return 1;
+
+	page = strtoul(argv[0], &end, 10);
+	if (*end != '\0' || page >= IWPAN_MAX_PAGES)
+		return 1;
+	channel = strtoul(argv[1], &end, 10);
+	if (*end != '\0' || channel > 26)
+		return 1;
+	argc -= 2;
+	argv += 2;
+
+	for (; argc >= 2; argc -= 2, argv += 2) {
+		if (strcmp(argv[0], "dev") == 0) {
+			err = migrate_add(state, &ms, argv[1]);
+			if (err)
+				goto out;
+		} else if (strcmp(argv[0], "peer") == 0 && ms.n_nodes) {
+			node = &ms.nodes[ms.n_nodes - 1];
+			if (probe_parse_addr(argv[1], &node->peer)) {
+				err = 1;
+				goto out;
+			}
+			node->have_peer = true;
+		} else if (strcmp(argv[0], "timeout") == 0) {
+			val = strtoul(argv[1], &end, 10);
+			if (!*argv[1] || *end != '\0' || !val || val > 600000) {
+				err = 1;
+				goto out;
+			}
+			timeout = val;
+		} else if (strcmp(argv[0], "probe_timeout") == 0) {
+			val = strtoul(argv[1], &end, 10);
+			if (!*argv[1] || *end != '\0' || !val || val > 60000) {
+				err = 1;
+				goto out;
+			}
+			ms.probe_timeout = val;
+		} else {
+			err = 1;
+			goto out;
+		}
+	}
+	if (argc || !ms.n_nodes) {
+		err = 1;
+		goto out;
+	}
+	if (!ms.probe_timeout)
+		ms.probe_timeout = migrate_probe_timeout(page, channel);
+
+	for (i = 0; i < ms.n_nodes; i++) {
+		node = &ms.nodes[i];
+
+		if (!migrate_supported(&node->phy, page, channel)) {
+			fprintf(stderr, "%s: %s does not support page %u channel %u\n",
+				node->dev, node->phy.name, page, channel);
+			err = -EINVAL;
+			goto out;
+		}
+
+		for (j = 0; j < i; j++) {
+			if (ms.nodes[j].phy.index == node->phy.index)
+				break;
+		}
+		node->owner = j;
+
+		/* open the sockets now, they are not part of the outage */
+		if (node->have_peer) {
+			node->sd = probe_open(&node->iface, &node->peer);
+			if (node->sd < 0) {
+				err = node->sd;
+				fprintf(stderr, "%s: cannot probe from it: %s (%d)\n",
+					node->dev, strerror(-err), err);
+				goto out;
+			}
+		}
+	}
+
+	migrate_stop = 0;
+	signal(SIGINT, migrate_sigint);
+
+	err = migrate_set(state, &ms, page, channel);
+	if (!err) {
+		migrate_probe(&ms, timeout);
+		err = migrate_report(&ms, page, channel);
+	}
+
+	signal(SIGINT, SIG_DFL);
+
+out:
+	for (i = 0; i < ms.n_nodes; i++) {
+		if (ms.nodes[i].sd >= 0)
+			close(ms.nodes[i].sd);
+		iwpan_phy_free(&ms.nodes[i].phy);
+	}
+	free(ms.nodes);
+	return err;
+}
+TOPLEVEL(migrate, "<page> <channel> dev <devname> [peer <addr>] [dev <devname> [peer <addr>] ...] [timeout <ms>] [probe_timeout <ms>]",
+	 0, 0, CIB_NONE, handle_migrate,
+	 "Move the phys of the given interfaces to a channel, all at once with\n"
+	 "pipelined requests. An interface given a peer running 'wpan-ping -d'\n"
+	 "then probes it until it answers, up to timeout ms (default 10000)\n"
+	 "after the change, and its outage is reported. Each probe waits\n"
+	 "probe_timeout ms for its echo, by default 20 ms at 250 kbit/s and\n"
+	 "longer on slower pages.");
@@ -0,0 +1,364 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/rtnetlink.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "nl_sock.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * Names and indexes of the wpan netdevs and phys, so printing events and
+ * looking up names on the command line costs no system call. names_load()
+ * reads them from one phy and one interface dump, config group messages
+ * passed to names_update() keep them current. Renaming a netdev is not
+ * announced in the config group, the sockets of names_watch() follow the
+ * rtnetlink link messages for that. Lookups which miss ask the kernel.
+ */
+struct name_entry {
+	uint32_t index;
+	char name[IWPAN_NAME_LEN];
+};
+
+struct name_table {
+	struct name_entry *entries;
+	int n;
+};
+
+static struct name_table ifaces, phys;
+static bool loaded;
+static struct nl_sock *watch_sk[NAMES_WATCH_FDS];
+
+static struct name_entry *name_by_index(struct name_table *t, uint32_t index)
+{
+	int i;
+
+	for (i = 0; i < t->n; i++) {
+		if (t->entries[i].index == index)
+			return &t->entries[i];
+	}
+	return NULL;
+}
+
+static struct name_entry *name_by_name(struct name_table *t, const char *name)
+{
+	int i;
+
+	for (i = 0; i < t->n; i++) {
+		if (strcmp(t->entries[i].name, name) == 0)
+			return &t->entries[i];
+	}
+	return NULL;
+}
+
+static void name_set(struct name_table *t, uint32_t index, const char *name)
+{
+	struct name_entry *e = name_by_index(t, index);
+
+	if (!e) {
+		e = realloc(t->entries, (t->n + 1) * sizeof(*e));
+		if (!e)
+			return;
+		t->entries = e;
+		e = &t->entries[t->n++];
+		e->index = index;
+	}
+	snprintf(e->name, sizeof(e->name), "%s", name);
+}
+
+static void name_del(struct name_table *t, uint32_t index)
+{
+	struct name_entry *e = name_by_index(t, index);
+
+	if (e)
+		*e = t->entries[--t->n];
+}
+
+static void name_clear(void *arg)
+{
+	struct name_table *t = arg;
+
+	t->n = 0;
+}
+
+static int names_phy_handler(struct nl_msg *msg, void *arg)
+{
+	struct iwpan_phy phy;
+
+	if (iwpan_parse_phy(msg, &phy))
+		return NL_SKIP;
+	if (phy.valid & IWPAN_PHY_NAME)
+		name_set(&phys, phy.index, phy.name);
+	iwpan_phy_free(&phy);
+	return NL_SKIP;
+}
+
+static int names_iface_handler(struct nl_msg *msg, void *arg)
+{
+	struct iwpan_iface iface;
+
+	if (!iwpan_parse_iface(msg, &iface) &&
+	    (iface.valid & IWPAN_IFACE_NAME) &&
+	    (iface.valid & IWPAN_IFACE_IFINDEX))
+		name_set(&ifaces, iface.ifindex, iface.name);
+	return NL_SKIP;
+}
+
+/* Read all names. Has to run on a socket not subscribed to any group. */
+int names_load(struct nl802154_state *state)
+{
+	struct dump_req phy_dump = {
+		.cmd = NL802154_CMD_GET_WPAN_PHY,
+		.valid = names_phy_handler,
+		.reset = name_clear,
+		.arg = &phys,
+	};
+	struct dump_req iface_dump = {
+		.cmd = NL802154_CMD_GET_INTERFACE,
+		.valid = names_iface_handler,
+		.reset = name_clear,
+		.arg = &ifaces,
+	};
+	int err;
+
+	loaded = false;
+	name_clear(&phys);
+	name_clear(&ifaces);
+
+	err = nl802154_dump(state, &phy_dump);
+	if (!err)
+		err = nl802154_dump(state, &iface_dump);
+	loaded = !err;
+	return err;
+}
+
+/*
+ * Forget all names, e.g. before moving to another network namespace.
+ * Returns whether they were loaded, to load them again afterwards.
+ */
+bool names_drop(void)
+{
+	bool was_loaded = loaded;
+
+	loaded = false;
+	name_clear(&phys);
+	name_clear(&ifaces);
+	return was_loaded;
+}
+
+/* apply a config group message */
+void names_update(struct nl_msg *msg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL802154_ATTR_MAX + 1];
+
+	if (!loaded)
+		return;
+
+	if (nla_parse(tb, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		      genlmsg_attrlen(gnlh, 0), NULL))
+		return;
+
+	switch (gnlh->cmd) {
+	case NL802154_CMD_NEW_WPAN_PHY:
+		if (tb[NL802154_ATTR_WPAN_PHY] && tb[NL802154_ATTR_WPAN_PHY_NAME])
+			name_set(&phys, nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]),
+				 nla_get_string(tb[NL802154_ATTR_WPAN_PHY_NAME]));
+		break;
+	case NL802154_CMD_DEL_WPAN_PHY:
+		if (tb[NL802154_ATTR_WPAN_PHY])
+			name_del(&phys, nla_get_u32(tb[NL802154_ATTR_WPAN_PHY]));
+		break;
+	case NL802154_CMD_NEW_INTERFACE:
+		if (tb[NL802154_ATTR_IFINDEX] && tb[NL802154_ATTR_IFNAME])
+			name_set(&ifaces, nla_get_u32(tb[NL802154_ATTR_IFINDEX]),
+				 nla_get_string(tb[NL802154_ATTR_IFNAME]));
+		break;
+	case NL802154_CMD_DEL_INTERFACE:
+		if (tb[NL802154_ATTR_IFINDEX])
+			name_del(&ifaces, nla_get_u32(tb[NL802154_ATTR_IFINDEX]));
+		break;
+	default:
+		break;
+	}
+}
+
+static int names_config_handler(struct nl_msg *msg, void *arg)
+{
+	names_update(msg);
+	return NL_SKIP;
+}
+
+static int names_link_handler(struct nl_msg *msg, void *arg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct ifinfomsg *ifi = nlmsg_data(nlh);
+	struct nlattr *tb[IFLA_MAX + 1];
+
+	if (!loaded || nlmsg_parse(nlh, sizeof(*ifi), tb, IFLA_MAX, NULL))
+		return NL_SKIP;
+
+	if (nlh->nlmsg_type == RTM_DELLINK)
+		name_del(&ifaces, ifi->ifi_index);
+	else if (nlh->nlmsg_type == RTM_NEWLINK &&
+		 ifi->ifi_type == ARPHRD_IEEE802154 && tb[IFLA_IFNAME])
+		name_set(&ifaces, ifi->ifi_index, nla_get_string(tb[IFLA_IFNAME]));
+
+	return NL_SKIP;
+}
+
+static struct nl_sock *names_watch_open(int protocol, int group,
+					nl_recvmsg_msg_cb_t handler)
+{
+	struct nl_sock *sk;
+
+	sk = nl_socket_alloc();
+	if (!sk)
+		return NULL;
+
+	nl_socket_disable_seq_check(sk);
+	nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM, handler, NULL);
+
+	if (nl_connect(sk, protocol) ||
+	    nl_socket_add_membership(sk, group) ||
+	    nl_socket_set_nonblocking(sk)) {
+		nl_socket_free(sk);
+		return NULL;
+	}
+	nlsock_tune(sk, NL_RCVBUF_DEFAULT);
+
+	return sk;
+}
+
+static void names_unwatch(void)
+{
+	int i;
+
+	for (i = 0; i < NAMES_WATCH_FDS; i++) {
+		nl_socket_free(watch_sk[i]);
+		watch_sk[i] = NULL;
+	}
+}
+
+/*
+ * Subscribe to the changes, then load the names, so nothing falls in
+ * between. Fills pfd with the NAMES_WATCH_FDS sockets to poll for
+ * names_watch_read().
+ */
+int names_watch(struct nl802154_state *state, struct pollfd *pfd)
+{
+	int i, group, err;
+
+	group = nl802154_resolve_grp(state, "config");
+	if (group < 0)
+		return group;
+
+	names_unwatch();
+	watch_sk[0] = names_watch_open(NETLINK_GENERIC, group,
+				       names_config_handler);
+	watch_sk[1] = names_watch_open(NETLINK_ROUTE, RTNLGRP_LINK,
+				       names_link_handler);
+	if (!watch_sk[0] || !watch_sk[1]) {
+		names_unwatch();
+		return -ENOMEM;
+	}
+
+	err = names_load(state);
+	if (err) {
+		names_unwatch();
+		return err;
+	}
+
+	for (i = 0; i < NAMES_WATCH_FDS; i++) {
+		pfd[i].fd = nl_socket_get_fd(watch_sk[i]);
+		pfd[i].events = POLLIN;
+		pfd[i].revents = 0;
+	}
+	return 0;
+}
+
+void names_watch_read(struct nl802154_state *state, const struct pollfd *pfd)
+{
+	int i, err;
+
+	for (i = 0; i < NAMES_WATCH_FDS; i++) {
+		if (!watch_sk[i] || !(pfd[i].revents & (POLLIN | POLLERR)))
+			continue;
+
+		err = nl_recvmsgs_default(watch_sk[i]);
+		/* changes were lost, start over */
+		if (err == -NLE_NOMEM)
+			names_load(state);
+	}
+}
+
+/* ifindex of the netdev name, 0 if there is none */
+unsigned int names_ifindex(const char *name)
+{
+	struct name_entry *e;
+
+	if (loaded) {
+		e = name_by_name(&ifaces, name);
+		if (e)
+			return e->index;
+	}
+	return if_nametoindex(name);
+}
+
+/* name of the netdev ifindex in buf of IF_NAMESIZE, NULL if there is none */
+char *names_ifname(unsigned int ifindex, char *buf)
+{
+	struct name_entry *e;
+
+	if (loaded) {
+		e = name_by_index(&ifaces, ifindex);
+		if (e && strlen(e->name) < IF_NAMESIZE)
+			return strcpy(buf, e->name);
+	}
+	return if_indextoname(ifindex, buf);
+}
+
+/* index of the phy name, -1 if there is none */
+int names_phy(const char *name)
+{
+	struct name_entry *e;
+	char buf[200];
+	int fd, pos;
+
+	if (loaded) {
+		e = name_by_name(&phys, name);
+		if (e)
+			return e->index;
+	}
+
+	snprintf(buf, sizeof(buf), "/sys/class/ieee802154/%s/index", name);
+
+	fd = open(buf, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	pos = read(fd, buf, sizeof(buf) - 1);
+	if (pos < 0) {
+		close(fd);
+		return -1;
+	}
+	buf[pos] = '\0';
+	close(fd);
+	return atoi(buf);
+}
@@ -0,0 +1,501 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+/* setns() and CLONE_NEWNET need _GNU_SOURCE */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+SECTION(netns);
+
+/*
+ * Places many phys in network namespaces in one run. The "set netns"
+ * requests go out pipelined on the one netlink socket, with the fd of
+ * every namespace opened once. With a config file, the process then
+ * enters each namespace in turn, reconnects there and runs the lines of
+ * the file for every phy placed in it, with "{phy}", "{ns}" and "{n}"
+ * (the number the phy name ends in) filled in.
+ */
+#define NETNS_PIPELINE_DEPTH	32
+#define NETNS_LINE_LEN		512
+
+struct netns_place {
+	char phy[IWPAN_NAME_LEN];
+	char *ns;
+	bool placed;
+};
+
+struct netns_state {
+	struct netns_place *places;
+	int n_places;
+	/* place the config lines run for */
+	int cur;
+	const char *config;
+	int placed, configured, failed;
+	/* phy and namespace patterns of "map", split at the '%' */
+	const char *phy_pat, *phy_end;
+	const char *ns_pat, *ns_end;
+	size_t phy_len, ns_len;
+};
+
+static int netns_add(struct netns_state *ns, const char *phy, const char *name,
+		     size_t len)
+{
+	struct netns_place *p;
+
+	if (strlen(phy) >= sizeof(p->phy))
+		return -ENAMETOOLONG;
+
+	p = realloc(ns->places, (ns->n_places + 1) * sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+	ns->places = p;
+	p = &ns->places[ns->n_places];
+	strcpy(p->phy, phy);
+	p->placed = false;
+	p->ns = strndup(name, len);
+	if (!p->ns)
+		return -ENOMEM;
+	ns->n_places++;
+	return 0;
+}
+
+static void netns_free(struct netns_state *ns)
+{
+	int i;
+
+	for (i = 0; i < ns->n_places; i++)
+		free(ns->places[i].ns);
+	free(ns->places);
+}
+
+static void netns_report(const struct cmd *cmd, int err, void *priv, long tag)
+{
+	struct netns_state *ns = priv;
+	const struct netns_place *p;
+
+	if (ns->cur < 0) {
+		p = &ns->places[tag];
+		if (!err) {
+			ns->places[tag].placed = true;
+			ns->placed++;
+			return;
+		}
+		fprintf(stderr, "%s: placing it in %s failed", p->phy, p->ns);
+	} else {
+		p = &ns->places[ns->cur];
+		if (!err) {
+			ns->configured++;
+			return;
+		}
+		fprintf(stderr, "%s:%ld (%s in %s): command failed", ns->config,
+			tag, p->phy, p->ns);
+	}
+
+	if (err == 1)
+		fprintf(stderr, ": invalid arguments\n");
+	else if (err < 0)
+		fprintf(stderr, ": %s (%d)\n", strerror(-err), err);
+	else
+		fprintf(stderr, " (%d)\n", err);
+	ns->failed++;
+}
+
+/* the digits the phy name ends in, "" if none */
+static const char *netns_number(const char *phy)
+{
+	const char *end = phy + strlen(phy);
+
+	while (end > phy && isdigit((unsigned char)end[-1]))
+		end--;
+	return end;
+}
+
+/* tmpl with {phy}, {ns} and {n} of p filled in */
+static int netns_expand(const char *tmpl, const struct netns_place *p,
+			char *buf, size_t size)
+{
+	const char *val;
+	size_t len = 0;
+
+	while (*tmpl) {
+		if (strncmp(tmpl, "{phy}", 5) == 0)
+			val = p->phy;
+		else if (strncmp(tmpl, "{ns}", 4) == 0)
+			val = p->ns;
+		else if (strncmp(tmpl, "{n}", 3) == 0)
+			val = netns_number(p->phy);
+		else
+			val = NULL;
+
+		if (val) {
+			if (len + strlen(val) >= size)
+				return -E2BIG;
+			strcpy(buf + len, val);
+			len += strlen(val);
+			tmpl = strchr(tmpl, '}') + 1;
+		} else {
+			if (len + 1 >= size)
+				return -E2BIG;
+			buf[len++] = *tmpl++;
+		}
+	}
+	buf[len] = '\0';
+	return 0;
+}
+
+/* failures are counted per phy, only the placed ones get configured */
+static void netns_place(struct nl802154_state *state, struct netns_state *ns)
+{
+	char line[NETNS_LINE_LEN];
+	char *args[BATCH_MAX_ARGS];
+	const struct cmd *cmd;
+	int i, n, err;
+
+	ns->cur = -1;
+	for (i = 0; i < ns->n_places; i++) {
+		snprintf(line, sizeof(line), "phy %s set netns name %s",
+			 ns->places[i].phy, ns->places[i].ns);
+		n = batch_split_line(line, args);
+		cmd = NULL;
+		err = n < 4 ? 1 : handle_args(state, n, args, &cmd, netns_report,
+					       ns, i);
+		if (err) {
+			flush_cmds(state);
+			netns_report(cmd, err, ns, i);
+		}
+	}
+	flush_cmds(state);
+}
+
+/* run the lines of f for place cur, in its namespace */
+static void netns_configure(struct nl802154_state *state,
+			    struct netns_state *ns, FILE *f)
+{
+	char line[NETNS_LINE_LEN];
+	char *args[BATCH_MAX_ARGS];
+	char *buf = NULL;
+	const struct cmd *cmd;
+	int n, err, lineno = 0;
+	size_t len = 0;
+
+	rewind(f);
+	while (getline(&buf, &len, f) >= 0) {
+		lineno++;
+
+		if (netns_expand(buf, &ns->places[ns->cur], line, sizeof(line))) {
+			netns_report(NULL, -E2BIG, ns, lineno);
+			continue;
+		}
+		n = batch_split_line(line, args);
+		if (n == 0)
+			continue;
+
+		cmd = NULL;
+		err = n < 0 ? n : handle_args(state, n, args, &cmd, netns_report,
+					      ns, lineno);
+		if (err) {
+			flush_cmds(state);
+			netns_report(cmd, err, ns, lineno);
+		}
+	}
+	flush_cmds(state);
+	free(buf);
+}
+
+/* enter the namespace at fd with a socket of its own */
+static int netns_enter(struct nl802154_state *state, int fd)
+{
+	if (setns(fd, CLONE_NEWNET))
+		return -errno;
+	return nl802154_reconnect(state);
+}
+
+static int netns_run(struct nl802154_state *state, struct netns_state *ns)
+{
+	int depth = state->pipeline_depth;
+	const char *inside = NULL;
+	bool had_names;
+	int i, fd, home = -1, err = 0;
+	FILE *f = NULL;
+
+	if (!ns->n_places) {
+		fprintf(stderr, "no phys to place\n");
+		return 2;
+	}
+
+	if (ns->config) {
+		f = fopen(ns->config, "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open %s: %s\n", ns->config,
+				strerror(errno));
+			return -errno;
+		}
+		home = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+		if (home < 0) {
+			err = -errno;
+			fclose(f);
+			return err;
+		}
+	}
+
+	netns_cache_fds(true);
+	if (!depth) {
+		err = set_pipeline_depth(state, NETNS_PIPELINE_DEPTH);
+		if (err)
+			goto out;
+	}
+
+	netns_place(state, ns);
+
+	if (f) {
+		/* the names of this namespace mean nothing in the others */
+		had_names = names_drop();
+
+		for (i = 0; i < ns->n_places; i++) {
+			if (!ns->places[i].placed)
+				continue;
+			ns->cur = i;
+
+			if (!inside || strcmp(inside, ns->places[i].ns)) {
+				fd = netns_get_fd(ns->places[i].ns);
+				err = fd < 0 ? -errno : netns_enter(state, fd);
+				if (err) {
+					fprintf(stderr, "Cannot enter %s: %s (%d)\n",
+						ns->places[i].ns, strerror(-err),
+						err);
+					break;
+				}
+				inside = ns->places[i].ns;
+			}
+			netns_configure(state, ns, f);
+		}
+
+		if (netns_enter(state, home)) {
+			fprintf(stderr, "Cannot return to the original namespace\n");
+			err = -EIO;
+		}
+		if (had_names)
+			names_load(state);
+	}
+
+	if (!depth)
+		set_pipeline_depth(state, 0);
+
+	render_begin(NULL);
+	render_text("%d of %d phys placed", ns->placed, ns->n_places);
+	render_u("placed", ns->placed);
+	render_u("phys", ns->n_places);
+	if (f) {
+		render_text(", %d config lines run", ns->configured);
+		render_u("configured", ns->configured);
+	}
+	render_text(", %d failed\n", ns->failed);
+	render_u("failed", ns->failed);
+	render_end();
+
+	if (!err && ns->failed)
+		err = 2;
+out:
+	netns_cache_fds(false);
+	if (f) {
+		close(home);
+		fclose(f);
+	}
+	return err;
+}
+
+/* [config <file>] */
+static int netns_parse_config(struct netns_state *ns, int argc, char **argv)
+{
+	if (argc == 0)
+		return 0;
+	if (argc != 2 || strcmp(argv[0], "config"))
+		return 1;
+	ns->config = argv[1];
+	return 0;
+}
+
+static int handle_netns_place(struct nl802154_state *state,
+			      struct nl_cb *cb,
+			      struct nl_msg *msg,
+			      int argc, char **argv,
+			      enum id_input id)
+{
+	struct netns_state ns = { .places = NULL };
+	char *args[BATCH_MAX_ARGS];
+	char *line = NULL;
+	int n, err = 0, lineno = 0;
+	const char *name;
+	size_t len = 0;
+	FILE *f;
+
+	/* skip "netns place" */
+	argc -= 2;
+	argv += 2;
+
+	if (argc < 1 || netns_parse_config(&ns, argc - 1, argv + 1))
+		return 1;
+
+	if (strcmp(argv[0], "-") == 0) {
+		f = stdin;
+		name = "<stdin>";
+	} else {
+		f = fopen(argv[0], "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open %s: %s\n", argv[0],
+				strerror(errno));
+			return -errno;
+		}
+		name = argv[0];
+	}
+
+	while (getline(&line, &len, f) >= 0) {
+		lineno++;
+
+		n = batch_split_line(line, args);
+		if (n == 0)
+			continue;
+		if (n != 2) {
+			fprintf(stderr, "%s:%d: not a '<phy> <netns>' line\n",
+				name, lineno);
+			err = 1;
+			break;
+		}
+		err = netns_add(&ns, args[0], args[1], strlen(args[1]));
+		if (err)
+			break;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+
+	if (!err)
+		err = netns_run(state, &ns);
+	netns_free(&ns);
+	return err;
+}
+COMMAND(netns, place, "<file>|- [config <file>]", 0, 0, CIB_NONE,
+	handle_netns_place,
+	"Put the phys of a file of '<phy> <netns>' lines ('-' for stdin) in\n"
+	"those network namespaces, all in one pipelined run. With config, the\n"
+	"lines of that file are run inside the namespace of every phy, with\n"
+	"{phy}, {ns} and {n}, the number the phy name ends in, filled in.");
+
+/* a phy name of the map pattern, its number as the namespace one's */
+static int netns_map_handler(struct nl_msg *msg, void *arg)
+{
+	struct netns_state *ns = arg;
+	char name[NETNS_LINE_LEN];
+	struct iwpan_phy phy;
+	const char *num;
+	size_t len;
+
+	if (iwpan_parse_phy(msg, &phy))
+		return NL_SKIP;
+	/* only the name is of use */
+	iwpan_phy_free(&phy);
+	if (!(phy.valid & IWPAN_PHY_NAME))
+		return NL_SKIP;
+
+	len = strlen(phy.name);
+	if (len <= ns->phy_len + strlen(ns->phy_end) ||
+	    strncmp(phy.name, ns->phy_pat, ns->phy_len) ||
+	    strcmp(phy.name + len - strlen(ns->phy_end), ns->phy_end))
+		return NL_SKIP;
+
+	num = phy.name + ns->phy_len;
+	len -= ns->phy_len + strlen(ns->phy_end);
+	if (strspn(num, "0123456789") < len)
+		return NL_SKIP;
+
+	if (!ns->ns_end)
+		snprintf(name, sizeof(name), "%s", ns->ns_pat);
+	else
+		snprintf(name, sizeof(name), "%.*s%.*s%s", (int)ns->ns_len,
+			 ns->ns_pat, (int)len, num, ns->ns_end);
+
+	if (netns_add(ns, phy.name, name, strlen(name)))
+		return NL_STOP;
+	return NL_SKIP;
+}
+
+static void netns_map_reset(void *arg)
+{
+	struct netns_state *ns = arg;
+
+	netns_free(ns);
+	ns->places = NULL;
+	ns->n_places = 0;
+}
+
+static int handle_netns_map(struct nl802154_state *state,
+			    struct nl_cb *cb,
+			    struct nl_msg *msg,
+			    int argc, char **argv,
+			    enum id_input id)
+{
+	struct netns_state ns = { .places = NULL };
+	struct dump_req phy_dump = {
+		.cmd = NL802154_CMD_GET_WPAN_PHY,
+		.valid = netns_map_handler,
+		.reset = netns_map_reset,
+		.arg = &ns,
+	};
+	int err;
+
+	/* skip "netns map" */
+	argc -= 2;
+	argv += 2;
+
+	if (argc < 2 || netns_parse_config(&ns, argc - 2, argv + 2))
+		return 1;
+
+	ns.phy_pat = argv[0];
+	ns.phy_end = strchr(argv[0], '%');
+	if (!ns.phy_end || strchr(ns.phy_end + 1, '%'))
+		return 1;
+	ns.phy_len = ns.phy_end++ - ns.phy_pat;
+
+	/* without a '%' all phys go to the one namespace */
+	ns.ns_pat = argv[1];
+	ns.ns_end = strchr(argv[1], '%');
+	if (ns.ns_end) {
+		if (strchr(ns.ns_end + 1, '%'))
+			return 1;
+		ns.ns_len = ns.ns_end++ - ns.ns_pat;
+	}
+
+	err = nl802154_dump(state, &phy_dump);
+	if (!err)
+		err = netns_run(state, &ns);
+	netns_free(&ns);
+	return err;
+}
+COMMAND(netns, map, "<phy-pattern> <netns-pattern> [config <file>]", 0, 0,
+	CIB_NONE, handle_netns_map,
+	"Put every phy matching phy-pattern in a network namespace, with the\n"
+	"number the '%' of phy-pattern matches in place of the '%' of\n"
+	"netns-pattern, e.g. 'netns map phy% node%' puts phy7 in node7.\n"
+	"config is as for 'netns place'.");
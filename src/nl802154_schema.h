@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#ifndef __NL802154_SCHEMA_H
+#define __NL802154_SCHEMA_H
+
+/*
+ * Scalar attributes of the objects in libiwpan.h, one line each:
+ *
+ *	X(attribute, type, struct member, valid bit, little endian, format, name)
+ *
+ * The lists generate the netlink policies, the field tables used to parse
+ * them into the structs and the descriptions exported as iwpan_*_fields.
+ * Nested attributes and those with a variable layout are handled by hand.
+ */
+
+#define IWPAN_PHY_SCHEMA(X)							\
+	X(NL802154_ATTR_WPAN_PHY_NAME, STR, name, IWPAN_PHY_NAME, 0, STR, "name") \
+	X(NL802154_ATTR_PAGE, U8, page, IWPAN_PHY_PAGE, 0, DEC, "page")	\
+	X(NL802154_ATTR_CHANNEL, U8, channel, IWPAN_PHY_CHANNEL, 0, DEC, "channel") \
+	X(NL802154_ATTR_CCA_MODE, U32, cca_mode, IWPAN_PHY_CCA_MODE, 0, DEC, "cca_mode") \
+	X(NL802154_ATTR_CCA_OPT, U32, cca_opt, IWPAN_PHY_CCA_OPT, 0, DEC, "cca_opt") \
+	X(NL802154_ATTR_CCA_ED_LEVEL, S32, cca_ed_level, IWPAN_PHY_CCA_ED_LEVEL, 0, MBM, "cca_ed_level") \
+	X(NL802154_ATTR_TX_POWER, S32, tx_power, IWPAN_PHY_TX_POWER, 0, MBM, "tx_power")
+
+#define IWPAN_IFACE_SCHEMA(X)							\
+	X(NL802154_ATTR_WPAN_PHY, U32, phy, IWPAN_IFACE_PHY, 0, DEC, "wpan_phy") \
+	X(NL802154_ATTR_IFNAME, STR, name, IWPAN_IFACE_NAME, 0, STR, "name") \
+	X(NL802154_ATTR_IFINDEX, U32, ifindex, IWPAN_IFACE_IFINDEX, 0, DEC, "ifindex") \
+	X(NL802154_ATTR_WPAN_DEV, U64, wpan_dev, IWPAN_IFACE_WPAN_DEV, 0, HEX, "wpan_dev") \
+	X(NL802154_ATTR_EXTENDED_ADDR, U64, extended_addr, IWPAN_IFACE_EXTENDED_ADDR, 1, ADDR, "extended_addr") \
+	X(NL802154_ATTR_SHORT_ADDR, U16, short_addr, IWPAN_IFACE_SHORT_ADDR, 1, ADDR, "short_addr") \
+	X(NL802154_ATTR_PAN_ID, U16, pan_id, IWPAN_IFACE_PAN_ID, 1, ADDR, "pan_id") \
+	X(NL802154_ATTR_IFTYPE, U32, type, IWPAN_IFACE_TYPE, 0, IFTYPE, "type") \
+	X(NL802154_ATTR_MAX_FRAME_RETRIES, S8, max_frame_retries, IWPAN_IFACE_MAX_FRAME_RETRIES, 0, DEC, "max_frame_retries") \
+	X(NL802154_ATTR_MIN_BE, U8, min_be, IWPAN_IFACE_MIN_BE, 0, DEC, "min_be") \
+	X(NL802154_ATTR_MAX_BE, U8, max_be, IWPAN_IFACE_MAX_BE, 0, DEC, "max_be") \
+	X(NL802154_ATTR_MAX_CSMA_BACKOFFS, U8, max_csma_backoffs, IWPAN_IFACE_MAX_CSMA_BACKOFFS, 0, DEC, "max_csma_backoffs") \
+	X(NL802154_ATTR_LBT_MODE, U8, lbt, IWPAN_IFACE_LBT, 0, BOOL, "lbt") \
+	X(NL802154_ATTR_ACKREQ_DEFAULT, U8, ackreq_default, IWPAN_IFACE_ACKREQ_DEFAULT, 0, BOOL, "ackreq_default") \
+	X(NL802154_ATTR_GENERATION, U32, generation, IWPAN_IFACE_GENERATION, 0, DEC, "generation")
+
+/* the pan id is mandatory, it has no valid bit */
+#define IWPAN_COORD_SCHEMA(X)							\
+	X(NL802154_COORD_PANID, U16, pan_id, 0, 1, ADDR, "pan_id")		\
+	X(NL802154_COORD_CHANNEL, U8, channel, IWPAN_COORD_CHANNEL, 0, DEC, "channel") \
+	X(NL802154_COORD_PAGE, U8, page, IWPAN_COORD_PAGE, 0, DEC, "page")	\
+	X(NL802154_COORD_PREAMBLE_CODE, U8, preamble_code, IWPAN_COORD_PREAMBLE_CODE, 0, DEC, "preamble_code") \
+	X(NL802154_COORD_MEAN_PRF, U8, mean_prf, IWPAN_COORD_MEAN_PRF, 0, DEC, "mean_prf") \
+	X(NL802154_COORD_SUPERFRAME_SPEC, U16, superframe_spec, IWPAN_COORD_SUPERFRAME_SPEC, 0, HEX, "superframe_spec") \
+	X(NL802154_COORD_LINK_QUALITY, U8, link_quality, IWPAN_COORD_LINK_QUALITY, 0, DEC, "lqi")
+
+/* all of them are mandatory */
+#define IWPAN_ASSOC_SCHEMA(X)							\
+	X(NL802154_DEV_ADDR_ATTR_PEER_TYPE, U8, peer_type, 0, 0, DEC, "peer_type") \
+	X(NL802154_DEV_ADDR_ATTR_SHORT, U16, short_addr, 0, 1, ADDR, "short_addr") \
+	X(NL802154_DEV_ADDR_ATTR_EXTENDED, U64, extended_addr, 0, 1, ADDR, "extended_addr")
+
+/* valid bits of the caps cover min/max pairs, they are set by hand */
+#define IWPAN_CAPS_SCHEMA(X)							\
+	X(NL802154_CAP_ATTR_MIN_MINBE, U8, min_minbe, 0, 0, DEC, "min_minbe")	\
+	X(NL802154_CAP_ATTR_MAX_MINBE, U8, max_minbe, 0, 0, DEC, "max_minbe")	\
+	X(NL802154_CAP_ATTR_MIN_MAXBE, U8, min_maxbe, 0, 0, DEC, "min_maxbe")	\
+	X(NL802154_CAP_ATTR_MAX_MAXBE, U8, max_maxbe, 0, 0, DEC, "max_maxbe")	\
+	X(NL802154_CAP_ATTR_MIN_CSMA_BACKOFFS, U8, min_csma_backoffs, 0, 0, DEC, "min_csma_backoffs") \
+	X(NL802154_CAP_ATTR_MAX_CSMA_BACKOFFS, U8, max_csma_backoffs, 0, 0, DEC, "max_csma_backoffs") \
+	X(NL802154_CAP_ATTR_MIN_FRAME_RETRIES, S8, min_frame_retries, 0, 0, DEC, "min_frame_retries") \
+	X(NL802154_CAP_ATTR_MAX_FRAME_RETRIES, S8, max_frame_retries, 0, 0, DEC, "max_frame_retries") \
+	X(NL802154_CAP_ATTR_LBT, U32, lbt, 0, 0, DEC, "lbt")
+
+/*
+ * libnl can't validate signed types, see validate_nla(), they are checked
+ * by size like their unsigned counterparts.
+ */
+#define IWPAN_NLA_U8	NLA_U8
+#define IWPAN_NLA_S8	NLA_U8
+#define IWPAN_NLA_U16	NLA_U16
+#define IWPAN_NLA_U32	NLA_U32
+#define IWPAN_NLA_S32	NLA_U32
+#define IWPAN_NLA_U64	NLA_U64
+#define IWPAN_NLA_STR	NLA_NUL_STRING
+
+#define IWPAN_SCHEMA_POLICY(_attr, _type, _member, _valid, _le, _fmt, _name) \
+	[_attr] = { .type = IWPAN_NLA_ ## _type },
+
+#define IWPAN_SCHEMA_FIELD(_struct, _attr, _type, _member, _valid, _le, _fmt, _name) \
+	{								\
+		.name = (_name),					\
+		.attr = (_attr),					\
+		.type = IWPAN_FIELD_ ## _type,				\
+		.fmt = IWPAN_FMT_ ## _fmt,				\
+		.le = (_le),						\
+		.valid = (_valid),					\
+		.offset = offsetof(struct _struct, _member),		\
+		.size = sizeof(((struct _struct *)0)->_member),		\
+	},
+
+#endif /* __NL802154_SCHEMA_H */
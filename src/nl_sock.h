@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#ifndef __NL_SOCK_H
+#define __NL_SOCK_H
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include <netlink/netlink.h>
+#include <netlink/socket.h>
+#include <netlink/attr.h>
+
+/* Socket setup shared by iwpan, libiwpan, wpan-ping and wpan-hwsim */
+
+#ifndef SOL_NETLINK
+#define SOL_NETLINK		270
+#endif
+#ifndef NETLINK_CAP_ACK
+#define NETLINK_CAP_ACK		10
+#endif
+#ifndef NETLINK_EXT_ACK
+#define NETLINK_EXT_ACK		11
+#endif
+#ifndef NLM_F_ACK_TLVS
+#define NLM_F_CAPPED		0x100
+#define NLM_F_ACK_TLVS		0x200
+#define NLMSGERR_ATTR_MSG	1
+#define NLMSGERR_ATTR_MAX	NLMSGERR_ATTR_MSG
+#endif
+
+/* what libnl sets up by default */
+#define NL_RCVBUF_DEFAULT	32768
+/* growing a buffer which overran stops here */
+#define NL_RCVBUF_MAX		(8 * 1024 * 1024)
+
+/*
+ * Set the receive buffer and ask the kernel for error acks which carry its
+ * error message but not the whole request. Needs a connected socket, libnl
+ * ignores buffer sizes set before. Kernels without extended acks ignore
+ * them, so do we.
+ */
+static inline int nlsock_tune(struct nl_sock *sk, int rcvbuf)
+{
+	int fd = nl_socket_get_fd(sk);
+	int one = 1;
+
+	if (fd < 0)
+		return -EBADF;
+
+	setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+	setsockopt(fd, SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof(one));
+
+	return nl_socket_set_buffer_size(sk, rcvbuf, 8192) ? -EINVAL : 0;
+}
+
+/* The kernel's message of an extended error ack, NULL if there is none */
+static inline const char *nlsock_ext_ack_msg(const struct nlmsgerr *err)
+{
+	const struct nlmsghdr *nlh;
+	struct nlattr *tb[NLMSGERR_ATTR_MAX + 1];
+	size_t offset = sizeof(*err);
+	const char *msg;
+
+	nlh = (const struct nlmsghdr *)((const char *)err - NLMSG_HDRLEN);
+	if (!(nlh->nlmsg_flags & NLM_F_ACK_TLVS))
+		return NULL;
+
+	/* without NLM_F_CAPPED the request follows the error */
+	if (!(nlh->nlmsg_flags & NLM_F_CAPPED))
+		offset += NLMSG_ALIGN(err->msg.nlmsg_len) - sizeof(err->msg);
+	if (NLMSG_HDRLEN + offset >= nlh->nlmsg_len)
+		return NULL;
+
+	if (nla_parse(tb, NLMSGERR_ATTR_MAX,
+		      (struct nlattr *)((char *)err + offset),
+		      nlh->nlmsg_len - NLMSG_HDRLEN - offset, NULL))
+		return NULL;
+	if (!tb[NLMSGERR_ATTR_MSG] || !nla_len(tb[NLMSGERR_ATTR_MSG]))
+		return NULL;
+
+	msg = nla_data(tb[NLMSGERR_ATTR_MSG]);
+	if (msg[nla_len(tb[NLMSGERR_ATTR_MSG]) - 1] != '\0')
+		return NULL;
+	return msg;
+}
+
+#endif /* __NL_SOCK_H */
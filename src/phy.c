@@ -4,7 +4,9 @@
 
 #include <net/if.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <stdbool.h>
 #include <sys/param.h>
 #include <sys/types.h>
@@ -156,10 +158,50 @@ COMMAND(set, cca_ed_level, "<level>",
 #ifndef NETNS_RUN_DIR
 #define NETNS_RUN_DIR "/var/run/netns"
 #endif
-static int netns_get_fd(const char *name)
+
+/*
+ * While netns_cache_fds() is on, the fd of each namespace is opened once
+ * and handed out again for the same name, so placing many phys does not
+ * open a namespace file per phy. Turning it off closes them.
+ */
+struct netns_fd {
+	char *name;
+	int fd;
+};
+
+static struct netns_fd *netns_fds;
+static int n_netns_fds;
+static bool netns_caching;
+
+void netns_cache_fds(bool on)
+{
+	int i;
+
+	if (!on) {
+		for (i = 0; i < n_netns_fds; i++) {
+			close(netns_fds[i].fd);
+			free(netns_fds[i].name);
+		}
+		free(netns_fds);
+		netns_fds = NULL;
+		n_netns_fds = 0;
+	}
+	netns_caching = on;
+}
+
+int netns_get_fd(const char *name)
 {
 	char pathbuf[MAXPATHLEN];
 	const char *path, *ptr;
+	struct netns_fd *nf;
+	int i, fd;
+
+	if (netns_caching) {
+		for (i = 0; i < n_netns_fds; i++) {
+			if (strcmp(netns_fds[i].name, name) == 0)
+				return netns_fds[i].fd;
+		}
+	}
 
 	path = name;
 	ptr = strchr(name, '/');
@@ -168,7 +210,21 @@ static int netns_get_fd(const char *name)
 			NETNS_RUN_DIR, name );
 		path = pathbuf;
 	}
-	return open(path, O_RDONLY);
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || !netns_caching)
+		return fd;
+
+	nf = realloc(netns_fds, (n_netns_fds + 1) * sizeof(*nf));
+	if (!nf)
+		return fd;
+	netns_fds = nf;
+	nf = &netns_fds[n_netns_fds];
+	nf->name = strdup(name);
+	if (!nf->name)
+		return fd;
+	nf->fd = fd;
+	n_netns_fds++;
+	return fd;
 }
 
 static int handle_netns(struct nl802154_state *state,
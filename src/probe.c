@@ -0,0 +1,338 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <net/if.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <netlink/genl/genl.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * Probes are echo requests in the format of wpan-ping, answered by a peer
+ * running "wpan-ping -d". Up to window requests are in flight at once: a
+ * window of 1 measures the round trip, larger ones what the link carries.
+ */
+#define PROBE_HDR_LEN		4
+#define PROBE_NOT_6LOWPAN	0x00
+#define PROBE_FILL		0xab
+
+enum {
+	PROBE_ADDR_SHORT = 0x2,
+	PROBE_ADDR_LONG = 0x3,
+};
+
+struct probe_addr_sa {
+	int addr_type;
+	uint16_t pan_id;
+	union {
+		uint8_t hwaddr[8];
+		uint16_t short_addr;
+	};
+};
+
+struct sockaddr_ieee802154 {
+	sa_family_t family;
+	struct probe_addr_sa addr;
+};
+
+struct probe_slot {
+	bool busy;
+	uint16_t seq;
+	uint64_t sent_us;
+};
+
+/* kept across runs, so late echoes of an earlier run don't count */
+static uint16_t probe_seq;
+
+static uint64_t probe_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void probe_sockaddr(struct sockaddr_ieee802154 *sa, uint16_t pan_id,
+			   bool extended, uint16_t short_addr,
+			   uint64_t extended_addr)
+{
+	int i;
+
+	memset(sa, 0, sizeof(*sa));
+	sa->family = AF_IEEE802154;
+	sa->addr.pan_id = pan_id;
+	if (extended) {
+		sa->addr.addr_type = PROBE_ADDR_LONG;
+		/* big endian, as printed */
+		for (i = 0; i < 8; i++)
+			sa->addr.hwaddr[i] = extended_addr >> (56 - 8 * i);
+	} else {
+		sa->addr.addr_type = PROBE_ADDR_SHORT;
+		sa->addr.short_addr = short_addr;
+	}
+}
+
+/* "0x0001" is a short address, "00:11:22:33:44:55:66:77" an extended one */
+int probe_parse_addr(const char *arg, struct probe_peer *peer)
+{
+	unsigned int b[8];
+	unsigned long val;
+	char *end;
+	int i;
+
+	memset(peer, 0, sizeof(*peer));
+
+	if (sscanf(arg, "%x:%x:%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3],
+		   &b[4], &b[5], &b[6], &b[7]) == 8) {
+		peer->extended = true;
+		for (i = 0; i < 8; i++) {
+			if (b[i] > 0xff)
+				return -EINVAL;
+			peer->extended_addr = peer->extended_addr << 8 | b[i];
+		}
+		return 0;
+	}
+
+	val = strtoul(arg, &end, 16);
+	if (!*arg || *end != '\0' || val >= 0xfffe)
+		return -EINVAL;
+	peer->short_addr = val;
+	return 0;
+}
+
+/*
+ * A socket sending from iface, by its short address if it has one. Sets
+ * the PAN of peer to the one of iface.
+ */
+int probe_open(const struct iwpan_iface *iface, struct probe_peer *peer)
+{
+	struct sockaddr_ieee802154 src;
+	bool extended;
+	int sd;
+
+	if (!(iface->valid & IWPAN_IFACE_PAN_ID))
+		return -EADDRNOTAVAIL;
+	peer->pan_id = iface->pan_id;
+
+	extended = !(iface->valid & IWPAN_IFACE_SHORT_ADDR) ||
+		   iface->short_addr >= 0xfffe;
+	if (extended && !(iface->valid & IWPAN_IFACE_EXTENDED_ADDR))
+		return -EADDRNOTAVAIL;
+
+	probe_sockaddr(&src, iface->pan_id, extended, iface->short_addr,
+		       iface->extended_addr);
+
+	sd = socket(AF_IEEE802154, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sd < 0)
+		return -errno;
+	if (bind(sd, (struct sockaddr *)&src, sizeof(src))) {
+		close(sd);
+		return -errno;
+	}
+	return sd;
+}
+
+/*
+ * Bring the netdev up or down, most MAC settings are only taken while it
+ * is down. Returns whether it was up before.
+ */
+int probe_link(int sd, const char *dev, bool up)
+{
+	struct ifreq ifr;
+	bool was_up;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", dev);
+
+	if (ioctl(sd, SIOCGIFFLAGS, &ifr))
+		return -errno;
+	was_up = ifr.ifr_flags & IFF_UP;
+	if (was_up == up)
+		return was_up;
+
+	if (up)
+		ifr.ifr_flags |= IFF_UP;
+	else
+		ifr.ifr_flags &= ~IFF_UP;
+	if (ioctl(sd, SIOCSIFFLAGS, &ifr))
+		return -errno;
+	return was_up;
+}
+
+static void probe_receive(int sd, struct probe_slot *slots, unsigned int window,
+			  unsigned int *outstanding, struct probe_result *res)
+{
+	uint8_t buf[PROBE_MAX_LEN];
+	unsigned int i;
+	ssize_t len;
+	uint64_t rtt;
+	uint16_t seq;
+
+	while ((len = recv(sd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		if (len < PROBE_HDR_LEN || buf[0] != PROBE_NOT_6LOWPAN)
+			continue;
+		seq = buf[2] << 8 | buf[3];
+
+		for (i = 0; i < window; i++) {
+			if (slots[i].busy && slots[i].seq == seq)
+				break;
+		}
+		if (i == window)
+			continue;
+
+		rtt = probe_now_us() - slots[i].sent_us;
+		slots[i].busy = false;
+		(*outstanding)--;
+		if (res->rtts && res->received < res->max_rtts)
+			res->rtts[res->received] = rtt;
+		res->received++;
+		res->bytes += len;
+		res->rtt_us += rtt;
+	}
+}
+
+/*
+ * Send count requests of len bytes to peer, at most window of them
+ * unanswered, and wait up to timeout_ms for each answer. Adds to res, so
+ * runs can be continued.
+ */
+int probe_run(int sd, const struct probe_peer *peer, unsigned int count,
+	      unsigned int window, unsigned int len, unsigned int timeout_ms,
+	      struct probe_result *res)
+{
+	struct probe_slot slots[PROBE_MAX_WINDOW] = { { 0 } };
+	struct sockaddr_ieee802154 dst;
+	uint8_t buf[PROBE_MAX_LEN];
+	unsigned int i, sent = 0, outstanding = 0;
+	uint64_t start, now, oldest;
+	struct pollfd pfd;
+	int ms;
+
+	if (!window || window > PROBE_MAX_WINDOW ||
+	    len < PROBE_HDR_LEN || len > PROBE_MAX_LEN)
+		return -EINVAL;
+
+	probe_sockaddr(&dst, peer->pan_id, peer->extended, peer->short_addr,
+		       peer->extended_addr);
+
+	buf[0] = PROBE_NOT_6LOWPAN;
+	buf[1] = len;
+	memset(buf + PROBE_HDR_LEN, PROBE_FILL, len - PROBE_HDR_LEN);
+
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	start = probe_now_us();
+
+	while (sent < count || outstanding) {
+		for (i = 0; i < window && sent < count; i++) {
+			if (slots[i].busy)
+				continue;
+
+			buf[2] = probe_seq >> 8;
+			buf[3] = probe_seq & 0xff;
+			if (sendto(sd, buf, len, 0, (struct sockaddr *)&dst,
+				   sizeof(dst)) < 0) {
+				if (errno == EINTR)
+					continue;
+				return -errno;
+			}
+
+			slots[i].busy = true;
+			slots[i].seq = probe_seq++;
+			slots[i].sent_us = probe_now_us();
+			outstanding++;
+			sent++;
+			res->sent++;
+		}
+
+		/* wait for the oldest request in flight, then give it up */
+		now = probe_now_us();
+		oldest = now;
+		for (i = 0; i < window; i++) {
+			if (slots[i].busy && slots[i].sent_us < oldest)
+				oldest = slots[i].sent_us;
+		}
+		ms = oldest + timeout_ms * 1000ULL > now ?
+		     (oldest + timeout_ms * 1000ULL - now + 999) / 1000 : 0;
+
+		if (poll(&pfd, 1, ms) < 0 && errno != EINTR)
+			return -errno;
+		probe_receive(sd, slots, window, &outstanding, res);
+
+		now = probe_now_us();
+		for (i = 0; i < window; i++) {
+			if (slots[i].busy &&
+			    now - slots[i].sent_us >= timeout_ms * 1000ULL) {
+				slots[i].busy = false;
+				outstanding--;
+			}
+		}
+	}
+
+	res->elapsed_us += probe_now_us() - start;
+	return 0;
+}
+
+/* bytes per second which came back */
+double probe_throughput(const struct probe_result *res)
+{
+	return res->elapsed_us ? res->bytes * 1e6 / res->elapsed_us : 0;
+}
+
+/* mean round trip in ms, 0 if nothing came back */
+double probe_latency(const struct probe_result *res)
+{
+	return res->received ? res->rtt_us / 1e3 / res->received : 0;
+}
+
+/* share of requests without an answer */
+double probe_loss(const struct probe_result *res)
+{
+	return res->sent ? 1 - (double)res->received / res->sent : 1;
+}
+
+static int probe_cmp_rtt(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * The round trip in ms which pct percent of the requests sent stayed
+ * within. Requests without an answer count as infinitely late, so this is
+ * HUGE_VAL if more than 100 - pct percent were lost. Needs res->rtts.
+ */
+double probe_percentile(struct probe_result *res, unsigned int pct)
+{
+	unsigned int n, rank;
+
+	if (!res->rtts || !res->sent)
+		return HUGE_VAL;
+
+	rank = ((uint64_t)res->sent * pct + 99) / 100;
+	if (!rank)
+		return 0;
+	if (rank > res->received)
+		return HUGE_VAL;
+
+	n = res->received < res->max_rtts ? res->received : res->max_rtts;
+	if (rank > n)
+		return HUGE_VAL;
+
+	qsort(res->rtts, n, sizeof(*res->rtts), probe_cmp_rtt);
+	return res->rtts[rank - 1] / 1e3;
+}
@@ -0,0 +1,531 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+SECTION(profile);
+
+/*
+ * A profile is a set of MAC and PHY settings tuned together, one per line
+ * as "set" takes them, e.g. "max_frame_retries 1". tx_power and
+ * cca_ed_level also take "min" and "max" of what the phy supports. Files
+ * in IWPAN_PROFILE_DIR come first, then the built-in profiles. Every
+ * setting is checked against the capabilities of the phy before anything
+ * is sent, then the ones which change something go out as one pipeline.
+ */
+#define PROFILE_PIPELINE_DEPTH	16
+#define PROFILE_MAX_LINES	64
+
+static const struct {
+	const char *name;
+	const char *settings;
+} builtin_profiles[] = {
+	/* the defaults of IEEE 802.15.4 */
+	{ "default",
+	  "backoff_exponents 3 5\n"
+	  "max_csma_backoffs 4\n"
+	  "max_frame_retries 3\n"
+	  "lbt 0\n"
+	  "ackreq_default 0\n" },
+	/* fail fast instead of queueing behind backoffs and retries */
+	{ "low_latency",
+	  "backoff_exponents 1 3\n"
+	  "max_csma_backoffs 2\n"
+	  "max_frame_retries 1\n"
+	  "lbt 0\n"
+	  "ackreq_default 0\n"
+	  "tx_power max\n" },
+	/* acknowledged frames at full power, fewer collisions than default */
+	{ "throughput",
+	  "backoff_exponents 2 5\n"
+	  "max_csma_backoffs 4\n"
+	  "max_frame_retries 3\n"
+	  "lbt 0\n"
+	  "ackreq_default 1\n"
+	  "tx_power max\n" },
+	/* least energy per frame, a retry costs more than a longer backoff */
+	{ "low_power",
+	  "backoff_exponents 3 5\n"
+	  "max_csma_backoffs 4\n"
+	  "max_frame_retries 1\n"
+	  "lbt 0\n"
+	  "ackreq_default 1\n"
+	  "tx_power min\n" },
+	{ NULL },
+};
+
+struct profile_state {
+	const char *name;
+	uint32_t ifindex;
+	struct iwpan_iface iface;
+	struct iwpan_phy phy;
+	int changed, unchanged, failed;
+};
+
+/* a setting which changes something, as "dev|phy <name> set ..." */
+struct profile_cmd {
+	/* the line args points into */
+	char *line;
+	char level[16];
+	char *args[BATCH_MAX_ARGS + 3];
+	int n;
+	int lineno;
+};
+
+/* a file of that name, or the built-in profile */
+static FILE *profile_open(const char *name)
+{
+	char path[256];
+	FILE *f;
+	int i;
+
+	if (strchr(name, '/'))
+		return fopen(name, "r");
+
+	snprintf(path, sizeof(path), "%s/%s", IWPAN_PROFILE_DIR, name);
+	f = fopen(path, "r");
+	if (f || errno != ENOENT)
+		return f;
+
+	for (i = 0; builtin_profiles[i].name; i++) {
+		if (strcmp(builtin_profiles[i].name, name) == 0)
+			return fmemopen((void *)builtin_profiles[i].settings,
+					strlen(builtin_profiles[i].settings),
+					"r");
+	}
+
+	errno = ENOENT;
+	return NULL;
+}
+
+static int profile_level(const int32_t *levels, int n, bool max, int32_t *mbm)
+{
+	int i;
+
+	if (!n)
+		return -ENODATA;
+
+	*mbm = levels[0];
+	for (i = 1; i < n; i++) {
+		if (max ? levels[i] > *mbm : levels[i] < *mbm)
+			*mbm = levels[i];
+	}
+	return 0;
+}
+
+/*
+ * "min" and "max" of tx_power and cca_ed_level to a level of the phy, put
+ * on phy as the mBm the phy reported. Returns 1 if phy changed, 0 if not,
+ * -ENOENT if argv is no such setting and -ENODATA without levels.
+ */
+static int profile_resolve(struct profile_state *ps, char **argv,
+			   struct iwpan_phy *phy, char *buf, size_t size)
+{
+	const struct iwpan_caps *caps = &ps->phy.caps;
+	enum iwpan_phy_valid bit;
+	int32_t mbm, *level;
+	bool max, changed;
+	int err;
+
+	if (strcmp(argv[1], "min") && strcmp(argv[1], "max"))
+		return -ENOENT;
+	max = strcmp(argv[1], "max") == 0;
+
+	if (strcmp(argv[0], "tx_power") == 0) {
+		if (!(ps->phy.valid & IWPAN_PHY_CAPS))
+			return -ENODATA;
+		err = profile_level(caps->tx_powers, caps->n_tx_powers, max, &mbm);
+		level = &phy->tx_power;
+		bit = IWPAN_PHY_TX_POWER;
+	} else if (strcmp(argv[0], "cca_ed_level") == 0) {
+		if (!(ps->phy.valid & IWPAN_PHY_CAPS))
+			return -ENODATA;
+		err = profile_level(caps->cca_ed_levels, caps->n_cca_ed_levels,
+				    max, &mbm);
+		level = &phy->cca_ed_level;
+		bit = IWPAN_PHY_CCA_ED_LEVEL;
+	} else {
+		return -ENOENT;
+	}
+	if (err)
+		return err;
+
+	changed = !(phy->valid & bit) || *level != mbm;
+	*level = mbm;
+	phy->valid |= bit;
+
+	/* for the line sent, it parses back to mbm */
+	snprintf(buf, size, "%.2f", MBM_TO_DBM(mbm));
+	argv[1] = buf;
+	return changed;
+}
+
+static bool profile_has_level(const int32_t *levels, int n, int32_t mbm)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (levels[i] == mbm)
+			return true;
+	}
+	return false;
+}
+
+/* Check what setting made of phy and iface against the phy's capabilities */
+static int profile_check(const char *name, int lineno, const char *setting,
+			 const struct iwpan_phy *phy,
+			 const struct iwpan_iface *iface)
+{
+	const struct iwpan_caps *caps = &phy->caps;
+
+	/* without caps the kernel has the last word */
+	if (!(phy->valid & IWPAN_PHY_CAPS))
+		return 0;
+
+	if (strcmp(setting, "backoff_exponents") == 0 &&
+	    (caps->valid & IWPAN_CAPS_BE)) {
+		if (iface->min_be < caps->min_minbe ||
+		    iface->min_be > caps->max_minbe ||
+		    iface->max_be < caps->min_maxbe ||
+		    iface->max_be > caps->max_maxbe ||
+		    iface->min_be > iface->max_be) {
+			fprintf(stderr, "%s:%d: backoff_exponents %u %u, %s takes %u..%u and %u..%u\n",
+				name, lineno, iface->min_be, iface->max_be,
+				phy->name, caps->min_minbe, caps->max_minbe,
+				caps->min_maxbe, caps->max_maxbe);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "max_csma_backoffs") == 0 &&
+		   (caps->valid & IWPAN_CAPS_CSMA_BACKOFFS)) {
+		if (iface->max_csma_backoffs < caps->min_csma_backoffs ||
+		    iface->max_csma_backoffs > caps->max_csma_backoffs) {
+			fprintf(stderr, "%s:%d: max_csma_backoffs %u, %s takes %u..%u\n",
+				name, lineno, iface->max_csma_backoffs,
+				phy->name, caps->min_csma_backoffs,
+				caps->max_csma_backoffs);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "max_frame_retries") == 0 &&
+		   (caps->valid & IWPAN_CAPS_FRAME_RETRIES)) {
+		if (iface->max_frame_retries < caps->min_frame_retries ||
+		    iface->max_frame_retries > caps->max_frame_retries) {
+			fprintf(stderr, "%s:%d: max_frame_retries %d, %s takes %d..%d\n",
+				name, lineno, iface->max_frame_retries,
+				phy->name, caps->min_frame_retries,
+				caps->max_frame_retries);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "lbt") == 0 &&
+		   (caps->valid & IWPAN_CAPS_LBT)) {
+		if (caps->lbt != NL802154_SUPPORTED_BOOL_BOTH &&
+		    !!iface->lbt != (caps->lbt == NL802154_SUPPORTED_BOOL_TRUE)) {
+			fprintf(stderr, "%s:%d: lbt %u, %s only takes %d\n",
+				name, lineno, iface->lbt, phy->name,
+				caps->lbt == NL802154_SUPPORTED_BOOL_TRUE);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "tx_power") == 0 &&
+		   (caps->valid & IWPAN_CAPS_TX_POWERS)) {
+		if (!profile_has_level(caps->tx_powers, caps->n_tx_powers,
+				       phy->tx_power)) {
+			fprintf(stderr, "%s:%d: tx_power %.3g dBm not supported by %s\n",
+				name, lineno, MBM_TO_DBM(phy->tx_power),
+				phy->name);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "cca_ed_level") == 0 &&
+		   (caps->valid & IWPAN_CAPS_CCA_ED_LEVELS)) {
+		if (!profile_has_level(caps->cca_ed_levels,
+				       caps->n_cca_ed_levels,
+				       phy->cca_ed_level)) {
+			fprintf(stderr, "%s:%d: cca_ed_level %.3g dBm not supported by %s\n",
+				name, lineno, MBM_TO_DBM(phy->cca_ed_level),
+				phy->name);
+			return -ERANGE;
+		}
+	} else if (strcmp(setting, "cca_mode") == 0 &&
+		   (caps->valid & IWPAN_CAPS_CCA_MODES)) {
+		if (phy->cca_mode >= 32 ||
+		    !(caps->cca_modes & (1u << phy->cca_mode)) ||
+		    (phy->cca_mode == NL802154_CCA_ENERGY_CARRIER &&
+		     (caps->valid & IWPAN_CAPS_CCA_OPTS) &&
+		     (phy->cca_opt >= 32 ||
+		      !(caps->cca_opts & (1u << phy->cca_opt))))) {
+			fprintf(stderr, "%s:%d: cca_mode not supported by %s\n",
+				name, lineno, phy->name);
+			return -ERANGE;
+		}
+	}
+
+	return 0;
+}
+
+static void profile_report(const struct cmd *cmd, int err, void *priv,
+			   long lineno)
+{
+	struct profile_state *ps = priv;
+
+	if (!err) {
+		ps->changed++;
+		return;
+	}
+
+	if (err == 1)
+		fprintf(stderr, "%s:%ld: invalid arguments\n", ps->name, lineno);
+	else if (err < 0)
+		fprintf(stderr, "%s:%ld: command failed: %s (%d)\n",
+			ps->name, lineno, strerror(-err), err);
+	else
+		fprintf(stderr, "%s:%ld: command failed (%d)\n",
+			ps->name, lineno, err);
+
+	ps->failed++;
+}
+
+/*
+ * Turn the profile into the commands which change something. Returns the
+ * number of those, negative if the profile can't be applied to ps.
+ */
+static int profile_prepare(struct profile_state *ps, FILE *f, const char *dev,
+			   struct profile_cmd *cmds)
+{
+	struct iwpan_iface iface = ps->iface;
+	struct iwpan_phy phy = ps->phy;
+	char *args[BATCH_MAX_ARGS];
+	struct profile_cmd *cmd;
+	char *line = NULL;
+	char level[16];
+	int n, ret, lineno = 0, n_cmds = 0, failed = 0;
+	size_t len = 0;
+	bool is_phy;
+	int i;
+
+	while (getline(&line, &len, f) >= 0) {
+		lineno++;
+
+		n = batch_split_line(line, args);
+		if (n == 0)
+			continue;
+		/* "set lbt 1" as well as "lbt 1" */
+		if (strcmp(args[0], "set") == 0) {
+			n--;
+			memmove(args, args + 1, n * sizeof(*args));
+		}
+
+		ret = n < 2 ? -EINVAL : profile_resolve(ps, args, &phy, level,
+							sizeof(level));
+		if (ret == -ENODATA) {
+			fprintf(stderr, "%s:%d: %s doesn't report its %s levels\n",
+				ps->name, lineno, ps->phy.name, args[0]);
+			failed++;
+			continue;
+		}
+		if (ret == -ENOENT)
+			ret = apply_setting(n, args, &phy, &iface, &is_phy);
+		else if (ret >= 0)
+			is_phy = true;
+		if (ret == -ENOENT) {
+			fprintf(stderr, "%s:%d: unknown setting %s\n",
+				ps->name, lineno, args[0]);
+			failed++;
+			continue;
+		} else if (ret < 0) {
+			fprintf(stderr, "%s:%d: invalid arguments\n",
+				ps->name, lineno);
+			failed++;
+			continue;
+		}
+
+		/* checked on the copies, before anything is sent */
+		if (profile_check(ps->name, lineno, args[0], &phy, &iface)) {
+			failed++;
+			continue;
+		}
+
+		if (!ret) {
+			ps->unchanged++;
+			continue;
+		}
+
+		if (n_cmds == PROFILE_MAX_LINES) {
+			fprintf(stderr, "%s: more than %d settings\n", ps->name,
+				PROFILE_MAX_LINES);
+			failed++;
+			break;
+		}
+
+		/* keep the parsed line, getline() starts a new one */
+		cmd = &cmds[n_cmds++];
+		cmd->line = line;
+		line = NULL;
+		len = 0;
+		cmd->args[0] = is_phy ? "phy" : "dev";
+		cmd->args[1] = is_phy ? ps->phy.name : (char *)dev;
+		cmd->args[2] = "set";
+		for (i = 0; i < n; i++) {
+			if (args[i] == level) {
+				strcpy(cmd->level, level);
+				cmd->args[i + 3] = cmd->level;
+			} else {
+				cmd->args[i + 3] = args[i];
+			}
+		}
+		cmd->n = n + 3;
+		cmd->lineno = lineno;
+	}
+
+	free(line);
+	ps->failed += failed;
+	if (failed) {
+		for (i = 0; i < n_cmds; i++)
+			free(cmds[i].line);
+		return -EINVAL;
+	}
+	return n_cmds;
+}
+
+static int handle_profile_apply(struct nl802154_state *state,
+				struct nl_cb *cb,
+				struct nl_msg *msg,
+				int argc, char **argv,
+				enum id_input id)
+{
+	struct profile_state ps = { .name = NULL };
+	struct profile_cmd *cmds;
+	int depth = state->pipeline_depth;
+	const struct cmd *cmd;
+	int i, n_cmds = 0, err;
+	FILE *f;
+
+	/* <dev> profile apply <name> */
+	if (argc != 4)
+		return 1;
+	ps.name = argv[3];
+
+	ps.ifindex = names_ifindex(argv[0]);
+	if (!ps.ifindex)
+		return -ENODEV;
+
+	f = profile_open(ps.name);
+	if (!f) {
+		fprintf(stderr, "Cannot open profile %s: %s\n", ps.name,
+			strerror(errno));
+		return -errno;
+	}
+
+	cmds = calloc(PROFILE_MAX_LINES, sizeof(*cmds));
+	if (!cmds) {
+		fclose(f);
+		return -ENOMEM;
+	}
+
+	err = nl802154_get_iface(state, ps.ifindex, &ps.iface, &ps.phy);
+	if (!err) {
+		n_cmds = profile_prepare(&ps, f, argv[0], cmds);
+		if (n_cmds < 0) {
+			fprintf(stderr, "%s: not applied to %s\n", ps.name,
+				argv[0]);
+			err = 2;
+		}
+	}
+	fclose(f);
+	if (err)
+		goto out;
+
+	if (!depth) {
+		err = set_pipeline_depth(state, PROFILE_PIPELINE_DEPTH);
+		if (err)
+			goto out;
+	}
+
+	for (i = 0; i < n_cmds; i++) {
+		cmd = NULL;
+		err = handle_args(state, cmds[i].n, cmds[i].args, &cmd,
+				  profile_report, &ps, cmds[i].lineno);
+		if (err) {
+			/* keep the reports in line order */
+			flush_cmds(state);
+			profile_report(cmd, err, &ps, cmds[i].lineno);
+		}
+	}
+
+	flush_cmds(state);
+	if (!depth)
+		set_pipeline_depth(state, 0);
+
+	render_begin(NULL);
+	render_text("%s: %d changed, %d unchanged, %d failed\n", ps.name,
+		    ps.changed, ps.unchanged, ps.failed);
+	render_s("profile", ps.name);
+	render_s("dev", argv[0]);
+	render_u("changed", ps.changed);
+	render_u("unchanged", ps.unchanged);
+	render_u("failed", ps.failed);
+	render_end();
+
+	err = ps.failed ? 2 : 0;
+out:
+	for (i = 0; i < n_cmds; i++)
+		free(cmds[i].line);
+	free(cmds);
+	iwpan_phy_free(&ps.phy);
+	return err;
+}
+COMMAND(profile, apply, "<name>", 0, 0, CIB_NETDEV, handle_profile_apply,
+	"Bring the MAC and PHY settings of this interface and its phy to a\n"
+	"profile: default, low_latency, throughput, low_power, or a file\n"
+	"of settings as 'set' takes them in " IWPAN_PROFILE_DIR ".\n"
+	"tx_power and cca_ed_level there also take min and max.\n"
+	"Nothing is sent unless the phy supports all settings.");
+
+static int handle_profile_list(struct nl802154_state *state,
+			       struct nl_cb *cb,
+			       struct nl_msg *msg,
+			       int argc, char **argv,
+			       enum id_input id)
+{
+	struct dirent *de;
+	DIR *dir;
+	int i;
+
+	dir = opendir(IWPAN_PROFILE_DIR);
+	while (dir && (de = readdir(dir))) {
+		if (de->d_name[0] == '.')
+			continue;
+		render_begin(NULL);
+		render_text("%s (%s/%s)\n", de->d_name, IWPAN_PROFILE_DIR,
+			    de->d_name);
+		render_s("name", de->d_name);
+		render_s("source", IWPAN_PROFILE_DIR);
+		render_end();
+	}
+	if (dir)
+		closedir(dir);
+
+	for (i = 0; builtin_profiles[i].name; i++) {
+		render_begin(NULL);
+		render_text("%s (built-in)\n", builtin_profiles[i].name);
+		render_s("name", builtin_profiles[i].name);
+		render_s("source", "built-in");
+		render_end();
+	}
+
+	return 0;
+}
+COMMAND(profile, list, NULL, 0, 0, CIB_NONE, handle_profile_list,
+	"List the profiles 'profile apply' takes.");
@@ -0,0 +1,507 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netlink/genl/genl.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * Output of the info and dump commands is collected here and written with
+ * a single write() once the command is done. Text mode takes preformatted
+ * lines, JSON and table mode take typed fields: every command produces a
+ * JSON array of objects, in table mode each of those objects is a row and
+ * its scalar fields are the columns.
+ */
+#define RENDER_MAX_DEPTH	16
+
+struct render_cell {
+	const char *key;
+	char *val;
+};
+
+struct render_row {
+	struct render_cell *cells;
+	int n_cells;
+};
+
+static struct {
+	enum render_format fmt;
+	char *buf;
+	size_t len, size;
+	bool failed;
+	int depth;
+	/* json: nothing emitted at this depth yet, i.e. no comma needed */
+	bool first[RENDER_MAX_DEPTH + 1];
+	/* table */
+	struct render_row *rows;
+	int n_rows, rows_size;
+} r;
+
+int render_set_format(const char *name)
+{
+	if (strcmp(name, "text") == 0)
+		r.fmt = RENDER_TEXT;
+	else if (strcmp(name, "json") == 0)
+		r.fmt = RENDER_JSON;
+	else if (strcmp(name, "table") == 0)
+		r.fmt = RENDER_TABLE;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+const char *render_format_name(void)
+{
+	switch (r.fmt) {
+	case RENDER_JSON:
+		return "json";
+	case RENDER_TABLE:
+		return "table";
+	default:
+		return "text";
+	}
+}
+
+enum render_format render_format(void)
+{
+	return r.fmt;
+}
+
+static bool buf_reserve(size_t len)
+{
+	size_t size;
+	char *buf;
+
+	if (r.failed)
+		return false;
+	if (r.len + len + 1 <= r.size)
+		return true;
+
+	size = r.size ? r.size : 4096;
+	while (size < r.len + len + 1)
+		size *= 2;
+
+	buf = realloc(r.buf, size);
+	if (!buf) {
+		r.failed = true;
+		return false;
+	}
+
+	r.buf = buf;
+	r.size = size;
+	return true;
+}
+
+static void buf_vprintf(const char *fmt, va_list ap)
+{
+	va_list aq;
+	int len;
+
+	va_copy(aq, ap);
+	len = vsnprintf(NULL, 0, fmt, aq);
+	va_end(aq);
+	if (len < 0 || !buf_reserve(len))
+		return;
+
+	vsnprintf(r.buf + r.len, r.size - r.len, fmt, ap);
+	r.len += len;
+}
+
+static void __attribute__((format(printf, 1, 2))) buf_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	buf_vprintf(fmt, ap);
+	va_end(ap);
+}
+
+static void buf_json_string(const char *s)
+{
+	buf_printf("\"");
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			buf_printf("\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			buf_printf("\\u%04x", *s);
+		else
+			buf_printf("%c", *s);
+	}
+	buf_printf("\"");
+}
+
+void render_text(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (r.fmt != RENDER_TEXT)
+		return;
+
+	va_start(ap, fmt);
+	buf_vprintf(fmt, ap);
+	va_end(ap);
+}
+
+/* json: separator and key of the next value */
+static void json_prefix(const char *key)
+{
+	if (r.depth == 0 && r.first[0])
+		buf_printf("[");
+
+	if (!r.first[r.depth])
+		buf_printf(",");
+	r.first[r.depth] = false;
+
+	if (key && r.depth > 0) {
+		buf_json_string(key);
+		buf_printf(":");
+	}
+}
+
+static void table_cell(const char *key, const char *val)
+{
+	struct render_row *row;
+	struct render_cell *cells;
+
+	/* only scalars right inside a row make it into the table */
+	if (r.depth != 1 || !key || !r.n_rows)
+		return;
+
+	row = &r.rows[r.n_rows - 1];
+	cells = realloc(row->cells, (row->n_cells + 1) * sizeof(*cells));
+	if (!cells) {
+		r.failed = true;
+		return;
+	}
+	row->cells = cells;
+	cells[row->n_cells].key = key;
+	cells[row->n_cells].val = strdup(val);
+	if (!cells[row->n_cells].val) {
+		r.failed = true;
+		return;
+	}
+	row->n_cells++;
+}
+
+static void container_begin(const char *key, char open)
+{
+	if (r.fmt == RENDER_JSON) {
+		json_prefix(key);
+		buf_printf("%c", open);
+	} else if (r.fmt == RENDER_TABLE && r.depth == 0) {
+		struct render_row *rows = r.rows;
+
+		if (r.n_rows == r.rows_size) {
+			r.rows_size = r.rows_size ? 2 * r.rows_size : 16;
+			rows = realloc(r.rows, r.rows_size * sizeof(*rows));
+			if (!rows) {
+				r.failed = true;
+				return;
+			}
+			r.rows = rows;
+		}
+		memset(&r.rows[r.n_rows++], 0, sizeof(*r.rows));
+	}
+
+	if (r.depth < RENDER_MAX_DEPTH)
+		r.first[++r.depth] = true;
+}
+
+static void container_end(char close)
+{
+	if (r.depth > 0)
+		r.depth--;
+	if (r.fmt == RENDER_JSON)
+		buf_printf("%c", close);
+}
+
+void render_begin(const char *key)
+{
+	if (r.fmt != RENDER_TEXT)
+		container_begin(key, '{');
+}
+
+void render_end(void)
+{
+	if (r.fmt != RENDER_TEXT)
+		container_end('}');
+}
+
+void render_list_begin(const char *key)
+{
+	if (r.fmt != RENDER_TEXT)
+		container_begin(key, '[');
+}
+
+void render_list_end(void)
+{
+	if (r.fmt != RENDER_TEXT)
+		container_end(']');
+}
+
+static void render_scalar(const char *key, bool quote, const char *fmt, ...)
+{
+	char val[64];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(val, sizeof(val), fmt, ap);
+	va_end(ap);
+
+	if (r.fmt == RENDER_JSON) {
+		json_prefix(key);
+		if (quote)
+			buf_json_string(val);
+		else
+			buf_printf("%s", val);
+	} else if (r.fmt == RENDER_TABLE) {
+		table_cell(key, val);
+	}
+}
+
+void render_u(const char *key, unsigned long long val)
+{
+	if (r.fmt != RENDER_TEXT)
+		render_scalar(key, false, "%llu", val);
+}
+
+void render_d(const char *key, long long val)
+{
+	if (r.fmt != RENDER_TEXT)
+		render_scalar(key, false, "%lld", val);
+}
+
+void render_x(const char *key, unsigned long long val, int width)
+{
+	if (r.fmt != RENDER_TEXT)
+		render_scalar(key, true, "0x%0*llx", width, val);
+}
+
+void render_f(const char *key, double val)
+{
+	if (r.fmt != RENDER_TEXT)
+		render_scalar(key, false, "%g", val);
+}
+
+void render_bool(const char *key, bool val)
+{
+	if (r.fmt != RENDER_TEXT)
+		render_scalar(key, false, "%s", val ? "true" : "false");
+}
+
+void render_s(const char *key, const char *val)
+{
+	if (r.fmt == RENDER_JSON) {
+		json_prefix(key);
+		buf_json_string(val);
+	} else if (r.fmt == RENDER_TABLE) {
+		table_cell(key, val);
+	}
+}
+
+/* A field of a libiwpan struct, as an indented "name value" line in text mode */
+void render_field(const char *indent, const struct iwpan_field *f,
+		  const void *obj)
+{
+	long long val = iwpan_field_get(f, obj);
+
+	switch (f->fmt) {
+	case IWPAN_FMT_DEC:
+		render_text("%s\t%s %lld\n", indent, f->name, val);
+		render_d(f->name, val);
+		break;
+	case IWPAN_FMT_HEX:
+		render_text("%s\t%s 0x%llx\n", indent, f->name, val);
+		render_x(f->name, val, 0);
+		break;
+	case IWPAN_FMT_ADDR:
+		render_text("%s\t%s 0x%0*llx\n", indent, f->name,
+			    (int)f->size * 2, val);
+		render_x(f->name, val, f->size * 2);
+		break;
+	case IWPAN_FMT_BOOL:
+		render_text("%s\t%s %lld\n", indent, f->name, val);
+		render_bool(f->name, val);
+		break;
+	case IWPAN_FMT_MBM:
+		render_text("%s\t%s %.3g\n", indent, f->name, MBM_TO_DBM(val));
+		render_f(f->name, MBM_TO_DBM(val));
+		break;
+	case IWPAN_FMT_IFTYPE:
+		render_text("%s\t%s %s\n", indent, f->name, iftype_name(val));
+		render_s(f->name, iftype_name(val));
+		break;
+	case IWPAN_FMT_STR:
+		render_text("%s\t%s %s\n", indent, f->name,
+			    (const char *)obj + f->offset);
+		render_s(f->name, (const char *)obj + f->offset);
+		break;
+	}
+}
+
+struct table_col {
+	const char *key;
+	int width;
+};
+
+static void table_output(void)
+{
+	struct table_col *cols = NULL, *c;
+	int n_cols = 0, i, j, k, len;
+	const char *val;
+
+	for (i = 0; i < r.n_rows; i++) {
+		for (j = 0; j < r.rows[i].n_cells; j++) {
+			for (k = 0; k < n_cols; k++) {
+				if (strcmp(cols[k].key, r.rows[i].cells[j].key) == 0)
+					break;
+			}
+			if (k == n_cols) {
+				c = realloc(cols, (n_cols + 1) * sizeof(*cols));
+				if (!c) {
+					r.failed = true;
+					goto out;
+				}
+				cols = c;
+				cols[n_cols].key = r.rows[i].cells[j].key;
+				cols[n_cols++].width = strlen(r.rows[i].cells[j].key);
+			}
+			len = strlen(r.rows[i].cells[j].val);
+			if (len > cols[k].width)
+				cols[k].width = len;
+		}
+	}
+
+	for (k = 0; k < n_cols; k++)
+		buf_printf("%-*s%s", k + 1 < n_cols ? cols[k].width : 0,
+			   cols[k].key, k + 1 < n_cols ? "  " : "\n");
+
+	for (i = 0; i < r.n_rows; i++) {
+		for (k = 0; k < n_cols; k++) {
+			val = "-";
+			for (j = 0; j < r.rows[i].n_cells; j++) {
+				if (strcmp(cols[k].key, r.rows[i].cells[j].key) == 0)
+					val = r.rows[i].cells[j].val;
+			}
+			buf_printf("%-*s%s", k + 1 < n_cols ? cols[k].width : 0,
+				   val, k + 1 < n_cols ? "  " : "\n");
+		}
+	}
+out:
+	free(cols);
+}
+
+static void table_free(void)
+{
+	int i, j;
+
+	for (i = 0; i < r.n_rows; i++) {
+		for (j = 0; j < r.rows[i].n_cells; j++)
+			free(r.rows[i].cells[j].val);
+		free(r.rows[i].cells);
+	}
+	free(r.rows);
+	r.rows = NULL;
+	r.n_rows = 0;
+	r.rows_size = 0;
+}
+
+static void buf_write(void)
+{
+	uint64_t t = timing_now();
+	size_t done = 0;
+	ssize_t ret;
+
+	/* anything still printed the old way goes first */
+	fflush(stdout);
+
+	while (done < r.len) {
+		ret = write(STDOUT_FILENO, r.buf + done, r.len - done);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		done += ret;
+	}
+	r.len = 0;
+	timing_add(TIMING_OUTPUT, t);
+}
+
+/* Write out what is complete, text only, structured output needs render_done() */
+void render_flush(void)
+{
+	if (r.fmt == RENDER_TEXT)
+		buf_write();
+}
+
+static struct {
+	size_t len;
+	int depth;
+	bool first[RENDER_MAX_DEPTH + 1];
+	int n_rows;
+} saved;
+
+void render_save(void)
+{
+	saved.len = r.len;
+	saved.depth = r.depth;
+	memcpy(saved.first, r.first, sizeof(saved.first));
+	saved.n_rows = r.n_rows;
+}
+
+void render_restore(void)
+{
+	int i, j;
+
+	/* text already flushed can't be taken back */
+	if (r.len >= saved.len)
+		r.len = saved.len;
+	r.depth = saved.depth;
+	memcpy(r.first, saved.first, sizeof(r.first));
+
+	for (i = saved.n_rows; i < r.n_rows; i++) {
+		for (j = 0; j < r.rows[i].n_cells; j++)
+			free(r.rows[i].cells[j].val);
+		free(r.rows[i].cells);
+	}
+	if (r.n_rows > saved.n_rows)
+		r.n_rows = saved.n_rows;
+}
+
+/* Finish the output of a command and write it */
+void render_done(void)
+{
+	/* an array even if there was nothing in it */
+	if (r.fmt == RENDER_JSON)
+		buf_printf(r.first[0] ? "[]\n" : "]\n");
+	else if (r.fmt == RENDER_TABLE)
+		table_output();
+
+	if (r.failed)
+		fprintf(stderr, "out of memory, output truncated\n");
+	else
+		buf_write();
+
+	table_free();
+	r.len = 0;
+	r.depth = 0;
+	r.first[0] = true;
+	r.failed = false;
+}
+
+void render_init(void)
+{
+	r.first[0] = true;
+}
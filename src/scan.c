@@ -18,6 +18,7 @@
 
 #include "nl802154.h"
 #include "nl_extras.h"
+#include "libiwpan.h"
 #include "iwpan.h"
 
 static char scantypebuf[100];
@@ -253,121 +254,96 @@ static void flush_coords(void)
 	} while (item);
 }
 
-static struct ieee802154_addr *parse_new_coordinator(struct nlattr *nestedcoord)
+static struct ieee802154_addr *new_coordinator_addr(const struct iwpan_coord *coord)
 {
-	struct nlattr *pan[NL802154_COORD_MAX + 1];
-	static struct nla_policy pan_policy[NL802154_COORD_MAX + 1] = {
-		[NL802154_COORD_PANID] = { .type = NLA_U16, },
-		[NL802154_COORD_ADDR] = { .minlen = 2, .maxlen = 8, }, /* 2 or 8 */
-		[NL802154_COORD_CHANNEL] = { .type = NLA_U8, },
-		[NL802154_COORD_PAGE] = { .type = NLA_U8, },
-		[NL802154_COORD_PREAMBLE_CODE] = { .type = NLA_U8, },
-		[NL802154_COORD_MEAN_PRF] = { .type = NLA_U8, },
-		[NL802154_COORD_SUPERFRAME_SPEC] = { .type = NLA_U16, },
-		[NL802154_COORD_LINK_QUALITY] = { .type = NLA_U8, },
-		[NL802154_COORD_GTS_PERMIT] = { .type = NLA_FLAG, },
-	};
 	struct ieee802154_addr *addr;
-	struct nlattr *coord;
-	char dev[20];
-	int ret;
 
-	ret = nla_parse_nested(pan, NL802154_COORD_MAX, nestedcoord, pan_policy);
-	if (ret < 0) {
-		fprintf(stderr, "failed to parse nested attributes! (ret = %d)\n",
-			ret);
-		return NULL;
-	}
-	if (!pan[NL802154_COORD_PANID] || !pan[NL802154_COORD_ADDR])
+	if (!(coord->valid & IWPAN_COORD_ADDR))
 		return NULL;
 
 	addr = malloc(sizeof(*addr));
 	if (!addr)
 		return NULL;
 
-	addr->pan_id = nla_get_u16(pan[NL802154_COORD_PANID]);
-	coord = pan[NL802154_COORD_ADDR];
-	addr->addr_len = nla_len(coord);
+	addr->pan_id = coord->pan_id;
+	addr->addr_len = coord->addr_len;
 	if (addr->addr_len == 2)
-		addr->short_addr = nla_get_u16(coord);
+		addr->short_addr = coord->short_addr;
 	else
-		addr->extended_addr = nla_get_u64(coord);
+		addr->extended_addr = coord->extended_addr;
+	addr->next = NULL;
 
 	return addr;
 }
 
-static int print_new_coordinator(struct nlattr *nestedcoord,
-				 struct nlattr *ifattr)
+static void print_new_coordinator(const struct iwpan_coord *coord,
+				  struct nlattr *ifattr)
 {
-	struct nlattr *pan[NL802154_COORD_MAX + 1];
-	static struct nla_policy pan_policy[NL802154_COORD_MAX + 1] = {
-		[NL802154_COORD_PANID] = { .type = NLA_U16, },
-		[NL802154_COORD_ADDR] = { .minlen = 2, .maxlen = 8, }, /* 2 or 8 */
-		[NL802154_COORD_CHANNEL] = { .type = NLA_U8, },
-		[NL802154_COORD_PAGE] = { .type = NLA_U8, },
-		[NL802154_COORD_PREAMBLE_CODE] = { .type = NLA_U8, },
-		[NL802154_COORD_MEAN_PRF] = { .type = NLA_U8, },
-		[NL802154_COORD_SUPERFRAME_SPEC] = { .type = NLA_U16, },
-		[NL802154_COORD_LINK_QUALITY] = { .type = NLA_U8, },
-		[NL802154_COORD_GTS_PERMIT] = { .type = NLA_FLAG, },
-	};
-	char dev[20];
-	int ret;
-
-	ret = nla_parse_nested(pan, NL802154_COORD_MAX, nestedcoord, pan_policy);
-	if (ret < 0) {
-		fprintf(stderr, "failed to parse nested attributes! (ret = %d)\n",
-			ret);
-		return NL_SKIP;
+	char dev[IF_NAMESIZE];
+
+	render_begin(NULL);
+	render_text("PAN 0x%04x", coord->pan_id);
+	render_x("pan_id", coord->pan_id, 4);
+	if (ifattr && names_ifname(nla_get_u32(ifattr), dev)) {
+		render_text(" (on %s)", dev);
+		render_s("dev", dev);
 	}
-	if (!pan[NL802154_COORD_PANID])
-		return NL_SKIP;
-
-	printf("PAN 0x%04x", le16toh(nla_get_u16(pan[NL802154_COORD_PANID])));
-	if (ifattr) {
-		if_indextoname(nla_get_u32(ifattr), dev);
-		printf(" (on %s)", dev);
-	}
-	printf("\n");
-	if (pan[NL802154_COORD_ADDR]) {
-		struct nlattr *coord = pan[NL802154_COORD_ADDR];
-		if (nla_len(coord) == 2) {
-			uint16_t addr = nla_get_u16(coord);
-			printf("\tcoordinator 0x%04x\n", le16toh(addr));
+	render_text("\n");
+	if (coord->valid & IWPAN_COORD_ADDR) {
+		if (coord->addr_len == 2) {
+			render_text("\tcoordinator 0x%04x\n", coord->short_addr);
+			render_x("coordinator", coord->short_addr, 4);
 		} else {
-			uint64_t addr = nla_get_u64(coord);
-			printf("\tcoordinator 0x%016" PRIx64 "\n", le64toh(addr));
+			render_text("\tcoordinator 0x%016" PRIx64 "\n",
+				    coord->extended_addr);
+			render_x("coordinator", coord->extended_addr, 16);
 		}
 	}
-	if (pan[NL802154_COORD_PAGE]) {
-		printf("\tpage %u\n", nla_get_u8(pan[NL802154_COORD_PAGE]));
+	if (coord->valid & IWPAN_COORD_PAGE) {
+		render_text("\tpage %u\n", coord->page);
+		render_u("page", coord->page);
 	}
-	if (pan[NL802154_COORD_CHANNEL]) {
-		printf("\tchannel %u\n", nla_get_u8(pan[NL802154_COORD_CHANNEL]));
+	if (coord->valid & IWPAN_COORD_CHANNEL) {
+		render_text("\tchannel %u\n", coord->channel);
+		render_u("channel", coord->channel);
 	}
-	if (pan[NL802154_COORD_SUPERFRAME_SPEC]) {
-		printf("\tsuperframe spec. 0x%x\n", nla_get_u16(
-				pan[NL802154_COORD_SUPERFRAME_SPEC]));
+	if (coord->valid & IWPAN_COORD_SUPERFRAME_SPEC) {
+		render_text("\tsuperframe spec. 0x%x\n", coord->superframe_spec);
+		render_x("superframe_spec", coord->superframe_spec, 4);
 	}
-	if (pan[NL802154_COORD_LINK_QUALITY]) {
-		printf("\tLQI %x\n", nla_get_u8(
-				pan[NL802154_COORD_LINK_QUALITY]));
+	if (coord->valid & IWPAN_COORD_LINK_QUALITY) {
+		render_text("\tLQI %x\n", coord->link_quality);
+		render_u("lqi", coord->link_quality);
 	}
-	if (pan[NL802154_COORD_GTS_PERMIT]) {
-		printf("\tGTS permitted\n");
+	if (coord->valid & IWPAN_COORD_GTS_PERMIT) {
+		render_text("\tGTS permitted\n");
+		render_bool("gts_permit", true);
 	}
+	render_end();
 
 	/* TODO: Beacon IES display/decoding */
 
-	return NL_OK;
+	/* results trickle in over the scan, don't hold them back */
+	render_flush();
 }
 
 static int parse_and_print_new_coordinator(struct nlattr *nestedcoord,
 					   struct nlattr *ifattr)
 {
 	struct ieee802154_addr *addr;
+	struct iwpan_coord coord;
+	int ret;
+
+	ret = iwpan_parse_coord(nestedcoord, &coord);
+	if (ret < 0 && ret != -EINVAL) {
+		fprintf(stderr, "failed to parse nested attributes! (ret = %d)\n",
+			ret);
+		return NL_SKIP;
+	}
+	if (ret < 0)
+		return NL_SKIP;
 
-	addr = parse_new_coordinator(nestedcoord);
+	addr = new_coordinator_addr(&coord);
 	if (!addr)
 		return NL_SKIP;
 
@@ -375,7 +351,7 @@ static int parse_and_print_new_coordinator(struct nlattr *nestedcoord,
 		free(addr);
 	} else {
 		record_coord(addr);
-		print_new_coordinator(nestedcoord, ifattr);
+		print_new_coordinator(&coord, ifattr);
 	}
 
 	return NL_OK;
@@ -484,7 +460,7 @@ static int scan_handler(struct nl802154_state *state, struct nl_cb *cb,
 	genlmsg_put(msg, 0, 0, state->nl802154_id, 0, 0,
 		    NL802154_CMD_TRIGGER_SCAN, 0);
 
-	sd.devidx = if_nametoindex(*argv);
+	sd.devidx = names_ifindex(*argv);
 	if (sd.devidx == 0)
 		sd.devidx = -1;
 
@@ -500,7 +476,7 @@ static int scan_handler(struct nl802154_state *state, struct nl_cb *cb,
 		goto nla_put_failure;
 
 	/* Configure socket to receive messages in Scan multicast group */
-	group = genl_ctrl_resolve_grp(state->nl_sock, "nl802154", "scan");
+	group = nl802154_resolve_grp(state, "scan");
 	if (group < 0) {
 		ret = group;
 		goto nla_put_failure;
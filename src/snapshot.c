@@ -0,0 +1,342 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * A snapshot holds all phys, their interfaces and the associations of those,
+ * read so they belong to one generation: the interfaces are dumped before
+ * and after the rest and everything is read again if their generation
+ * moved in between. The kernel only bumps the generation when interfaces
+ * come or go, settings changed in between go unnoticed.
+ */
+#define SNAPSHOT_RETRIES	3
+
+struct snapshot_iface {
+	struct iwpan_iface iface;
+	struct iwpan_assoc *assocs;
+	int n_assocs;
+};
+
+struct snapshot {
+	struct iwpan_phy *phys;
+	int n_phys;
+	struct snapshot_iface *ifaces;
+	int n_ifaces;
+	uint64_t generation;
+};
+
+static int snapshot_phy_handler(struct nl_msg *msg, void *arg)
+{
+	struct snapshot *snap = arg;
+	struct iwpan_phy *phys;
+
+	phys = realloc(snap->phys, (snap->n_phys + 1) * sizeof(*phys));
+	if (!phys)
+		return NL_SKIP;
+	snap->phys = phys;
+
+	if (!iwpan_parse_phy(msg, &phys[snap->n_phys]))
+		snap->n_phys++;
+
+	return NL_SKIP;
+}
+
+static int snapshot_iface_handler(struct nl_msg *msg, void *arg)
+{
+	struct snapshot *snap = arg;
+	struct snapshot_iface *ifaces;
+
+	ifaces = realloc(snap->ifaces, (snap->n_ifaces + 1) * sizeof(*ifaces));
+	if (!ifaces)
+		return NL_SKIP;
+	snap->ifaces = ifaces;
+
+	memset(&ifaces[snap->n_ifaces], 0, sizeof(*ifaces));
+	if (!iwpan_parse_iface(msg, &ifaces[snap->n_ifaces].iface))
+		snap->n_ifaces++;
+
+	return NL_SKIP;
+}
+
+static int snapshot_assoc_handler(struct nl_msg *msg, void *arg)
+{
+	struct snapshot_iface *si = arg;
+	struct iwpan_assoc *assocs;
+	struct nlattr *peer;
+
+	peer = nlmsg_find_attr(nlmsg_hdr(msg), GENL_HDRLEN, NL802154_ATTR_PEER);
+	if (!peer)
+		return NL_SKIP;
+
+	assocs = realloc(si->assocs, (si->n_assocs + 1) * sizeof(*assocs));
+	if (!assocs)
+		return NL_SKIP;
+	si->assocs = assocs;
+
+	if (!iwpan_parse_assoc(peer, &assocs[si->n_assocs]))
+		si->n_assocs++;
+
+	return NL_SKIP;
+}
+
+/* for dumps which are only run for their generation */
+static int snapshot_skip_handler(struct nl_msg *msg, void *arg)
+{
+	return NL_SKIP;
+}
+
+static void snapshot_phy_reset(void *arg)
+{
+	struct snapshot *snap = arg;
+
+	while (snap->n_phys)
+		iwpan_phy_free(&snap->phys[--snap->n_phys]);
+}
+
+static void snapshot_assoc_reset(void *arg)
+{
+	struct snapshot_iface *si = arg;
+
+	si->n_assocs = 0;
+}
+
+static void snapshot_free(struct snapshot *snap)
+{
+	int i;
+
+	for (i = 0; i < snap->n_ifaces; i++)
+		free(snap->ifaces[i].assocs);
+	free(snap->ifaces);
+	snapshot_phy_reset(snap);
+	free(snap->phys);
+	memset(snap, 0, sizeof(*snap));
+}
+
+static void snapshot_iface_reset(void *arg)
+{
+	snapshot_free(arg);
+}
+
+static int snapshot_generation(struct nl802154_state *state, uint64_t *gen)
+{
+	struct dump_req dump = {
+		.cmd = NL802154_CMD_GET_INTERFACE,
+		.valid = snapshot_skip_handler,
+	};
+	int err;
+
+	err = nl802154_dump(state, &dump);
+	*gen = dump.generation;
+	return err;
+}
+
+static int snapshot_read(struct nl802154_state *state, struct snapshot *snap)
+{
+	struct dump_req iface_dump = {
+		.cmd = NL802154_CMD_GET_INTERFACE,
+		.valid = snapshot_iface_handler,
+		.reset = snapshot_iface_reset,
+		.arg = snap,
+	};
+	struct dump_req phy_dump = {
+		.cmd = NL802154_CMD_GET_WPAN_PHY,
+		.valid = snapshot_phy_handler,
+		.reset = snapshot_phy_reset,
+		.arg = snap,
+	};
+	struct dump_req assoc_dump = {
+		.cmd = NL802154_CMD_LIST_ASSOCIATIONS,
+		.valid = snapshot_assoc_handler,
+		.reset = snapshot_assoc_reset,
+	};
+	uint64_t gen;
+	int i, err, tries;
+
+	for (tries = 0; tries < SNAPSHOT_RETRIES; tries++) {
+		snapshot_free(snap);
+
+		err = nl802154_dump(state, &iface_dump);
+		if (err)
+			return err;
+		snap->generation = iface_dump.generation;
+
+		err = nl802154_dump(state, &phy_dump);
+		if (err)
+			return err;
+
+		for (i = 0; i < snap->n_ifaces; i++) {
+			assoc_dump.ifindex = snap->ifaces[i].iface.ifindex;
+			assoc_dump.arg = &snap->ifaces[i];
+			err = nl802154_dump(state, &assoc_dump);
+			/* not every interface type keeps associations */
+			if (err == -EOPNOTSUPP || err == -EINVAL)
+				err = 0;
+			/* or the interface is gone already */
+			if (err && err != -ENODEV)
+				return err;
+		}
+
+		err = snapshot_generation(state, &gen);
+		if (err)
+			return err;
+		if (gen == snap->generation)
+			return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static void snapshot_render_assocs(const struct snapshot_iface *si)
+{
+	const struct iwpan_assoc *assoc;
+	int i;
+
+	render_list_begin("associations");
+	for (i = 0; i < si->n_assocs; i++) {
+		assoc = &si->assocs[i];
+		render_text("\t\t%s: 0x%04x / 0x%016llx\n",
+			    assoc->peer_type == NL802154_PEER_TYPE_PARENT ?
+			    "parent" : "child ", assoc->short_addr,
+			    (unsigned long long)assoc->extended_addr);
+		render_begin(NULL);
+		render_s("peer", assoc->peer_type == NL802154_PEER_TYPE_PARENT ?
+			 "parent" : "child");
+		render_x("short_addr", assoc->short_addr, 4);
+		render_x("extended_addr", assoc->extended_addr, 16);
+		render_end();
+	}
+	render_list_end();
+}
+
+static void snapshot_render_iface(const struct snapshot_iface *si)
+{
+	const struct iwpan_iface *iface = &si->iface;
+	const struct iwpan_field *f;
+
+	render_begin(NULL);
+	if (iface->valid & IWPAN_IFACE_NAME)
+		render_text("\tInterface %s\n", iface->name);
+	else
+		render_text("\tUnnamed/non-netdev interface\n");
+
+	for (f = iwpan_iface_fields; f->name; f++) {
+		if (!(iface->valid & f->valid))
+			continue;
+		/* the phy is the parent, the generation is the snapshot's */
+		if (f->valid == IWPAN_IFACE_PHY)
+			render_u(f->name, iface->phy);
+		else if (f->valid == IWPAN_IFACE_NAME)
+			render_s(f->name, iface->name);
+		else if (f->valid == IWPAN_IFACE_GENERATION)
+			render_u(f->name, iface->generation);
+		else
+			render_field("\t", f, iface);
+	}
+
+	snapshot_render_assocs(si);
+	render_end();
+}
+
+static void snapshot_render(const struct snapshot *snap)
+{
+	const struct iwpan_phy *phy;
+	const struct iwpan_field *f;
+	int i, j;
+
+	render_begin(NULL);
+	render_text("generation 0x%016llx\n",
+		    (unsigned long long)snap->generation);
+	render_x("generation", snap->generation, 16);
+
+	render_list_begin("phys");
+	for (i = 0; i < snap->n_phys; i++) {
+		phy = &snap->phys[i];
+
+		render_begin(NULL);
+		render_text("phy#%u\n", phy->index);
+		render_u("index", phy->index);
+		for (f = iwpan_phy_fields; f->name; f++) {
+			if (phy->valid & f->valid)
+				render_field("", f, phy);
+		}
+
+		render_list_begin("interfaces");
+		for (j = 0; j < snap->n_ifaces; j++) {
+			if ((snap->ifaces[j].iface.valid & IWPAN_IFACE_PHY) &&
+			    snap->ifaces[j].iface.phy == phy->index)
+				snapshot_render_iface(&snap->ifaces[j]);
+		}
+		render_list_end();
+		render_end();
+	}
+	render_list_end();
+	render_end();
+}
+
+static int handle_snapshot(struct nl802154_state *state,
+			   struct nl_cb *cb,
+			   struct nl_msg *msg,
+			   int argc, char **argv,
+			   enum id_input id)
+{
+	struct snapshot snap = { .phys = NULL };
+	unsigned long long since;
+	uint64_t gen;
+	char *end;
+	int err;
+
+	/* skip "snapshot" */
+	argc--;
+	argv++;
+
+	if (argc == 2 && strcmp(argv[0], "since") == 0) {
+		since = strtoull(argv[1], &end, 0);
+		if (!*argv[1] || *end != '\0')
+			return 1;
+
+		err = snapshot_generation(state, &gen);
+		if (err)
+			return err;
+
+		if (gen == since) {
+			render_begin(NULL);
+			render_text("unchanged\n");
+			render_x("generation", gen, 16);
+			render_bool("changed", false);
+			render_end();
+			return 0;
+		}
+	} else if (argc) {
+		return 1;
+	}
+
+	err = snapshot_read(state, &snap);
+	if (err == -EAGAIN)
+		fprintf(stderr, "interfaces kept changing, no consistent snapshot\n");
+	else if (!err)
+		snapshot_render(&snap);
+
+	snapshot_free(&snap);
+	return err;
+}
+TOPLEVEL(snapshot, "[since <generation>]", 0, 0, CIB_NONE, handle_snapshot,
+	 "Show all phys with their interfaces and associations, read\n"
+	 "consistently and tagged with the generation they belong to.\n"
+	 "Given an earlier generation, only print \"unchanged\" if the\n"
+	 "interfaces are still the same. The kernel bumps the generation\n"
+	 "when interfaces are added or removed, not on setting changes.");
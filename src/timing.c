@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <netlink/genl/genl.h>
+
+#include "nl802154.h"
+#include "iwpan.h"
+
+/*
+ * With --timing the time spent in each phase is summed up until a command
+ * is done, then added to the row of its command type. "kernel" is the time
+ * blocked in send and receive, "handle" the time spent parsing and
+ * formatting the replies in between, "output" writing them out. With a
+ * pipeline the whole flush is charged to the command which triggered it.
+ * A daemon started with --timing prints its rows on SIGUSR1.
+ */
+struct timing_row {
+	char name[48];
+	unsigned int runs;
+	uint64_t ns[TIMING_PHASES];
+	uint64_t total;
+};
+
+static const char *phase_names[TIMING_PHASES] = {
+	[TIMING_INIT] = "init",
+	[TIMING_RESOLVE] = "resolve",
+	[TIMING_LOOKUP] = "lookup",
+	[TIMING_BUILD] = "build",
+	[TIMING_KERNEL] = "kernel",
+	[TIMING_HANDLE] = "handle",
+	[TIMING_OUTPUT] = "output",
+};
+
+bool iwpan_timing;
+
+static uint64_t pending[TIMING_PHASES];
+static uint64_t last_end;
+static struct timing_row *rows;
+static int n_rows;
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void timing_enable(void)
+{
+	iwpan_timing = true;
+	last_end = clock_ns();
+}
+
+uint64_t timing_now(void)
+{
+	return iwpan_timing ? clock_ns() : 0;
+}
+
+void timing_add(enum timing_phase phase, uint64_t since)
+{
+	if (iwpan_timing)
+		pending[phase] += clock_ns() - since;
+}
+
+uint64_t timing_get(enum timing_phase phase)
+{
+	return pending[phase];
+}
+
+/* time since since, less what went to the kernel meanwhile */
+void timing_add_handled(uint64_t since, uint64_t kernel)
+{
+	if (iwpan_timing)
+		pending[TIMING_HANDLE] += clock_ns() - since -
+					  (pending[TIMING_KERNEL] - kernel);
+}
+
+static int timing_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+		       unsigned char **buf, struct ucred **creds)
+{
+	uint64_t t = timing_now();
+	int ret;
+
+	ret = nl_recv(sk, nla, buf, creds);
+	timing_add(TIMING_KERNEL, t);
+	return ret;
+}
+
+/* count the time spent waiting for replies on cb as kernel time */
+void timing_cb(struct nl_cb *cb)
+{
+	if (iwpan_timing)
+		nl_cb_overwrite_recv(cb, timing_recv);
+}
+
+/* charge what was measured since the last call to cmd, or name without one */
+void timing_end(const struct cmd *cmd, const char *name)
+{
+	struct timing_row *row = NULL;
+	char buf[sizeof(row->name)];
+	uint64_t now;
+	int i;
+
+	if (!iwpan_timing)
+		return;
+
+	if (cmd && cmd->parent && cmd->parent->name)
+		snprintf(buf, sizeof(buf), "%s %s", cmd->parent->name, cmd->name);
+	else
+		snprintf(buf, sizeof(buf), "%s", cmd ? cmd->name : name);
+
+	for (i = 0; i < n_rows; i++) {
+		if (strcmp(rows[i].name, buf) == 0) {
+			row = &rows[i];
+			break;
+		}
+	}
+
+	if (!row) {
+		row = realloc(rows, (n_rows + 1) * sizeof(*rows));
+		if (!row)
+			return;
+		rows = row;
+		row = &rows[n_rows++];
+		memset(row, 0, sizeof(*row));
+		strcpy(row->name, buf);
+	}
+
+	now = clock_ns();
+	row->runs++;
+	row->total += now - last_end;
+	for (i = 0; i < TIMING_PHASES; i++)
+		row->ns[i] += pending[i];
+
+	memset(pending, 0, sizeof(pending));
+	last_end = now;
+}
+
+/* mean per run of every command type in ms, on stderr */
+void timing_report(void)
+{
+	uint64_t other;
+	int i, j;
+
+	if (!iwpan_timing || !n_rows)
+		return;
+
+	fprintf(stderr, "%-24s %5s", "timing (ms per run)", "runs");
+	for (j = 0; j < TIMING_PHASES; j++)
+		fprintf(stderr, " %8s", phase_names[j]);
+	fprintf(stderr, " %8s %8s\n", "other", "total");
+
+	for (i = 0; i < n_rows; i++) {
+		other = rows[i].total;
+		fprintf(stderr, "%-24s %5u", rows[i].name, rows[i].runs);
+		for (j = 0; j < TIMING_PHASES; j++) {
+			fprintf(stderr, " %8.3f",
+				rows[i].ns[j] / 1e6 / rows[i].runs);
+			other -= other > rows[i].ns[j] ? rows[i].ns[j] : other;
+		}
+		fprintf(stderr, " %8.3f %8.3f\n", other / 1e6 / rows[i].runs,
+			rows[i].total / 1e6 / rows[i].runs);
+	}
+}
@@ -0,0 +1,615 @@
+// SPDX-FileCopyrightText: 2026 The wpan-tools developers
+//
+// SPDX-License-Identifier: ISC
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "nl802154.h"
+#include "libiwpan.h"
+#include "iwpan.h"
+
+/*
+ * A grid search over the CSMA/CA settings the phy's caps allow: min and
+ * max BE, CSMA backoffs and frame retries, each axis sampled at up to
+ * "steps" values. Every point is set, with the interface taken down for
+ * it, and probed against the peer. A quarter of the probes come first and
+ * the point is dropped if a point measured in full beats that on
+ * throughput, latency and loss alike. The Pareto front of what is left is
+ * reported, the settings found at the start are restored.
+ */
+#define TUNE_MAX_STEPS		8
+#define TUNE_DEFAULT_STEPS	3
+#define TUNE_DEFAULT_COUNT	40
+#define TUNE_DEFAULT_LEN	20
+#define TUNE_DEFAULT_TIMEOUT	500
+#define TUNE_THROUGHPUT_WINDOW	8
+
+enum tune_axis_id {
+	TUNE_MIN_BE,
+	TUNE_MAX_BE,
+	TUNE_BACKOFFS,
+	TUNE_RETRIES,
+	TUNE_AXES,
+};
+
+struct tune_axis {
+	int vals[TUNE_MAX_STEPS];
+	int n;
+};
+
+struct tune_point {
+	int val[TUNE_AXES];
+	struct probe_result res;
+	bool pruned;
+};
+
+struct tune_state {
+	const char *dev;
+	int sd;
+	struct probe_peer peer;
+	unsigned int count, len, window, timeout;
+	struct tune_point *points;
+	int n_points, n_pruned;
+};
+
+static volatile sig_atomic_t tune_stop;
+
+static void tune_sigint(int sig)
+{
+	tune_stop = 1;
+}
+
+/* steps values from lo to hi, both included, or cur if the phy has no range */
+static void tune_axis_init(struct tune_axis *axis, bool valid, int lo, int hi,
+			   int cur, int steps)
+{
+	int i, val;
+
+	axis->n = 0;
+	if (!valid || hi < lo) {
+		axis->vals[axis->n++] = cur;
+		return;
+	}
+
+	if (hi - lo + 1 < steps)
+		steps = hi - lo + 1;
+	for (i = 0; i < steps; i++) {
+		val = steps > 1 ? lo + (hi - lo) * i / (steps - 1) : lo;
+		if (axis->n && axis->vals[axis->n - 1] == val)
+			continue;
+		axis->vals[axis->n++] = val;
+	}
+}
+
+static double tune_latency(const struct probe_result *res)
+{
+	return res->received ? probe_latency(res) : HUGE_VAL;
+}
+
+/* a at least as good as b everywhere and better somewhere */
+static bool tune_dominates(const struct probe_result *a,
+			   const struct probe_result *b)
+{
+	double ta = probe_throughput(a), tb = probe_throughput(b);
+	double la = tune_latency(a), lb = tune_latency(b);
+	double oa = probe_loss(a), ob = probe_loss(b);
+
+	return ta >= tb && la <= lb && oa <= ob &&
+	       (ta > tb || la < lb || oa < ob);
+}
+
+/* a better than b everywhere, enough to give up on b early */
+static bool tune_beats(const struct probe_result *a,
+		       const struct probe_result *b)
+{
+	return probe_throughput(a) > probe_throughput(b) &&
+	       tune_latency(a) < tune_latency(b) &&
+	       probe_loss(a) < probe_loss(b);
+}
+
+static int tune_cmd(struct nl802154_state *state, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static int tune_cmd(struct nl802154_state *state, const char *fmt, ...)
+{
+	char *args[BATCH_MAX_ARGS];
+	char line[128];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+
+	n = batch_split_line(line, args);
+	return handle_args(state, n, args, NULL, NULL, NULL, 0);
+}
+
+/* bring the interface to val, it has to be down for that */
+static int tune_set(struct nl802154_state *state, struct tune_state *ts,
+		    const int *val)
+{
+	int err, ret;
+
+	err = probe_link(ts->sd, ts->dev, false);
+	if (err < 0)
+		return err;
+
+	err = tune_cmd(state, "dev %s set backoff_exponents %d %d", ts->dev,
+		       val[TUNE_MIN_BE], val[TUNE_MAX_BE]);
+	if (!err)
+		err = tune_cmd(state, "dev %s set max_csma_backoffs %d",
+			       ts->dev, val[TUNE_BACKOFFS]);
+	if (!err)
+		err = tune_cmd(state, "dev %s set max_frame_retries %d",
+			       ts->dev, val[TUNE_RETRIES]);
+
+	ret = probe_link(ts->sd, ts->dev, true);
+	if (!err && ret < 0)
+		err = ret;
+	return err > 0 ? -EINVAL : err;
+}
+
+static int tune_measure(struct nl802154_state *state, struct tune_state *ts,
+		      struct tune_point *p)
+{
+	unsigned int first = (ts->count + 3) / 4;
+	int i, err;
+
+	err = tune_set(state, ts, p->val);
+	if (err)
+		return err;
+
+	err = probe_run(ts->sd, &ts->peer, first, ts->window, ts->len,
+			ts->timeout, &p->res);
+	if (err)
+		return err;
+
+	for (i = 0; i < ts->n_points; i++) {
+		if (!ts->points[i].pruned &&
+		    tune_beats(&ts->points[i].res, &p->res)) {
+			p->pruned = true;
+			ts->n_pruned++;
+			return 0;
+		}
+	}
+
+	return probe_run(ts->sd, &ts->peer, ts->count - first, ts->window,
+			 ts->len, ts->timeout, &p->res);
+}
+
+static void tune_report(struct tune_state *ts)
+{
+	const struct tune_point *p;
+	int i, j;
+
+	render_begin(NULL);
+	render_text("%d points, %d pruned early, Pareto front:\n",
+		    ts->n_points, ts->n_pruned);
+	render_u("points", ts->n_points);
+	render_u("pruned", ts->n_pruned);
+
+	render_list_begin("front");
+	for (i = 0; i < ts->n_points; i++) {
+		p = &ts->points[i];
+		if (p->pruned)
+			continue;
+		for (j = 0; j < ts->n_points; j++) {
+			if (!ts->points[j].pruned &&
+			    tune_dominates(&ts->points[j].res, &p->res))
+				break;
+		}
+		if (j < ts->n_points)
+			continue;
+
+		render_begin(NULL);
+		render_text("\tbackoff_exponents %d %d max_csma_backoffs %d max_frame_retries %d: %.0f B/s, %.2f ms, %.1f%% loss\n",
+			    p->val[TUNE_MIN_BE], p->val[TUNE_MAX_BE],
+			    p->val[TUNE_BACKOFFS], p->val[TUNE_RETRIES],
+			    probe_throughput(&p->res), probe_latency(&p->res),
+			    100 * probe_loss(&p->res));
+		render_u("min_be", p->val[TUNE_MIN_BE]);
+		render_u("max_be", p->val[TUNE_MAX_BE]);
+		render_u("max_csma_backoffs", p->val[TUNE_BACKOFFS]);
+		render_d("max_frame_retries", p->val[TUNE_RETRIES]);
+		render_f("throughput", probe_throughput(&p->res));
+		render_f("latency_ms", probe_latency(&p->res));
+		render_f("loss", probe_loss(&p->res));
+		render_end();
+	}
+	render_list_end();
+	render_end();
+}
+
+static int tune_parse_u(const char *arg, unsigned int min, unsigned int max,
+			unsigned int *val)
+{
+	unsigned long v;
+	char *end;
+
+	v = strtoul(arg, &end, 0);
+	if (!*arg || *end != '\0' || v < min || v > max)
+		return -EINVAL;
+	*val = v;
+	return 0;
+}
+
+static int handle_tune(struct nl802154_state *state,
+		       struct nl_cb *cb,
+		       struct nl_msg *msg,
+		       int argc, char **argv,
+		       enum id_input id)
+{
+	struct tune_state ts = {
+		.count = TUNE_DEFAULT_COUNT,
+		.len = TUNE_DEFAULT_LEN,
+		.window = 1,
+		.timeout = TUNE_DEFAULT_TIMEOUT,
+	};
+	struct tune_axis axes[TUNE_AXES];
+	const struct iwpan_caps *caps;
+	struct iwpan_iface iface;
+	struct iwpan_phy phy;
+	unsigned int steps = TUNE_DEFAULT_STEPS;
+	int orig[TUNE_AXES], idx[TUNE_AXES];
+	bool have_peer = false;
+	struct tune_point *p;
+	int i, err, ret, was_up;
+
+	ts.dev = argv[0];
+
+	/* Skip "<iface> tune" */
+	argc -= 2;
+	argv += 2;
+
+	for (; argc >= 2; argc -= 2, argv += 2) {
+		if (strcmp(argv[0], "peer") == 0) {
+			if (probe_parse_addr(argv[1], &ts.peer))
+				return 1;
+			have_peer = true;
+		} else if (strcmp(argv[0], "probe") == 0) {
+			if (strcmp(argv[1], "echo") == 0)
+				ts.window = 1;
+			else if (strcmp(argv[1], "throughput") == 0)
+				ts.window = TUNE_THROUGHPUT_WINDOW;
+			else
+				return 1;
+		} else if (strcmp(argv[0], "count") == 0) {
+			if (tune_parse_u(argv[1], 4, 100000, &ts.count))
+				return 1;
+		} else if (strcmp(argv[0], "len") == 0) {
+			if (tune_parse_u(argv[1], 4, PROBE_MAX_LEN, &ts.len))
+				return 1;
+		} else if (strcmp(argv[0], "steps") == 0) {
+			if (tune_parse_u(argv[1], 1, TUNE_MAX_STEPS, &steps))
+				return 1;
+		} else if (strcmp(argv[0], "timeout") == 0) {
+			if (tune_parse_u(argv[1], 1, 60000, &ts.timeout))
+				return 1;
+		} else {
+			return 1;
+		}
+	}
+	if (argc || !have_peer)
+		return 1;
+
+	err = nl802154_get_iface(state, names_ifindex(ts.dev), &iface, &phy);
+	if (err)
+		return err;
+
+	orig[TUNE_MIN_BE] = iface.min_be;
+	orig[TUNE_MAX_BE] = iface.max_be;
+	orig[TUNE_BACKOFFS] = iface.max_csma_backoffs;
+	orig[TUNE_RETRIES] = iface.max_frame_retries;
+
+	caps = &phy.caps;
+	if (!(phy.valid & IWPAN_PHY_CAPS))
+		fprintf(stderr, "%s reports no capabilities, keeping the current settings\n",
+			phy.name);
+	tune_axis_init(&axes[TUNE_MIN_BE],
+		       (phy.valid & IWPAN_PHY_CAPS) && (caps->valid & IWPAN_CAPS_BE),
+		       caps->min_minbe, caps->max_minbe, orig[TUNE_MIN_BE], steps);
+	tune_axis_init(&axes[TUNE_MAX_BE],
+		       (phy.valid & IWPAN_PHY_CAPS) && (caps->valid & IWPAN_CAPS_BE),
+		       caps->min_maxbe, caps->max_maxbe, orig[TUNE_MAX_BE], steps);
+	tune_axis_init(&axes[TUNE_BACKOFFS],
+		       (phy.valid & IWPAN_PHY_CAPS) &&
+		       (caps->valid & IWPAN_CAPS_CSMA_BACKOFFS),
+		       caps->min_csma_backoffs, caps->max_csma_backoffs,
+		       orig[TUNE_BACKOFFS], steps);
+	tune_axis_init(&axes[TUNE_RETRIES],
+		       (phy.valid & IWPAN_PHY_CAPS) &&
+		       (caps->valid & IWPAN_CAPS_FRAME_RETRIES),
+		       caps->min_frame_retries, caps->max_frame_retries,
+		       orig[TUNE_RETRIES], steps);
+	iwpan_phy_free(&phy);
+
+	ts.sd = probe_open(&iface, &ts.peer);
+	if (ts.sd < 0)
+		return ts.sd;
+
+	was_up = probe_link(ts.sd, ts.dev, true);
+	if (was_up < 0) {
+		close(ts.sd);
+		return was_up;
+	}
+
+	tune_stop = 0;
+	signal(SIGINT, tune_sigint);
+
+	memset(idx, 0, sizeof(idx));
+	while (!tune_stop) {
+		p = realloc(ts.points, (ts.n_points + 1) * sizeof(*p));
+		if (!p) {
+			err = -ENOMEM;
+			break;
+		}
+		ts.points = p;
+		p = &ts.points[ts.n_points];
+		memset(p, 0, sizeof(*p));
+		for (i = 0; i < TUNE_AXES; i++)
+			p->val[i] = axes[i].vals[idx[i]];
+
+		if (p->val[TUNE_MIN_BE] <= p->val[TUNE_MAX_BE]) {
+			err = tune_measure(state, &ts, p);
+			if (err)
+				break;
+			ts.n_points++;
+		}
+
+		/* next point, the last axis counting fastest */
+		for (i = TUNE_AXES - 1; i >= 0; i--) {
+			if (++idx[i] < axes[i].n)
+				break;
+			idx[i] = 0;
+		}
+		if (i < 0)
+			break;
+	}
+
+	signal(SIGINT, SIG_DFL);
+
+	if (err)
+		fprintf(stderr, "probing failed: %s (%d)\n", strerror(-err), err);
+	else if (tune_stop)
+		fprintf(stderr, "interrupted, front of the points so far:\n");
+	if (ts.n_points)
+		tune_report(&ts);
+
+	ret = tune_set(state, &ts, orig);
+	if (ret)
+		fprintf(stderr, "restoring the settings of %s failed: %s (%d)\n",
+			ts.dev, strerror(-ret), ret);
+	if (!was_up)
+		probe_link(ts.sd, ts.dev, false);
+
+	close(ts.sd);
+	free(ts.points);
+	return err ? err : ret;
+}
+TOPLEVEL(tune, "peer <addr> [probe echo|throughput] [count <n>] [len <bytes>] [steps <n>] [timeout <ms>]",
+	0, 0, CIB_NETDEV, handle_tune,
+	"Search the min/max BE, CSMA backoffs and frame retries the phy\n"
+	"supports for the best throughput, latency and loss to a peer running\n"
+	"'wpan-ping -d', and print the Pareto front. Each axis is sampled at\n"
+	"steps values (default 3), each point probed with count frames of\n"
+	"len bytes, one at a time or a window of them with 'probe throughput'.\n"
+	"The interface is taken down for every change, the settings found at\n"
+	"the start are restored at the end.");
+
+/*
+ * The lowest TX power of the phy at which the peer answers at least pdr
+ * percent of the requests and, with a latency target, percentile percent
+ * of them come back within it. Levels are tried from the lowest up and
+ * the first one meeting both ends the search.
+ */
+#define TUNE_DEFAULT_PDR	95
+#define TUNE_DEFAULT_PERCENTILE	95
+
+static int tune_cmp_level(const void *a, const void *b)
+{
+	int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int tune_tx_power(struct nl802154_state *state, const char *phy,
+			 int32_t mbm)
+{
+	return tune_cmd(state, "phy %s set tx_power %.2f", phy, MBM_TO_DBM(mbm));
+}
+
+static int handle_tune_tx_power(struct nl802154_state *state,
+				struct nl_cb *cb,
+				struct nl_msg *msg,
+				int argc, char **argv,
+				enum id_input id)
+{
+	unsigned int count = TUNE_DEFAULT_COUNT, len = TUNE_DEFAULT_LEN;
+	unsigned int timeout = TUNE_DEFAULT_TIMEOUT, pdr = TUNE_DEFAULT_PDR;
+	unsigned int percentile = TUNE_DEFAULT_PERCENTILE, latency = 0;
+	int32_t *levels;
+	struct probe_result res;
+	struct probe_peer peer;
+	struct iwpan_iface iface;
+	struct iwpan_phy phy;
+	bool have_peer = false, apply = false, met = false;
+	const char *dev = argv[0];
+	uint32_t *rtts;
+	double pct_ms;
+	int i, n, sd, err, ret, was_up, best = -1;
+
+	/* Skip "<iface> tune tx_power" */
+	argc -= 3;
+	argv += 3;
+
+	while (argc) {
+		if (strcmp(argv[0], "apply") == 0) {
+			apply = true;
+			argc--;
+			argv++;
+			continue;
+		}
+		if (argc < 2)
+			return 1;
+
+		if (strcmp(argv[0], "peer") == 0) {
+			if (probe_parse_addr(argv[1], &peer))
+				return 1;
+			have_peer = true;
+		} else if (strcmp(argv[0], "pdr") == 0) {
+			if (tune_parse_u(argv[1], 1, 100, &pdr))
+				return 1;
+		} else if (strcmp(argv[0], "latency") == 0) {
+			if (tune_parse_u(argv[1], 1, 60000, &latency))
+				return 1;
+		} else if (strcmp(argv[0], "percentile") == 0) {
+			if (tune_parse_u(argv[1], 1, 100, &percentile))
+				return 1;
+		} else if (strcmp(argv[0], "count") == 0) {
+			if (tune_parse_u(argv[1], 1, 100000, &count))
+				return 1;
+		} else if (strcmp(argv[0], "len") == 0) {
+			if (tune_parse_u(argv[1], 4, PROBE_MAX_LEN, &len))
+				return 1;
+		} else if (strcmp(argv[0], "timeout") == 0) {
+			if (tune_parse_u(argv[1], 1, 60000, &timeout))
+				return 1;
+		} else {
+			return 1;
+		}
+		argc -= 2;
+		argv += 2;
+	}
+	if (!have_peer)
+		return 1;
+
+	err = nl802154_get_iface(state, names_ifindex(dev), &iface, &phy);
+	if (err)
+		return err;
+
+	if (!(phy.valid & IWPAN_PHY_CAPS) ||
+	    !(phy.caps.valid & IWPAN_CAPS_TX_POWERS) || !phy.caps.n_tx_powers) {
+		fprintf(stderr, "%s reports no TX power levels\n", phy.name);
+		iwpan_phy_free(&phy);
+		return -ENODATA;
+	}
+	/* the phy is our copy, sort its levels in place */
+	n = phy.caps.n_tx_powers;
+	levels = phy.caps.tx_powers;
+	qsort(levels, n, sizeof(*levels), tune_cmp_level);
+
+	rtts = calloc(count, sizeof(*rtts));
+	if (!rtts) {
+		iwpan_phy_free(&phy);
+		return -ENOMEM;
+	}
+
+	sd = probe_open(&iface, &peer);
+	if (sd < 0) {
+		free(rtts);
+		iwpan_phy_free(&phy);
+		return sd;
+	}
+
+	was_up = probe_link(sd, dev, true);
+	if (was_up < 0) {
+		err = was_up;
+		goto out;
+	}
+
+	tune_stop = 0;
+	signal(SIGINT, tune_sigint);
+
+	render_begin(NULL);
+	render_s("dev", dev);
+	render_list_begin("levels");
+	for (i = 0; i < n && !tune_stop; i++) {
+		err = tune_tx_power(state, phy.name, levels[i]);
+		if (err)
+			break;
+
+		memset(&res, 0, sizeof(res));
+		res.rtts = rtts;
+		res.max_rtts = count;
+		err = probe_run(sd, &peer, count, 1, len, timeout, &res);
+		if (err)
+			break;
+
+		pct_ms = probe_percentile(&res, percentile);
+		met = 100 * (1 - probe_loss(&res)) >= pdr &&
+		      (!latency || pct_ms <= latency);
+
+		render_begin(NULL);
+		render_text("\t%.2f dBm: %.1f%% delivered, p%u %.2f ms%s\n",
+			    MBM_TO_DBM(levels[i]), 100 * (1 - probe_loss(&res)),
+			    percentile, pct_ms, met ? " *" : "");
+		render_f("tx_power", MBM_TO_DBM(levels[i]));
+		render_f("pdr", 1 - probe_loss(&res));
+		/* JSON has no infinity, leave it out */
+		if (isfinite(pct_ms))
+			render_f("latency_ms", pct_ms);
+		render_bool("met", met);
+		render_end();
+
+		if (met) {
+			best = i;
+			break;
+		}
+	}
+	render_list_end();
+
+	if (best >= 0) {
+		render_text("lowest TX power meeting the target: %.2f dBm%s\n",
+			    MBM_TO_DBM(levels[best]), apply ? ", applied" : "");
+		render_f("tx_power", MBM_TO_DBM(levels[best]));
+	} else if (!err && !tune_stop) {
+		render_text("no TX power meets the target\n");
+	}
+	render_bool("applied", best >= 0 && apply);
+	render_end();
+
+	signal(SIGINT, SIG_DFL);
+
+	if (err)
+		fprintf(stderr, "probing failed: %s (%d)\n", strerror(-err), err);
+
+	if (best >= 0 && apply)
+		ret = tune_tx_power(state, phy.name, levels[best]);
+	else if (phy.valid & IWPAN_PHY_TX_POWER)
+		ret = tune_tx_power(state, phy.name, phy.tx_power);
+	else
+		ret = 0;
+	if (ret)
+		fprintf(stderr, "setting the TX power of %s failed: %s (%d)\n",
+			phy.name, strerror(-ret), ret);
+	if (!was_up)
+		probe_link(sd, dev, false);
+	if (!err)
+		err = ret ? ret : best < 0 ? 2 : 0;
+out:
+	close(sd);
+	free(rtts);
+	iwpan_phy_free(&phy);
+	return err;
+}
+COMMAND(tune, tx_power, "peer <addr> [pdr <percent>] [latency <ms>] [percentile <percent>] [count <n>] [len <bytes>] [timeout <ms>] [apply]",
+	0, 0, CIB_NETDEV, handle_tune_tx_power,
+	"Find the lowest TX power of the phy at which a peer running\n"
+	"'wpan-ping -d' answers pdr percent (default 95) of count echo\n"
+	"requests and, with latency, percentile percent (default 95) of them\n"
+	"within that many ms. Levels are tried from the lowest up. With apply\n"
+	"the level found is kept, otherwise the TX power is restored.");
@@ -19,6 +19,7 @@
 #include <netlink/genl/ctrl.h>
 
 #include "mac802154_hwsim.h"
+#include "../src/nl_sock.h"
 #include "config.h"
 
 static struct nl_sock *nl_sock;
@@ -34,14 +35,14 @@ static int nlhwsim_init(void)
 		return -ENOMEM;
 	}
 
-	nl_socket_set_buffer_size(nl_sock, 8192, 8192);
-
 	if (genl_connect(nl_sock)) {
 		fprintf(stderr, "Failed to connect to generic netlink.\n");
 		err = -ENOLINK;
 		goto out_handle_destroy;
 	}
 
+	nlsock_tune(nl_sock, NL_RCVBUF_DEFAULT);
+
 	nlhwsim_id = genl_ctrl_resolve(nl_sock, "MAC802154_HWSIM");
 	if (nlhwsim_id < 0) {
 		fprintf(stderr, "MAC802154_HWSIM not found.\n");
@@ -66,7 +67,11 @@ static void nlhwsim_cleanup(void)
 static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err,
 			 void *arg)
 {
+	const char *msg = nlsock_ext_ack_msg(err);
 	int *ret = arg;
+
+	if (msg)
+		fprintf(stderr, "kernel reports: %s\n", msg);
 	*ret = err->error;
 	return NL_STOP;
 }
@@ -225,6 +230,9 @@ static int hwsim_dump(bool dot, int unsigned ignore_idx)
 		printf("digraph {\n");
 
 	rc = nl_send_sync(nl_sock, msg);
+	/* libnl reports ENOBUFS as out of memory */
+	if (rc == -NLE_NOMEM)
+		fprintf(stderr, "netlink receive buffer overrun, radio list is incomplete\n");
 	if (rc < 0)
 		return rc;
 
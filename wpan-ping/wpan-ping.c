@@ -13,6 +13,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -21,6 +22,10 @@
 #include <getopt.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <netlink/netlink.h>
 
@@ -31,6 +36,7 @@
 #include <netlink/attr.h>
 
 #include "../src/nl802154.h"
+#include "../src/nl_sock.h"
 
 #define MIN_PAYLOAD_LEN 5
 #define MAX_PAYLOAD_LEN 105 //116 with short address
@@ -38,6 +44,29 @@
 /* Set the dispatch header to not 6lowpan for compat */
 #define NOT_A_6LOWPAN_FRAME 0x00
 #define DEFAULT_INTERVAL 500
+#define DEFAULT_STATS_INTERVAL 10
+/* the poll timeout is in ms and an int */
+#define MAX_STATS_INTERVAL (INT_MAX / 1000)
+#define CLIENT_TABLE_MIN_SIZE 64
+#define CLIENT_TABLE_MAX_CLIENTS 1024
+#define ECHO_POOL_SIZE 256
+#define ECHO_QUEUE_LIMIT 16
+#define ECHO_QUANTUM MAX_PAYLOAD_LEN
+#define DEFAULT_BURST 5
+#define DEFAULT_WATCH_INTERVAL 10000
+#define DEFAULT_WATCH_WINDOW 100
+#define DEFAULT_WATCH_PERCENTILE 95
+#define WATCH_MIN_SAMPLES 5
+#define WATCH_LOST UINT32_MAX
+#define DEFAULT_DUTY_WINDOW 3600
+#define AIRTIME_BUCKETS 60
+/* preamble, SFD and PHR in front of every PSDU */
+#define PHY_HEADER_LEN 6
+#define FCS_LEN 2
+/* default radio power model, typical for 2.4 GHz transceivers */
+#define DEFAULT_PM_BASE_MA 12.0
+#define DEFAULT_PM_MA_PER_DBM 0.6
+#define DEFAULT_PM_VOLTS 3.0
 
 #define DEBUG 0
 
@@ -69,6 +98,15 @@ static const struct option perf_long_opts[] = {
 	{ "count", required_argument, NULL, 'c' },
 	{ "size", required_argument, NULL, 's' },
 	{ "interface", required_argument, NULL, 'i' },
+	{ "stats-file", required_argument, NULL, 'S' },
+	{ "stats-interval", required_argument, NULL, 'T' },
+	{ "rate", required_argument, NULL, 'r' },
+	{ "burst", required_argument, NULL, 'b' },
+	{ "watch", required_argument, NULL, 'W' },
+	{ "duty-cycle", required_argument, NULL, 'D' },
+	{ "duty-window", required_argument, NULL, 'w' },
+	{ "power-model", required_argument, NULL, 'P' },
+	{ "sizes", required_argument, NULL, 'z' },
 	{ "version", no_argument, NULL, 'v' },
 	{ "help", no_argument, NULL, 'h' },
 	{ NULL, 0, NULL, 0 },
@@ -86,8 +124,138 @@ struct config {
 	struct sockaddr_ieee802154 src;
 	struct sockaddr_ieee802154 dst;
 	unsigned short interval;
+	char *stats_file;
+	unsigned int stats_interval;
+	double rate;
+	unsigned int burst;
+	char *watch_file;
+	float duty_cycle;
+	unsigned int duty_window;
+	/* filled from netlink in get_interface_info */
+	bool have_phy;
+	uint32_t wpan_phy;
+	bool have_channel;
+	uint8_t page;
+	uint8_t channel;
+	bool have_tx_power;
+	int32_t tx_power; /* mBm */
+	/* TX current draw: base + slope * dBm at the given supply voltage */
+	float pm_base_ma;
+	float pm_ma_per_dbm;
+	float pm_volts;
+	char *sizes;
 };
 
+/* Outcome of one client run, used to compare runs */
+struct ping_result {
+	int packet_len;
+	int sent;
+	int received;
+	uint64_t airtime_us;
+};
+
+/* Airtime spent in a sliding window, kept in coarse buckets so memory does
+ * not depend on the frame rate.
+ */
+struct airtime {
+	unsigned int bitrate; /* bit/s, 0 if unknown */
+	unsigned long bucket_ms;
+	uint64_t bucket_us[AIRTIME_BUCKETS];
+	uint64_t bucket_nr[AIRTIME_BUCKETS];
+	uint64_t total_us;
+};
+
+/* Per client state kept by the server, keyed by PAN ID and source address */
+struct client_key {
+	uint16_t pan_id;
+	uint8_t addr_type;
+	uint8_t addr[IEEE802154_ADDR_LEN];
+};
+
+/* Received frame waiting for its echo, taken from a preallocated pool */
+struct echo_frame {
+	struct echo_frame *next;
+	struct sockaddr_ieee802154 src;
+	socklen_t addrlen;
+	ssize_t len;
+	unsigned char buf[MAX_PAYLOAD_LEN];
+};
+
+struct echo_pool {
+	struct echo_frame frames[ECHO_POOL_SIZE];
+	struct echo_frame *free;
+};
+
+struct client_stats {
+	struct client_key key;
+	bool used;
+	bool have_seq;
+	unsigned short last_seq;
+	unsigned long received;
+	unsigned long echoed;
+	unsigned long send_failures;
+	unsigned long seq_gaps;
+	unsigned long dropped;
+	struct timeval last_seen;
+	/* token bucket */
+	double tokens;
+	struct timespec last_refill;
+	/* deficit round robin echo queue */
+	struct echo_frame *queue_head, *queue_tail;
+	unsigned int queued;
+	unsigned int deficit;
+};
+
+/* Open addressing hash table with linear probing. Only grows on new
+ * clients, so the per packet path never allocates. Past
+ * CLIENT_TABLE_MAX_CLIENTS the longest idle client makes room for a new one.
+ */
+struct client_table {
+	struct client_stats *slots;
+	size_t size; /* always a power of two */
+	size_t used;
+	unsigned long evicted;
+	/* ring of slot indexes with queued echoes, served round robin. Every
+	 * active client holds at least one pool frame, so it can't overflow.
+	 */
+	size_t active[ECHO_POOL_SIZE];
+	size_t active_head;
+	size_t active_count;
+};
+
+/* Node probed by the watchdog mode */
+struct watch_node {
+	struct sockaddr_ieee802154 addr;
+	struct client_key key;
+	char name[24];
+	int timer_fd;
+	unsigned short seq;
+	bool outstanding;
+	struct timespec sent;
+	/* ring of the last results, rtt in us or WATCH_LOST */
+	uint32_t *results;
+	unsigned int next;
+	unsigned int count;
+	bool breached;
+	float loss;
+	float latency;
+};
+
+struct watch_config {
+	unsigned int interval; /* ms between probes of one node */
+	unsigned int window; /* results kept per node */
+	float max_loss; /* percent */
+	unsigned int percentile;
+	float max_latency; /* ms, 0 means unchecked */
+	char *status_file;
+	struct watch_node *nodes;
+	unsigned int n_nodes;
+	uint32_t *scratch;
+};
+
+static volatile sig_atomic_t dump_stats_requested;
+static volatile sig_atomic_t stop_requested;
+
 extern char *optarg;
 
 static void usage(const char *name) {
@@ -100,6 +268,15 @@ static void usage(const char *name) {
 	"--size | -s packet length\n"
 	"--interface | -i listen on this interface (default wpan0)\n"
 	"--interval | -I wait interval in milliseconds between sending packets (default 500ms)\n"
+	"--stats-file | -S server mode: periodically write per client statistics to this file\n"
+	"--stats-interval | -T seconds between statistics file updates (default 10s)\n"
+	"--rate | -r server mode: limit echoes to this many frames per second per client\n"
+	"--burst | -b token bucket depth for --rate in frames (default 5)\n"
+	"--watch | -W continuously probe the nodes listed in this file and report SLO breaches\n"
+	"--duty-cycle | -D throttle sending to this airtime duty cycle in percent\n"
+	"--duty-window | -w duty cycle window in seconds (default 3600s)\n"
+	"--power-model | -P TX current as <mA at 0dBm>:<mA per dBm>[:<volts>] (default 12:0.6:3)\n"
+	"--sizes | -z run once per payload size in this comma separated list and compare energy\n"
 	"--version | -v print out version\n"
 	"--help | -h this usage text\n", name);
 }
@@ -114,14 +291,14 @@ static int nl802154_init(struct config *conf)
 		return -ENOMEM;
 	}
 
-	nl_socket_set_buffer_size(conf->nl_sock, 8192, 8192);
-
 	if (genl_connect(conf->nl_sock)) {
 		fprintf(stderr, "Failed to connect to generic netlink.\n");
 		err = -ENOLINK;
 		goto out_handle_destroy;
 	}
 
+	nlsock_tune(conf->nl_sock, NL_RCVBUF_DEFAULT);
+
 	conf->nl802154_id = genl_ctrl_resolve(conf->nl_sock, "nl802154");
 	if (conf->nl802154_id < 0) {
 		fprintf(stderr, "nl802154 not found.\n");
@@ -154,10 +331,20 @@ static int nl_msg_cb(struct nl_msg* msg, void* arg)
 	nla_parse(attrs, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
 		  genlmsg_attrlen(gnlh, 0), NULL);
 
+	/* the kernel ignores the name filter for dumps */
+	if (attrs[NL802154_ATTR_IFNAME] &&
+	    strcmp(nla_get_string(attrs[NL802154_ATTR_IFNAME]), conf->interface))
+		return NL_SKIP;
+
 	if (!attrs[NL802154_ATTR_SHORT_ADDR] || !attrs[NL802154_ATTR_PAN_ID]
 	    || !attrs[NL802154_ATTR_EXTENDED_ADDR])
 		return NL_SKIP;
 
+	if (attrs[NL802154_ATTR_WPAN_PHY]) {
+		conf->wpan_phy = nla_get_u32(attrs[NL802154_ATTR_WPAN_PHY]);
+		conf->have_phy = true;
+	}
+
 	conf->src.family = AF_IEEE802154;
 	conf->src.addr.pan_id = conf->dst.addr.pan_id = nla_get_u16(attrs[NL802154_ATTR_PAN_ID]);
 
@@ -173,6 +360,32 @@ static int nl_msg_cb(struct nl_msg* msg, void* arg)
 	return NL_SKIP;
 }
 
+static int nl_phy_msg_cb(struct nl_msg* msg, void* arg)
+{
+	struct config *conf = arg;
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nlattr *attrs[NL802154_ATTR_MAX+1];
+
+	struct genlmsghdr *gnlh = (struct genlmsghdr*) nlmsg_data(nlh);
+
+	nla_parse(attrs, NL802154_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if (attrs[NL802154_ATTR_TX_POWER]) {
+		conf->tx_power = nla_get_s32(attrs[NL802154_ATTR_TX_POWER]);
+		conf->have_tx_power = true;
+	}
+
+	if (!attrs[NL802154_ATTR_PAGE] || !attrs[NL802154_ATTR_CHANNEL])
+		return NL_SKIP;
+
+	conf->page = nla_get_u8(attrs[NL802154_ATTR_PAGE]);
+	conf->channel = nla_get_u8(attrs[NL802154_ATTR_CHANNEL]);
+	conf->have_channel = true;
+
+	return NL_SKIP;
+}
+
 static int get_interface_info(struct config *conf) {
 	struct nl_msg *msg;
 
@@ -183,7 +396,18 @@ static int get_interface_info(struct config *conf) {
 	msg = nlmsg_alloc();
 	genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, conf->nl802154_id, 0, NLM_F_DUMP, NL802154_CMD_GET_INTERFACE, 0);
 	nla_put_string(msg, NL802154_ATTR_IFNAME, conf->interface);
-	nl_send_sync(conf->nl_sock, msg);
+	/* libnl reports ENOBUFS as out of memory */
+	if (nl_send_sync(conf->nl_sock, msg) == -NLE_NOMEM)
+		fprintf(stderr, "netlink receive buffer overrun, interface list is incomplete\n");
+
+	/* Page and channel of the phy, needed for airtime accounting */
+	if (conf->have_phy) {
+		nl_socket_modify_cb(conf->nl_sock, NL_CB_VALID, NL_CB_CUSTOM, nl_phy_msg_cb, conf);
+		msg = nlmsg_alloc();
+		genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, conf->nl802154_id, 0, 0, NL802154_CMD_GET_WPAN_PHY, 0);
+		nla_put_u32(msg, NL802154_ATTR_WPAN_PHY, conf->wpan_phy);
+		nl_send_sync(conf->nl_sock, msg);
+	}
 
 	nl802154_cleanup(conf);
 	return 0;
@@ -242,19 +466,230 @@ static void sleeping(struct timeval ping_start_time, struct timeval timeout) {
 	}
 }
 
-static int measure_roundtrip(struct config *conf, int sd) {
+/* PHY data rate for a page/channel, see print_freq_handler in iwpan */
+static unsigned int phy_bitrate(uint8_t page, uint8_t channel)
+{
+	switch (page) {
+	case 0:
+		if (channel == 0)
+			return 20000; /* 868 MHz BPSK */
+		if (channel <= 10)
+			return 40000; /* 915 MHz BPSK */
+		return 250000; /* 2450 MHz O-QPSK */
+	case 1:
+		return 250000; /* 868/915 MHz ASK */
+	case 2:
+		if (channel == 0)
+			return 100000; /* 868 MHz O-QPSK */
+		return 250000; /* 915 MHz O-QPSK */
+	case 3:
+		return 1000000; /* 2450 MHz CSS */
+	case 4:
+		return 850000; /* UWB, nominal rate */
+	case 5:
+		return 250000; /* 780 MHz O-QPSK/MPSK */
+	case 6:
+		if (channel <= 9)
+			return 100000; /* 950 MHz GFSK */
+		return 20000; /* 950 MHz BPSK */
+	default:
+		return 0;
+	}
+}
+
+/* Time on air of one data frame with the given payload */
+static uint64_t frame_airtime_us(struct config *conf, struct airtime *at,
+				 unsigned int payload_len)
+{
+	unsigned int addr_len = conf->extended ? IEEE802154_ADDR_LEN : 2;
+	unsigned int len;
+
+	/* frame control, sequence number, destination PAN ID and both
+	 * addresses (PAN ID compression) plus payload and FCS
+	 */
+	len = PHY_HEADER_LEN + 2 + 1 + 2 + 2 * addr_len + payload_len + FCS_LEN;
+
+	return (uint64_t)len * 8 * 1000000 / at->bitrate;
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Airtime used within the last window */
+static uint64_t airtime_used(struct airtime *at, uint64_t nr)
+{
+	uint64_t used = 0;
+	int i;
+
+	for (i = 0; i < AIRTIME_BUCKETS; i++) {
+		if (at->bucket_nr[i] + AIRTIME_BUCKETS > nr)
+			used += at->bucket_us[i];
+	}
+
+	return used;
+}
+
+static void airtime_add(struct airtime *at, uint64_t us)
+{
+	uint64_t nr = now_ms() / at->bucket_ms;
+	int i = nr % AIRTIME_BUCKETS;
+
+	if (at->bucket_nr[i] != nr) {
+		at->bucket_nr[i] = nr;
+		at->bucket_us[i] = 0;
+	}
+	at->bucket_us[i] += us;
+	at->total_us += us;
+}
+
+/* Sleep until sending another frame stays within the duty cycle */
+static void airtime_throttle(struct config *conf, struct airtime *at,
+			     uint64_t frame_us)
+{
+	uint64_t budget_us = conf->duty_cycle / 100 *
+			     conf->duty_window * 1000000;
+	uint64_t ms, nr;
+
+	if (!conf->duty_cycle || !at->bitrate)
+		return;
+
+	while (1) {
+		ms = now_ms();
+		nr = ms / at->bucket_ms;
+		if (airtime_used(at, nr) + frame_us <= budget_us)
+			break;
+		/* wait for the oldest bucket to leave the window */
+		usleep(((nr + 1) * at->bucket_ms - ms) * 1000);
+	}
+}
+
+static int airtime_init(struct config *conf, struct airtime *at)
+{
+	memset(at, 0, sizeof(*at));
+	at->bucket_ms = conf->duty_window * 1000 / AIRTIME_BUCKETS;
+	if (!at->bucket_ms)
+		at->bucket_ms = 1;
+
+	if (conf->have_channel)
+		at->bitrate = phy_bitrate(conf->page, conf->channel);
+
+	if (!at->bitrate) {
+		if (conf->duty_cycle) {
+			fprintf(stderr, "Duty cycle limit needs a known page/channel.\n");
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	if (conf->duty_cycle &&
+	    frame_airtime_us(conf, at, conf->packet_len) >
+	    conf->duty_cycle / 100 * conf->duty_window * 1000000) {
+		fprintf(stderr, "Duty cycle window too short for a single frame.\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void airtime_report(struct config *conf, struct airtime *at,
+			   struct timeval *start, int count)
+{
+	struct timeval end;
+	double elapsed_us;
+
+	if (!at->bitrate) {
+		fprintf(stdout, "airtime unknown, page/channel not available\n");
+		return;
+	}
+
+	gettimeofday(&end, NULL);
+	elapsed_us = (end.tv_sec - start->tv_sec) * 1e6 +
+		     (end.tv_usec - start->tv_usec);
+
+	fprintf(stdout, "airtime %.3f ms (page %u channel %u, %u kb/s), "
+		"utilization %.3f%%",
+		at->total_us / 1000.0, conf->page, conf->channel,
+		at->bitrate / 1000,
+		elapsed_us > 0 ? 100.0 * at->total_us / elapsed_us : 0.0);
+	if (conf->duty_cycle)
+		fprintf(stdout, " (limit %.3f%% per %us)", conf->duty_cycle,
+			conf->duty_window);
+	fprintf(stdout, "\n");
+	if (at->total_us)
+		fprintf(stdout, "goodput %.1f bytes per second of airtime\n",
+			(double)count * conf->packet_len * 1e6 / at->total_us);
+}
+
+/* Energy spent transmitting one us of airtime, in nJ */
+static double tx_energy_per_us(struct config *conf)
+{
+	double ma;
+
+	ma = conf->pm_base_ma + conf->pm_ma_per_dbm * (conf->tx_power / 100.0);
+	if (ma < 0)
+		ma = 0;
+
+	/* mW * us = nJ */
+	return ma * conf->pm_volts;
+}
+
+/* TX energy per delivered payload byte in uJ, negative if unknown */
+static double energy_per_byte(struct config *conf, struct ping_result *res)
+{
+	if (!conf->have_tx_power || !res->airtime_us || !res->received)
+		return -1;
+
+	return tx_energy_per_us(conf) * res->airtime_us / 1000.0 /
+	       ((double)res->received * res->packet_len);
+}
+
+static void energy_report(struct config *conf, struct ping_result *res)
+{
+	double per_byte = energy_per_byte(conf, res);
+
+	if (!conf->have_tx_power || !res->airtime_us) {
+		fprintf(stdout, "energy unknown, tx_power or airtime not available\n");
+		return;
+	}
+
+	fprintf(stdout, "energy %.2f uJ per frame at %.3g dBm",
+		tx_energy_per_us(conf) * res->airtime_us / 1000.0 / res->sent,
+		conf->tx_power / 100.0);
+	if (per_byte < 0)
+		fprintf(stdout, ", nothing delivered\n");
+	else
+		fprintf(stdout, ", %.3f uJ per delivered byte "
+			"(%.2f transmissions per delivered frame)\n", per_byte,
+			(double)res->sent / res->received);
+}
+
+static int measure_roundtrip(struct config *conf, int sd,
+			     struct ping_result *res) {
 	unsigned char *buf;
 	struct timeval ping_start_time, start_time, end_time, timeout;
 	long sec = 0, usec = 0;
 	long sec_max = 0, usec_max = 0;
 	long sec_min = 2147483647, usec_min = 2147483647;
 	long sum_sec = 0, sum_usec = 0;
-	int i, ret, count;
+	int i, ret, count, sent = 0;
 	unsigned short seq_num;
 	float rtt_min = 0.0, rtt_avg = 0.0, rtt_max = 0.0;
 	float packet_loss = 100.0;
+	struct timeval test_start_time;
+	struct airtime at;
+	uint64_t frame_us = 0;
 	char addr[24];
 
+	if (airtime_init(conf, &at))
+		return -EINVAL;
+	if (at.bitrate)
+		frame_us = frame_airtime_us(conf, &at, conf->packet_len);
+
 	if (conf->extended)
 		print_address(addr, conf->dst.addr.hwaddr);
 
@@ -281,13 +716,19 @@ static int measure_roundtrip(struct config *conf, int sd) {
 	}
 
 	count = 0;
+	gettimeofday(&test_start_time, NULL);
 	for (i = 0; i < conf->packets; i++) {
+		airtime_throttle(conf, &at, frame_us);
 		gettimeofday(&ping_start_time, NULL);
 		generate_packet(buf, conf, i);
 		seq_num = (buf[2] << 8)| buf[3];
 		ret = sendto(sd, buf, conf->packet_len, 0, (struct sockaddr *)&conf->dst, sizeof(conf->dst));
 		if (ret < 0) {
 			perror("sendto");
+		} else {
+			sent++;
+			if (at.bitrate)
+				airtime_add(&at, frame_us);
 		}
 		gettimeofday(&start_time, NULL);
 		ret = recv(sd, buf, conf->packet_len, 0);
@@ -352,89 +793,615 @@ static int measure_roundtrip(struct config *conf, int sd) {
 	fprintf(stdout, "%i packets transmitted, %i received, %.0f%% packet loss\n",
 		conf->packets, count, packet_loss);
 	fprintf(stdout, "rtt min/avg/max = %.3f/%.3f/%.3f ms\n", rtt_min, rtt_avg, rtt_max);
+	airtime_report(conf, &at, &test_start_time, count);
+
+	res->packet_len = conf->packet_len;
+	res->sent = sent;
+	res->received = count;
+	res->airtime_us = at.total_us;
+	energy_report(conf, res);
 
 	free(buf);
 	return 0;
 }
 
-static void init_server(int sd) {
-	ssize_t len;
-	unsigned char *buf;
-	struct sockaddr_ieee802154 src;
-	socklen_t addrlen;
+/* Run the client once per payload size and compare the energy cost of
+ * delivering a byte, to find the cheapest size for battery powered nodes.
+ */
+static int measure_sizes(struct config *conf, int sd)
+{
+	struct ping_result *res;
+	char *list, *tok, *save;
+	int i, n = 0, best = -1;
+	double e, best_e = 0;
+
+	list = strdup(conf->sizes);
+	res = calloc(MAX_PAYLOAD_LEN, sizeof(*res));
+	if (!list || !res) {
+		free(list);
+		free(res);
+		return -ENOMEM;
+	}
 
-	addrlen = sizeof(src);
+	for (tok = strtok_r(list, ",", &save); tok && n < MAX_PAYLOAD_LEN;
+	     tok = strtok_r(NULL, ",", &save)) {
+		i = atoi(tok);
+		if (i >= MAX_PAYLOAD_LEN || i < MIN_PAYLOAD_LEN) {
+			fprintf(stderr, "Skipping invalid packet size %s\n", tok);
+			continue;
+		}
+		conf->packet_len = i;
+		measure_roundtrip(conf, sd, &res[n++]);
+		fprintf(stdout, "\n");
+	}
 
-	len = 0;
-	fprintf(stdout, "Server mode. Waiting for packets...\n");
-	buf = (unsigned char *)malloc(MAX_PAYLOAD_LEN);
+	fprintf(stdout, "--- energy per payload size ---\n");
+	fprintf(stdout, "size   sent   recv  tx/frame  uJ/byte\n");
+	for (i = 0; i < n; i++) {
+		e = energy_per_byte(conf, &res[i]);
+		fprintf(stdout, "%4d %6d %6d %9.2f ", res[i].packet_len,
+			res[i].sent, res[i].received, res[i].received ?
+			(double)res[i].sent / res[i].received : 0.0);
+		if (e < 0) {
+			fprintf(stdout, "%8s\n", "-");
+			continue;
+		}
+		fprintf(stdout, "%8.3f\n", e);
+		if (best < 0 || e < best_e) {
+			best = i;
+			best_e = e;
+		}
+	}
+	if (best >= 0)
+		fprintf(stdout, "cheapest delivery with %d byte payload\n",
+			res[best].packet_len);
 
-	while (1) {
-		len = recvfrom(sd, buf, MAX_PAYLOAD_LEN, 0, (struct sockaddr *)&src, &addrlen);
-		if (len < 0) {
-			perror("recvfrom");
+	free(res);
+	free(list);
+	return 0;
+}
+
+static uint32_t client_key_hash(const struct client_key *key)
+{
+	const uint8_t *p = (const uint8_t *)key;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < sizeof(*key); i++) {
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void client_key_from_addr(struct client_key *key,
+				 const struct sockaddr_ieee802154 *src)
+{
+	memset(key, 0, sizeof(*key));
+	key->pan_id = src->addr.pan_id;
+	key->addr_type = src->addr.addr_type;
+	if (src->addr.addr_type == IEEE802154_ADDR_LONG)
+		memcpy(key->addr, src->addr.hwaddr, IEEE802154_ADDR_LEN);
+	else
+		memcpy(key->addr, &src->addr.short_addr, sizeof(uint16_t));
+}
+
+static struct client_stats *client_table_slot(struct client_stats *slots,
+					      size_t size,
+					      const struct client_key *key)
+{
+	size_t i = client_key_hash(key) & (size - 1);
+
+	while (slots[i].used && memcmp(&slots[i].key, key, sizeof(*key)))
+		i = (i + 1) & (size - 1);
+
+	return &slots[i];
+}
+
+static int client_table_init(struct client_table *table)
+{
+	table->size = CLIENT_TABLE_MIN_SIZE;
+	table->used = 0;
+	table->evicted = 0;
+	table->active_head = 0;
+	table->active_count = 0;
+	table->slots = calloc(table->size, sizeof(*table->slots));
+	if (!table->slots)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int client_table_grow(struct client_table *table)
+{
+	struct client_stats *slots;
+	size_t size = table->size * 2;
+	size_t i;
+
+	slots = calloc(size, sizeof(*slots));
+	if (!slots)
+		return -ENOMEM;
+
+	for (i = 0; i < table->size; i++) {
+		if (table->slots[i].used)
+			*client_table_slot(slots, size, &table->slots[i].key) =
+				table->slots[i];
+	}
+
+	/* slot indexes changed, remap the round robin ring */
+	for (i = 0; i < table->active_count; i++) {
+		size_t *idx = &table->active[(table->active_head + i) % ECHO_POOL_SIZE];
+
+		*idx = client_table_slot(slots, size, &table->slots[*idx].key) - slots;
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->size = size;
+	return 0;
+}
+
+/* A client with queued echoes moved from slot from to slot to */
+static void client_table_move_active(struct client_table *table, size_t from,
+				     size_t to)
+{
+	size_t i, *idx;
+
+	for (i = 0; i < table->active_count; i++) {
+		idx = &table->active[(table->active_head + i) % ECHO_POOL_SIZE];
+		if (*idx == from) {
+			*idx = to;
+			return;
+		}
+	}
+}
+
+/* Backward shift deletion, no tombstones so probe lengths stay short */
+static void client_table_remove(struct client_table *table, size_t i)
+{
+	size_t mask = table->size - 1;
+	size_t j = i, home;
+
+	table->slots[i].used = false;
+	table->used--;
+
+	for (;;) {
+		j = (j + 1) & mask;
+		if (!table->slots[j].used)
+			break;
+
+		/* stays if its home slot is cyclically within (i, j] */
+		home = client_key_hash(&table->slots[j].key) & mask;
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+
+		table->slots[i] = table->slots[j];
+		table->slots[j].used = false;
+		if (table->slots[i].queued)
+			client_table_move_active(table, j, i);
+		i = j;
+	}
+}
+
+/* Drop the client seen longest ago without queued echoes. Its statistics
+ * are lost, only the number of evicted clients is kept.
+ */
+static int client_table_evict(struct client_table *table)
+{
+	struct client_stats *client, *oldest = NULL;
+	size_t i;
+
+	for (i = 0; i < table->size; i++) {
+		client = &table->slots[i];
+		if (!client->used || client->queued)
+			continue;
+		if (!oldest || timercmp(&client->last_seen, &oldest->last_seen, <))
+			oldest = client;
+	}
+
+	if (!oldest)
+		return -ENOSPC;
+
+	client_table_remove(table, oldest - table->slots);
+	table->evicted++;
+	return 0;
+}
+
+static struct client_stats *client_table_lookup(struct client_table *table,
+						const struct client_key *key)
+{
+	struct client_stats *client;
+
+	client = client_table_slot(table->slots, table->size, key);
+	if (client->used)
+		return client;
+
+	if (table->used >= CLIENT_TABLE_MAX_CLIENTS) {
+		if (client_table_evict(table))
+			return NULL;
+		/* entries may have shifted into the free slot */
+		client = client_table_slot(table->slots, table->size, key);
+	}
+
+	/* keep the load factor below 3/4 to bound probe lengths */
+	if ((table->used + 1) * 4 > table->size * 3) {
+		if (client_table_grow(table))
+			return NULL;
+		client = client_table_slot(table->slots, table->size, key);
+	}
+
+	memset(client, 0, sizeof(*client));
+	client->key = *key;
+	client->used = true;
+	table->used++;
+	return client;
+}
+
+static void client_update_seq(struct client_stats *client, unsigned char *buf,
+			      ssize_t len)
+{
+	unsigned short seq_num, diff;
+
+	if (len < 4)
+		return;
+
+	seq_num = (buf[2] << 8) | buf[3];
+	if (client->have_seq) {
+		diff = seq_num - (unsigned short)(client->last_seq + 1);
+		/* Anything going backwards is a reordered/duplicated frame or
+		 * a restarted client, don't account it as a gap.
+		 */
+		if (diff >= 0x8000)
+			return;
+		client->seq_gaps += diff;
+	}
+
+	client->last_seq = seq_num;
+	client->have_seq = true;
+}
+
+static void print_client_addr(FILE *f, const struct client_key *key)
+{
+	char addr[24];
+	uint16_t short_addr;
+
+	if (key->addr_type == IEEE802154_ADDR_LONG) {
+		print_address(addr, (uint8_t *)key->addr);
+		fprintf(f, "%s", addr);
+	} else {
+		memcpy(&short_addr, key->addr, sizeof(short_addr));
+		fprintf(f, "0x%04x", short_addr);
+	}
+}
+
+static void dump_client_table(FILE *f, struct client_table *table)
+{
+	struct client_stats *client;
+	struct timeval now;
+	long ago_ms;
+	size_t i;
+
+	gettimeofday(&now, NULL);
+
+	fprintf(f, "--- server statistics: %zu clients", table->used);
+	if (table->evicted)
+		fprintf(f, ", %lu idle evicted", table->evicted);
+	fprintf(f, " ---\n");
+	for (i = 0; i < table->size; i++) {
+		client = &table->slots[i];
+		if (!client->used)
 			continue;
+
+		ago_ms = (now.tv_sec - client->last_seen.tv_sec) * 1000 +
+			 (now.tv_usec - client->last_seen.tv_usec) / 1000;
+
+		print_client_addr(f, &client->key);
+		fprintf(f, " (PAN ID 0x%04x) received=%lu echoed=%lu "
+			"send_failures=%lu seq_gaps=%lu dropped=%lu "
+			"last_seen=%ld.%03lds ago\n",
+			client->key.pan_id, client->received, client->echoed,
+			client->send_failures, client->seq_gaps, client->dropped,
+			ago_ms / 1000, ago_ms % 1000);
+	}
+	fflush(f);
+}
+
+static void write_stats_file(const char *path, struct client_table *table)
+{
+	char tmp[PATH_MAX];
+	FILE *f;
+
+	/* write aside and rename, readers never see a partial file */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (!f) {
+		perror("stats file");
+		return;
+	}
+	dump_client_table(f, table);
+	fclose(f);
+
+	if (rename(tmp, path) < 0)
+		perror("stats file rename");
+}
+
+static void stats_signal_handler(int signo)
+{
+	if (signo == SIGUSR1)
+		dump_stats_requested = 1;
+	else
+		stop_requested = 1;
+}
+
+static bool client_take_token(struct config *conf, struct client_stats *client)
+{
+	struct timespec now;
+	double elapsed;
+
+	if (!conf->rate)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (client->last_refill.tv_sec || client->last_refill.tv_nsec) {
+		elapsed = (now.tv_sec - client->last_refill.tv_sec) +
+			  (now.tv_nsec - client->last_refill.tv_nsec) / 1e9;
+		client->tokens += elapsed * conf->rate;
+		if (client->tokens > conf->burst)
+			client->tokens = conf->burst;
+	} else {
+		/* new clients start with a full bucket */
+		client->tokens = conf->burst;
+	}
+	client->last_refill = now;
+
+	if (client->tokens < 1.0)
+		return false;
+
+	client->tokens -= 1.0;
+	return true;
+}
+
+static void echo_pool_init(struct echo_pool *pool)
+{
+	int i;
+
+	pool->free = NULL;
+	for (i = ECHO_POOL_SIZE - 1; i >= 0; i--) {
+		pool->frames[i].next = pool->free;
+		pool->free = &pool->frames[i];
+	}
+}
+
+static void echo_pool_put(struct echo_pool *pool, struct echo_frame *frame)
+{
+	frame->next = pool->free;
+	pool->free = frame;
+}
+
+static void client_enqueue(struct client_table *table,
+			   struct client_stats *client,
+			   struct echo_frame *frame)
+{
+	frame->next = NULL;
+	if (client->queue_tail)
+		client->queue_tail->next = frame;
+	else
+		client->queue_head = frame;
+	client->queue_tail = frame;
+
+	if (client->queued++ == 0) {
+		table->active[(table->active_head + table->active_count) %
+			      ECHO_POOL_SIZE] = client - table->slots;
+		table->active_count++;
+	}
+}
+
+static struct echo_frame *client_dequeue(struct client_stats *client)
+{
+	struct echo_frame *frame = client->queue_head;
+
+	client->queue_head = frame->next;
+	if (!client->queue_head)
+		client->queue_tail = NULL;
+	client->queued--;
+	return frame;
+}
+
+/* Drain the socket into the per client queues, until it would block or the
+ * frame pool is exhausted.
+ */
+static void server_receive(struct config *conf, int sd,
+			   struct client_table *table, struct echo_pool *pool)
+{
+	struct echo_frame *frame;
+	struct client_stats *client;
+	struct client_key key;
+	ssize_t len;
+
+	while ((frame = pool->free)) {
+		frame->addrlen = sizeof(frame->src);
+		len = recvfrom(sd, frame->buf, MAX_PAYLOAD_LEN, MSG_DONTWAIT,
+			       (struct sockaddr *)&frame->src, &frame->addrlen);
+		if (len < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR)
+				perror("recvfrom");
+			return;
 		}
+		pool->free = frame->next;
+		frame->len = len;
 #if DEBUG
-		dump_packet(buf, len);
+		dump_packet(frame->buf, len);
 #endif
-		if (buf[0] == NOT_A_6LOWPAN_FRAME) {
+		client_key_from_addr(&key, &frame->src);
+		client = client_table_lookup(table, &key);
+		if (!client) {
+			/* no room for a new client, echo without state */
+			if (frame->buf[0] == NOT_A_6LOWPAN_FRAME &&
+			    sendto(sd, frame->buf, len, 0,
+				   (struct sockaddr *)&frame->src,
+				   frame->addrlen) < 0)
+				perror("sendto");
+			echo_pool_put(pool, frame);
+			continue;
+		}
+
+		client->received++;
+		gettimeofday(&client->last_seen, NULL);
+
+		if (frame->buf[0] != NOT_A_6LOWPAN_FRAME) {
+			echo_pool_put(pool, frame);
+			continue;
+		}
+
+		client_update_seq(client, frame->buf, len);
+
+		if (client->queued >= ECHO_QUEUE_LIMIT ||
+		    !client_take_token(conf, client)) {
+			client->dropped++;
+			echo_pool_put(pool, frame);
+			continue;
+		}
+
+		client_enqueue(table, client, frame);
+	}
+}
+
+/* One deficit round robin pass over all clients with queued echoes */
+static void server_echo_round(int sd, struct client_table *table,
+			      struct echo_pool *pool)
+{
+	struct client_stats *client;
+	struct echo_frame *frame;
+	size_t n = table->active_count;
+	size_t idx;
+
+	while (n--) {
+		idx = table->active[table->active_head];
+		table->active_head = (table->active_head + 1) % ECHO_POOL_SIZE;
+		table->active_count--;
+
+		client = &table->slots[idx];
+		client->deficit += ECHO_QUANTUM;
+		while (client->queue_head &&
+		       client->queue_head->len <= client->deficit) {
+			frame = client_dequeue(client);
+			client->deficit -= frame->len;
+
 			/* Send same packet back */
-			len = sendto(sd, buf, len, 0, (struct sockaddr *)&src, addrlen);
-			if (len < 0) {
+			if (sendto(sd, frame->buf, frame->len, 0,
+				   (struct sockaddr *)&frame->src,
+				   frame->addrlen) < 0) {
 				perror("sendto");
-				continue;
+				client->send_failures++;
+			} else {
+				client->echoed++;
 			}
+			echo_pool_put(pool, frame);
+		}
+
+		if (client->queue_head) {
+			table->active[(table->active_head + table->active_count) %
+				      ECHO_POOL_SIZE] = idx;
+			table->active_count++;
+		} else {
+			client->deficit = 0;
 		}
 	}
-	free(buf);
 }
 
-static int init_network(struct config *conf) {
-	int sd;
+static void init_server(struct config *conf, int sd) {
+	struct client_table table;
+	struct echo_pool *pool;
+	struct sigaction sa;
+	struct pollfd pfd;
+	struct timeval now, last_write;
+	int timeout = -1;
 	int ret;
 
-	sd = socket(PF_IEEE802154, SOCK_DGRAM, 0);
-	if (sd < 0) {
-		perror("socket");
-		return 1;
+	fprintf(stdout, "Server mode. Waiting for packets...\n");
+
+	pool = malloc(sizeof(*pool));
+	if (!pool) {
+		fprintf(stderr, "Failed to allocate frame pool.\n");
+		return;
 	}
+	echo_pool_init(pool);
 
-	/* Bind socket on this side */
-	ret = bind(sd, (struct sockaddr *)&conf->src, sizeof(conf->src));
-	if (ret) {
-		perror("bind");
-		close(sd);
-		return 1;
+	if (client_table_init(&table)) {
+		fprintf(stderr, "Failed to allocate client table.\n");
+		free(pool);
+		return;
 	}
 
-	if (conf->server)
-		init_server(sd);
-	else
-		measure_roundtrip(conf, sd);
+	/* no SA_RESTART, we want poll() to return on signals */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stats_signal_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (conf->stats_file)
+		timeout = conf->stats_interval * 1000;
+
+	pfd.fd = sd;
+	pfd.events = POLLIN;
+	gettimeofday(&last_write, NULL);
+
+	while (!stop_requested) {
+		if (dump_stats_requested) {
+			dump_stats_requested = 0;
+			dump_client_table(stdout, &table);
+		}
 
-	shutdown(sd, SHUT_RDWR);
-	close(sd);
-	return 0;
+		if (conf->stats_file) {
+			gettimeofday(&now, NULL);
+			if (now.tv_sec - last_write.tv_sec >= conf->stats_interval) {
+				write_stats_file(conf->stats_file, &table);
+				last_write = now;
+			}
+		}
+
+		/* don't block while echoes are pending */
+		ret = poll(&pfd, 1, table.active_count ? 0 : timeout);
+		if (ret < 0) {
+			if (errno != EINTR)
+				perror("poll");
+			continue;
+		}
+		if (ret > 0)
+			server_receive(conf, sd, &table, pool);
+
+		server_echo_round(sd, &table, pool);
+	}
+
+	dump_client_table(stdout, &table);
+	if (conf->stats_file)
+		write_stats_file(conf->stats_file, &table);
+
+	free(table.slots);
+	free(pool);
 }
 
-static int parse_dst_addr(struct config *conf, char *arg)
+static int parse_addr(struct sockaddr_ieee802154 *sa, bool extended, char *arg)
 {
 	int i;
 
 	if (!arg)
 		return -1;
 
-	/* PAN ID is filled from netlink in get_interface_info */
-	conf->dst.family = AF_IEEE802154;
+	sa->family = AF_IEEE802154;
 
-	if (!conf->extended) {
-		conf->dst.addr.addr_type = IEEE802154_ADDR_SHORT;
-		conf->dst.addr.short_addr = strtol(arg, NULL, 16);
+	if (!extended) {
+		sa->addr.addr_type = IEEE802154_ADDR_SHORT;
+		sa->addr.short_addr = strtol(arg, NULL, 16);
 		return 0;
 	}
 
-	conf->dst.addr.addr_type = IEEE802154_ADDR_LONG;
+	sa->addr.addr_type = IEEE802154_ADDR_LONG;
 
 	for (i = 0; i < IEEE802154_ADDR_LEN; i++) {
 		int temp;
@@ -448,7 +1415,7 @@ static int parse_dst_addr(struct config *conf, char *arg)
 		if (temp < 0 || temp > 255)
 			return -1;
 
-		conf->dst.addr.hwaddr[i] = temp;
+		sa->addr.hwaddr[i] = temp;
 		if (!cp)
 			break;
 		arg = cp;
@@ -459,10 +1426,437 @@ static int parse_dst_addr(struct config *conf, char *arg)
 	return 0;
 }
 
+static int watch_add_node(struct config *conf, struct watch_config *wc,
+			  char *arg)
+{
+	struct watch_node *nodes, *node;
+	bool extended = strchr(arg, ':') != NULL;
+
+	nodes = realloc(wc->nodes, (wc->n_nodes + 1) * sizeof(*nodes));
+	if (!nodes)
+		return -ENOMEM;
+	wc->nodes = nodes;
+
+	node = &nodes[wc->n_nodes];
+	memset(node, 0, sizeof(*node));
+	node->timer_fd = -1;
+	snprintf(node->name, sizeof(node->name), "%s", arg);
+	if (parse_addr(&node->addr, extended, arg))
+		return -EINVAL;
+	node->addr.addr.pan_id = conf->src.addr.pan_id;
+	client_key_from_addr(&node->key, &node->addr);
+
+	wc->n_nodes++;
+	return 0;
+}
+
+/*
+ * Watch file format, one directive per line, '#' starts a comment:
+ *
+ *	interval <ms>			probe interval per node
+ *	window <results>		rolling window kept per node
+ *	slo loss <percent>		maximum loss within the window
+ *	slo latency <pctl> <ms>		maximum latency percentile
+ *	status-file <path>		current state of all nodes
+ *	node <short or extended address>
+ */
+static int parse_watch_file(struct config *conf, struct watch_config *wc)
+{
+	char line[256], *cmd, *arg, *arg2, *save;
+	int lineno = 0, ret = 0;
+	FILE *f;
+
+	f = fopen(conf->watch_file, "r");
+	if (!f) {
+		perror(conf->watch_file);
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if ((cmd = strchr(line, '#')))
+			*cmd = '\0';
+
+		cmd = strtok_r(line, " \t\r\n", &save);
+		if (!cmd)
+			continue;
+		arg = strtok_r(NULL, " \t\r\n", &save);
+		arg2 = strtok_r(NULL, " \t\r\n", &save);
+
+		if (!arg) {
+			ret = -EINVAL;
+		} else if (strcmp(cmd, "interval") == 0) {
+			wc->interval = atoi(arg);
+			if (wc->interval < 1)
+				ret = -EINVAL;
+		} else if (strcmp(cmd, "window") == 0) {
+			wc->window = atoi(arg);
+			if (wc->window < 1)
+				ret = -EINVAL;
+		} else if (strcmp(cmd, "status-file") == 0) {
+			wc->status_file = strdup(arg);
+		} else if (strcmp(cmd, "node") == 0) {
+			ret = watch_add_node(conf, wc, arg);
+		} else if (strcmp(cmd, "slo") == 0 && arg2 &&
+			   strcmp(arg, "loss") == 0) {
+			wc->max_loss = strtof(arg2, NULL);
+		} else if (strcmp(cmd, "slo") == 0 && arg2 &&
+			   strcmp(arg, "latency") == 0) {
+			arg = strtok_r(NULL, " \t\r\n", &save);
+			wc->percentile = atoi(arg2);
+			if (!arg || wc->percentile < 1 || wc->percentile > 100)
+				ret = -EINVAL;
+			else
+				wc->max_latency = strtof(arg, NULL);
+		} else {
+			ret = -EINVAL;
+		}
+
+		if (ret) {
+			fprintf(stderr, "%s:%d: invalid line\n",
+				conf->watch_file, lineno);
+			break;
+		}
+	}
+
+	fclose(f);
+
+	if (!ret && !wc->n_nodes) {
+		fprintf(stderr, "%s: no nodes to watch\n", conf->watch_file);
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Recompute loss and latency percentile over the window of a node */
+static void watch_evaluate(struct watch_config *wc, struct watch_node *node)
+{
+	unsigned int i, lost = 0, n = 0;
+
+	for (i = 0; i < node->count; i++) {
+		if (node->results[i] == WATCH_LOST)
+			lost++;
+		else
+			wc->scratch[n++] = node->results[i];
+	}
+
+	node->loss = 100.0 * lost / node->count;
+	node->latency = -1;
+	if (n) {
+		qsort(wc->scratch, n, sizeof(*wc->scratch), cmp_u32);
+		/* nearest rank */
+		i = (wc->percentile * n + 99) / 100;
+		node->latency = wc->scratch[i ? i - 1 : 0] / 1000.0;
+	}
+}
+
+/* the latency percentile, "-" when nothing came back */
+static const char *watch_latency(const struct watch_node *node, char *buf,
+				 size_t len)
+{
+	if (node->latency < 0)
+		return "-";
+	snprintf(buf, len, "%.1fms", node->latency);
+	return buf;
+}
+
+static void watch_write_status(struct watch_config *wc)
+{
+	struct watch_node *node;
+	char tmp[PATH_MAX];
+	char latency[32];
+	unsigned int i;
+	FILE *f;
+
+	if (!wc->status_file)
+		return;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", wc->status_file);
+	f = fopen(tmp, "w");
+	if (!f) {
+		perror("status file");
+		return;
+	}
+
+	for (i = 0; i < wc->n_nodes; i++) {
+		node = &wc->nodes[i];
+		fprintf(f, "%s %s loss=%.1f%% p%u=%s\n", node->name,
+			node->breached ? "breach" : "ok", node->loss,
+			wc->percentile, watch_latency(node, latency,
+						      sizeof(latency)));
+	}
+	fclose(f);
+
+	if (rename(tmp, wc->status_file) < 0)
+		perror("status file rename");
+}
+
+static void watch_record(struct watch_config *wc, struct watch_node *node,
+			 uint32_t result)
+{
+	struct timeval now;
+	char latency[32];
+	bool breached;
+
+	node->results[node->next] = result;
+	node->next = (node->next + 1) % wc->window;
+	if (node->count < wc->window)
+		node->count++;
+
+	if (node->count < WATCH_MIN_SAMPLES && node->count < wc->window)
+		return;
+
+	watch_evaluate(wc, node);
+
+	breached = node->loss > wc->max_loss ||
+		   (wc->max_latency && node->latency > wc->max_latency);
+	if (breached == node->breached)
+		return;
+
+	node->breached = breached;
+	gettimeofday(&now, NULL);
+	fprintf(stdout, "%ld.%03ld %s %s loss=%.1f%% p%u=%s\n",
+		(long)now.tv_sec, (long)now.tv_usec / 1000, node->name,
+		breached ? "SLO breach" : "recovered", node->loss,
+		wc->percentile, watch_latency(node, latency, sizeof(latency)));
+	fflush(stdout);
+	watch_write_status(wc);
+}
+
+static void watch_dump(struct watch_config *wc)
+{
+	struct watch_node *node;
+	char latency[32];
+	unsigned int i;
+
+	fprintf(stdout, "--- watch statistics: %u nodes ---\n", wc->n_nodes);
+	for (i = 0; i < wc->n_nodes; i++) {
+		node = &wc->nodes[i];
+		if (node->count)
+			watch_evaluate(wc, node);
+		fprintf(stdout, "%s %s samples=%u loss=%.1f%% p%u=%s\n",
+			node->name, node->breached ? "breach" : "ok",
+			node->count, node->loss, wc->percentile,
+			watch_latency(node, latency, sizeof(latency)));
+	}
+	fflush(stdout);
+}
+
+static void watch_probe(struct config *conf, struct watch_config *wc, int sd,
+			struct watch_node *node)
+{
+	unsigned char buf[MAX_PAYLOAD_LEN];
+	uint64_t expirations;
+
+	if (read(node->timer_fd, &expirations, sizeof(expirations)) < 0)
+		return;
+
+	/* no answer within a whole interval */
+	if (node->outstanding)
+		watch_record(wc, node, WATCH_LOST);
+
+	node->seq++;
+	generate_packet(buf, conf, node->seq);
+	clock_gettime(CLOCK_MONOTONIC, &node->sent);
+	node->outstanding = true;
+	if (sendto(sd, buf, conf->packet_len, 0, (struct sockaddr *)&node->addr,
+		   sizeof(node->addr)) < 0) {
+		node->outstanding = false;
+		watch_record(wc, node, WATCH_LOST);
+	}
+}
+
+static void watch_reply(struct watch_config *wc, int sd)
+{
+	unsigned char buf[MAX_PAYLOAD_LEN];
+	struct sockaddr_ieee802154 src;
+	struct watch_node *node = NULL;
+	struct client_key key;
+	struct timespec now;
+	socklen_t addrlen = sizeof(src);
+	unsigned int i;
+	ssize_t len;
+
+	len = recvfrom(sd, buf, sizeof(buf), MSG_DONTWAIT,
+		       (struct sockaddr *)&src, &addrlen);
+	if (len < 4 || buf[0] != NOT_A_6LOWPAN_FRAME)
+		return;
+
+	client_key_from_addr(&key, &src);
+	for (i = 0; i < wc->n_nodes; i++) {
+		if (!memcmp(&wc->nodes[i].key, &key, sizeof(key))) {
+			node = &wc->nodes[i];
+			break;
+		}
+	}
+
+	/* late replies of already lost probes are ignored */
+	if (!node || !node->outstanding ||
+	    node->seq != ((buf[2] << 8) | buf[3]))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	node->outstanding = false;
+	watch_record(wc, node,
+		     (now.tv_sec - node->sent.tv_sec) * 1000000 +
+		     (now.tv_nsec - node->sent.tv_nsec) / 1000);
+}
+
+static int init_watch(struct config *conf, int sd)
+{
+	struct watch_config wc = {
+		.interval = DEFAULT_WATCH_INTERVAL,
+		.window = DEFAULT_WATCH_WINDOW,
+		.percentile = DEFAULT_WATCH_PERCENTILE,
+		.max_loss = 100,
+	};
+	struct epoll_event ev, events[16];
+	struct itimerspec its;
+	struct sigaction sa;
+	struct watch_node *node;
+	unsigned long first;
+	unsigned int i;
+	int epfd, n, ret;
+
+	ret = parse_watch_file(conf, &wc);
+	if (ret)
+		goto out;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		perror("epoll_create1");
+		ret = -errno;
+		goto out;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, sd, &ev);
+
+	wc.scratch = calloc(wc.window, sizeof(*wc.scratch));
+	if (!wc.scratch) {
+		ret = -ENOMEM;
+		goto out_close;
+	}
+
+	for (i = 0; i < wc.n_nodes; i++) {
+		node = &wc.nodes[i];
+		node->results = calloc(wc.window, sizeof(*node->results));
+		node->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		if (!node->results || node->timer_fd < 0) {
+			perror("watch node");
+			ret = -ENOMEM;
+			goto out_close;
+		}
+
+		/* spread the probes of all nodes over one interval */
+		first = 1 + (unsigned long)wc.interval * i / wc.n_nodes;
+		its.it_value.tv_sec = first / 1000;
+		its.it_value.tv_nsec = (first % 1000) * 1000000;
+		its.it_interval.tv_sec = wc.interval / 1000;
+		its.it_interval.tv_nsec = (wc.interval % 1000) * 1000000;
+		timerfd_settime(node->timer_fd, 0, &its, NULL);
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = node;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, node->timer_fd, &ev);
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stats_signal_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	fprintf(stdout, "Watching %u nodes, probe interval %u ms, window %u\n",
+		wc.n_nodes, wc.interval, wc.window);
+	watch_write_status(&wc);
+
+	while (!stop_requested) {
+		if (dump_stats_requested) {
+			dump_stats_requested = 0;
+			watch_dump(&wc);
+		}
+
+		n = epoll_wait(epfd, events, 16, -1);
+		for (i = 0; n > 0 && i < (unsigned int)n; i++) {
+			if (events[i].data.ptr)
+				watch_probe(conf, &wc, sd, events[i].data.ptr);
+			else
+				watch_reply(&wc, sd);
+		}
+	}
+
+	watch_dump(&wc);
+
+out_close:
+	close(epfd);
+out:
+	for (i = 0; i < wc.n_nodes; i++) {
+		if (wc.nodes[i].timer_fd >= 0)
+			close(wc.nodes[i].timer_fd);
+		free(wc.nodes[i].results);
+	}
+	free(wc.nodes);
+	free(wc.scratch);
+	free(wc.status_file);
+	return ret;
+}
+
+static int init_network(struct config *conf) {
+	struct ping_result res;
+	int sd;
+	int ret;
+
+	sd = socket(PF_IEEE802154, SOCK_DGRAM, 0);
+	if (sd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	/* Bind socket on this side */
+	ret = bind(sd, (struct sockaddr *)&conf->src, sizeof(conf->src));
+	if (ret) {
+		perror("bind");
+		close(sd);
+		return 1;
+	}
+
+	if (conf->server)
+		init_server(conf, sd);
+	else if (conf->watch_file)
+		ret = init_watch(conf, sd);
+	else if (conf->sizes)
+		measure_sizes(conf, sd);
+	else
+		measure_roundtrip(conf, sd, &res);
+
+	shutdown(sd, SHUT_RDWR);
+	close(sd);
+	return ret ? 1 : 0;
+}
+
+static int parse_dst_addr(struct config *conf, char *arg)
+{
+	/* PAN ID is filled from netlink in get_interface_info */
+	return parse_addr(&conf->dst, conf->extended, arg);
+}
+
 int main(int argc, char *argv[]) {
 	int c, ret;
 	struct config *conf;
 	char *dst_addr = NULL;
+	unsigned long val;
+	char *end;
 
 	conf = calloc(1, sizeof(struct config));
 
@@ -484,6 +1878,22 @@ int main(int argc, char *argv[]) {
 	/* Default to 500ms for interval value */
 	conf->interval = DEFAULT_INTERVAL;
 
+	/* Default to 10s between statistics file updates */
+	conf->stats_interval = DEFAULT_STATS_INTERVAL;
+
+	/* Default to no per client rate limit */
+	conf->rate = 0;
+	conf->burst = DEFAULT_BURST;
+
+	/* Default to no duty cycle limit, accounted per hour */
+	conf->duty_cycle = 0;
+	conf->duty_window = DEFAULT_DUTY_WINDOW;
+
+	/* Default radio power model for energy estimates */
+	conf->pm_base_ma = DEFAULT_PM_BASE_MA;
+	conf->pm_ma_per_dbm = DEFAULT_PM_MA_PER_DBM;
+	conf->pm_volts = DEFAULT_PM_VOLTS;
+
 	if (argc < 2) {
 		usage(argv[0]);
 		exit(1);
@@ -492,9 +1902,9 @@ int main(int argc, char *argv[]) {
 	while (1) {
 #ifdef _GNU_SOURCE
 		int opt_idx = -1;
-		c = getopt_long(argc, argv, "a:ec:s:i:dvhI:", perf_long_opts, &opt_idx);
+		c = getopt_long(argc, argv, "a:ec:s:i:dvhI:S:T:r:b:W:D:w:P:z:", perf_long_opts, &opt_idx);
 #else
-		c = getopt(argc, argv, "a:ec:s:i:dvhI:");
+		c = getopt(argc, argv, "a:ec:s:i:dvhI:S:T:r:b:W:D:w:P:z:");
 #endif
 		if (c == -1)
 			break;
@@ -526,6 +1936,67 @@ int main(int argc, char *argv[]) {
 		case 'I':
 			conf->interval = atoi(optarg);
 			break;
+		case 'S':
+			conf->stats_file = optarg;
+			break;
+		case 'T':
+			errno = 0;
+			val = strtoul(optarg, &end, 10);
+			if (errno || end == optarg || *end || optarg[0] == '-' ||
+			    val < 1 || val > MAX_STATS_INTERVAL) {
+				printf("Statistics interval must be between 1 and %ds.\n",
+				       MAX_STATS_INTERVAL);
+				free(conf);
+				return 1;
+			}
+			conf->stats_interval = val;
+			break;
+		case 'r':
+			conf->rate = strtod(optarg, NULL);
+			if (conf->rate < 0) {
+				printf("Rate must not be negative.\n");
+				free(conf);
+				return 1;
+			}
+			break;
+		case 'b':
+			conf->burst = atoi(optarg);
+			if (conf->burst < 1) {
+				printf("Burst must be at least 1 frame.\n");
+				free(conf);
+				return 1;
+			}
+			break;
+		case 'W':
+			conf->watch_file = optarg;
+			break;
+		case 'D':
+			conf->duty_cycle = strtof(optarg, NULL);
+			if (conf->duty_cycle <= 0 || conf->duty_cycle > 100) {
+				printf("Duty cycle must be between 0 and 100%%.\n");
+				free(conf);
+				return 1;
+			}
+			break;
+		case 'w':
+			conf->duty_window = atoi(optarg);
+			if (conf->duty_window < 1) {
+				printf("Duty cycle window must be at least 1s.\n");
+				free(conf);
+				return 1;
+			}
+			break;
+		case 'P':
+			if (sscanf(optarg, "%f:%f:%f", &conf->pm_base_ma,
+				   &conf->pm_ma_per_dbm, &conf->pm_volts) < 2) {
+				printf("Power model must be <mA at 0dBm>:<mA per dBm>[:<volts>].\n");
+				free(conf);
+				return 1;
+			}
+			break;
+		case 'z':
+			conf->sizes = optarg;
+			break;
 		case 'v':
 			fprintf(stdout, "wpan-ping " PACKAGE_VERSION "\n");
 			free(conf);
@@ -543,14 +2014,14 @@ int main(int argc, char *argv[]) {
 
 	get_interface_info(conf);
 
-	if (!conf->server) {
+	if (!conf->server && !conf->watch_file) {
 		ret = parse_dst_addr(conf, dst_addr);
 		if (ret< 0) {
 			fprintf(stderr, "Address given in wrong format.\n");
 			return 1;
 		}
 	}
-	init_network(conf);
+	ret = init_network(conf);
 	free(conf);
-	return 0;
+	return ret;
 }